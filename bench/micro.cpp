@@ -0,0 +1,408 @@
+/*
+ * micro benchmarks of the hot paths, each timed in isolation on a pool of its own:
+ *     make -C bench && ./bench/micro pool_file [name_filter]
+ * every benchmark runs REPEATS times and the fastest run is reported
+ */
+#include "Dalea.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+namespace Dalea
+{
+    // access to the private steps of HashTable, befriended there
+    class MicroBench
+    {
+    public:
+        static Directory &Dir(HashTable &table) noexcept
+        {
+            return table.dir;
+        }
+
+        static SlabAllocator &Slab(HashTable &table) noexcept
+        {
+            return *table.slab;
+        }
+
+        static SegmentPtr MakeBuddySegment(HashTable &table, PoolBase &pop, const SegmentPtr &root, uint64_t segno, uint64_t buddy_segno, const Bucket &bkt) noexcept
+        {
+            return table.make_buddy_segment(pop, root, segno, buddy_segno, bkt);
+        }
+    };
+} // namespace Dalea
+
+using namespace Dalea;
+
+struct MicroRoot
+{
+    Backend::Ptr<HashTable> map;
+};
+
+constexpr int REPEATS = 5;
+constexpr uint64_t LOOKUPS = 1 << 20;
+// deepest directory the build can hold
+constexpr int MAX_DEPTH = __builtin_ctz(METADIR_SIZE) + __builtin_ctz(SUBDIR_SIZE);
+
+// sinks results so that the compiler keeps the measured work
+static volatile uint64_t sink;
+
+/*
+ * accumulates time and, on x86, TSC ticks over Start/Stop pairs, so that untimed setup
+ * can sit between measured parts. TSC ticks at a constant rate, so cycles/op equals core
+ * cycles only when the core runs at the nominal frequency
+ */
+struct Clock
+{
+    double ns = 0;
+    double cycles = 0;
+    std::chrono::time_point<std::chrono::steady_clock> start;
+    uint64_t start_tsc = 0;
+
+    void Start() noexcept
+    {
+#if defined(__x86_64__)
+        start_tsc = __rdtsc();
+#endif
+        start = std::chrono::steady_clock::now();
+    }
+
+    void Stop() noexcept
+    {
+        auto end = std::chrono::steady_clock::now();
+#if defined(__x86_64__)
+        cycles += __rdtsc() - start_tsc;
+#endif
+        ns += (end - start).count();
+    }
+};
+
+struct Benchmark
+{
+    std::string name;
+    // one run, returns the number of operations timed by clock
+    std::function<uint64_t(Clock &)> run;
+};
+
+static std::vector<std::string> make_keys(const std::string &prefix, uint64_t num)
+{
+    std::vector<std::string> keys;
+    keys.reserve(num);
+    for (uint64_t i = 0; i < num; i++)
+    {
+        keys.push_back(prefix + std::to_string(i));
+    }
+    return keys;
+}
+
+static std::vector<HashValue> hash_keys(const std::vector<std::string> &keys)
+{
+    std::vector<HashValue> hvs;
+    hvs.reserve(keys.size());
+    for (const auto &k : keys)
+    {
+        hvs.emplace_back(std::hash<std::string>{}(k));
+    }
+    return hvs;
+}
+
+static SegmentPtr make_segment(PoolBase &pop, uint8_t depth, uint64_t segno)
+{
+    SegmentPtr seg;
+    Backend::Run(pop, [&]() {
+        seg = Segment::New(pop, depth, segno);
+    });
+    return seg;
+}
+
+static void report(const std::string &name, uint64_t ops, const Clock &best)
+{
+    std::cout << std::left << std::setw(32) << name << std::right << std::setw(12) << ops
+              << std::setw(14) << std::fixed << std::setprecision(2) << best.ns / ops;
+#if defined(__x86_64__)
+    std::cout << std::setw(14) << best.cycles / ops;
+#else
+    std::cout << std::setw(14) << "-";
+#endif
+    std::cout << "\n";
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cout << "usage: " << argv[0] << " pool_file [name_filter]\n";
+        return -1;
+    }
+    std::string file = argv[1];
+    std::string filter = argc > 2 ? argv[2] : "";
+
+#ifdef DRAM_BACKEND
+    // pool_file is ignored, nothing is persisted
+    pobj::pool<MicroRoot> pop;
+    auto root = Backend::Make<MicroRoot>();
+#else
+    remove(file.c_str());
+    auto pop = pobj::pool<MicroRoot>::create(file, "DaleaMicro", PMEMOBJ_MIN_POOL * 10240, S_IWUSR | S_IRUSR);
+    auto root = pop.root();
+#endif
+    Backend::Run(pop, [&]() {
+        root->map = Backend::Make<HashTable>(pop, 1);
+    });
+    auto &table = *root->map;
+    auto &dir = MicroBench::Dir(table);
+    auto &slab = MicroBench::Slab(table);
+
+    // a full bucket at depth 0 owns any hash value, so keys need no particular bits
+    auto hit_keys = make_keys("hit", BUCKET_SIZE);
+    auto hit_hvs = hash_keys(hit_keys);
+    auto miss_keys = make_keys("miss", BUCKET_SIZE);
+    auto miss_hvs = hash_keys(miss_keys);
+    auto full = make_segment(pop, 0, 0);
+    auto &full_bkt = full->buckets[0];
+    for (int i = 0; i < BUCKET_SIZE; i++)
+    {
+        full_bkt.Put(pop, slab, hit_keys[i], hit_keys[i], hit_hvs[i], 0);
+    }
+
+    std::mt19937_64 rng(0);
+    std::vector<HashValue> random_hvs;
+    for (uint64_t i = 0; i < LOOKUPS; i++)
+    {
+        random_hvs.emplace_back(rng());
+    }
+
+    std::vector<Benchmark> benchmarks;
+    benchmarks.push_back({"hash_value_bits", [&](Clock &clock) {
+                              uint64_t acc = 0;
+                              clock.Start();
+                              for (const auto &hv : random_hvs)
+                              {
+                                  acc += hv.SegmentBits(MAX_DEPTH) ^ hv.BucketBits();
+                              }
+                              clock.Stop();
+                              sink = acc;
+                              return LOOKUPS;
+                          }});
+
+    auto bucket_get = [&](const std::vector<std::string> &keys, const std::vector<HashValue> &hvs) {
+        return [&full_bkt, k = &keys, h = &hvs](Clock &clock) {
+            KVPairPtr ptr;
+            uint64_t found = 0;
+            clock.Start();
+            for (uint64_t i = 0; i < LOOKUPS; i++)
+            {
+                auto slot = i % BUCKET_SIZE;
+                found += full_bkt.Get((*k)[slot], (*h)[slot], ptr, 0) == FunctionStatus::Ok;
+            }
+            clock.Stop();
+            sink = found;
+            return LOOKUPS;
+        };
+    };
+    benchmarks.push_back({"bucket_get_hit", bucket_get(hit_keys, hit_hvs)});
+    benchmarks.push_back({"bucket_get_miss", bucket_get(miss_keys, miss_hvs)});
+
+    // update of a stored pair, replaced by a new one, alternating between two values of the same length
+    benchmarks.push_back({"bucket_put_update", [&](Clock &clock) {
+                              constexpr uint64_t ops = 1 << 14;
+                              const std::string values[2] = {std::string(16, 'a'), std::string(16, 'b')};
+                              clock.Start();
+                              for (uint64_t i = 0; i < ops; i++)
+                              {
+                                  auto slot = i % BUCKET_SIZE;
+                                  full_bkt.Put(pop, slab, hit_keys[slot], values[i / BUCKET_SIZE % 2], hit_hvs[slot], 0);
+                              }
+                              clock.Stop();
+                              return ops;
+                          }});
+
+    // in-place increment of counters under the same keys, no pair is replaced
+    auto counters = make_segment(pop, 0, 0);
+    auto &counter_bkt = counters->buckets[0];
+    for (int i = 0; i < BUCKET_SIZE; i++)
+    {
+        int64_t previous;
+        counter_bkt.FetchAdd(pop, slab, hit_keys[i], 0, previous, hit_hvs[i], 0);
+    }
+    benchmarks.push_back({"bucket_fetch_add", [&](Clock &clock) {
+                              constexpr uint64_t ops = 1 << 14;
+                              int64_t previous = 0;
+                              uint64_t acc = 0;
+                              clock.Start();
+                              for (uint64_t i = 0; i < ops; i++)
+                              {
+                                  auto slot = i % BUCKET_SIZE;
+                                  counter_bkt.FetchAdd(pop, slab, hit_keys[slot], 1, previous, hit_hvs[slot], 0);
+                                  acc += previous;
+                              }
+                              clock.Stop();
+                              sink = acc;
+                              return ops;
+                          }});
+
+    // insertion into empty slots of a whole segment, pairs are removed again untimed
+    auto insert_keys = make_keys("insert", SEG_SIZE * BUCKET_SIZE);
+    auto insert_hvs = hash_keys(insert_keys);
+    auto empty = make_segment(pop, 0, 0);
+    benchmarks.push_back({"bucket_put_insert", [&](Clock &clock) {
+                              clock.Start();
+                              for (int i = 0; i < SEG_SIZE * BUCKET_SIZE; i++)
+                              {
+                                  empty->buckets[i / BUCKET_SIZE].Put(pop, slab, insert_keys[i], insert_keys[i], insert_hvs[i], 0);
+                              }
+                              clock.Stop();
+                              for (int i = 0; i < SEG_SIZE * BUCKET_SIZE; i++)
+                              {
+                                  empty->buckets[i / BUCKET_SIZE].Remove(pop, slab, insert_keys[i], insert_hvs[i], 0);
+                              }
+                              return uint64_t(SEG_SIZE * BUCKET_SIZE);
+                          }});
+
+    /*
+     * one Migrate per operation: pairs of a full bucket at depth 1 that do not match its
+     * encoding 0 go to the buddy. At depth 0 the buddy owns nothing, so its own Migrate
+     * hands everything back, untimed
+     */
+    auto migrating = make_segment(pop, 1, 0);
+    auto buddy = make_segment(pop, 1, 1);
+    benchmarks.push_back({"bucket_migrate", [&](Clock &clock) {
+                              constexpr uint64_t ops = 1 << 12;
+                              auto &bkt = migrating->buckets[0];
+                              auto &bud = buddy->buckets[0];
+                              bkt.SetDepth(0);
+                              for (int i = 0; i < BUCKET_SIZE; i++)
+                              {
+                                  bkt.Put(pop, slab, insert_keys[i], insert_keys[i], insert_hvs[i], 0);
+                              }
+                              for (uint64_t i = 0; i < ops; i++)
+                              {
+                                  bkt.SetDepth(1);
+                                  bud.SetDepth(1);
+                                  clock.Start();
+                                  bkt.Migrate(pop, bud, 0);
+                                  clock.Stop();
+                                  bud.SetDepth(0);
+                                  bud.Migrate(pop, bkt, 1);
+                              }
+                              bkt.SetDepth(0);
+                              for (int i = 0; i < BUCKET_SIZE; i++)
+                              {
+                                  bkt.Remove(pop, slab, insert_keys[i], insert_hvs[i], 0);
+                              }
+                              return ops;
+                          }});
+
+    // a deeper directory makes lookups spread over more subdirectories
+    for (int d = 1; d < MAX_DEPTH; d++)
+    {
+        dir.DoublingLink(pop, d, d + 1);
+    }
+    benchmarks.push_back({"directory_get_segment", [&](Clock &clock) {
+                              uint64_t acc = 0;
+                              clock.Start();
+                              for (const auto &hv : random_hvs)
+                              {
+                                  acc += reinterpret_cast<uint64_t>(dir.GetSegment(hv, MAX_DEPTH).get());
+                              }
+                              clock.Stop();
+                              sink = acc;
+                              return LOOKUPS;
+                          }});
+    benchmarks.push_back({"directory_get_shadow_segment", [&](Clock &clock) {
+                              uint64_t acc = 0;
+                              clock.Start();
+                              for (const auto &hv : random_hvs)
+                              {
+                                  acc += reinterpret_cast<uint64_t>(dir.GetShadowSegment(hv, MAX_DEPTH));
+                              }
+                              clock.Stop();
+                              sink = acc;
+                              return LOOKUPS;
+                          }});
+
+    // linking the upper half again at an existing depth, so every run copies the same slots
+    for (auto d : {4, 8, 12, 16, MAX_DEPTH - 1})
+    {
+        benchmarks.push_back({"directory_doubling_link/" + std::to_string(d), [&, d](Clock &clock) {
+                                  constexpr uint64_t ops = 8;
+                                  clock.Start();
+                                  for (uint64_t i = 0; i < ops; i++)
+                                  {
+                                      dir.DoublingLink(pop, d, d + 1);
+                                  }
+                                  clock.Stop();
+                                  return ops;
+                              }});
+    }
+
+    // taking a preallocated segment and initializing it as buddy of segment 0, freed untimed
+    benchmarks.push_back({"make_buddy_segment", [&](Clock &clock) {
+                              constexpr uint64_t ops = 64;
+                              auto seg0 = dir.GetSegment(0);
+                              for (uint64_t i = 0; i < ops; i++)
+                              {
+                                  clock.Start();
+                                  auto seg = MicroBench::MakeBuddySegment(table, pop, seg0, 0, 1, seg0->buckets[0]);
+                                  clock.Stop();
+                                  Backend::Run(pop, [&]() {
+                                      Backend::Delete<Segment>(seg);
+                                  });
+                              }
+                              return ops;
+                          }});
+
+    // drains the preallocated segments, they are pushed back untimed
+    benchmarks.push_back({"segment_queue_pop", [&](Clock &clock) {
+                              auto &queue = table.segment_pool;
+                              std::vector<SegmentPtr> popped;
+                              popped.reserve(queue.size);
+                              uint64_t ops = queue.size;
+                              clock.Start();
+                              for (uint64_t i = 0; i < ops; i++)
+                              {
+                                  popped.push_back(queue.Pop());
+                              }
+                              clock.Stop();
+                              for (const auto &seg : popped)
+                              {
+                                  queue.Push(seg);
+                              }
+                              return std::max<uint64_t>(ops, 1);
+                          }});
+
+    std::cout << std::left << std::setw(32) << "benchmark" << std::right << std::setw(12) << "ops"
+              << std::setw(14) << "ns/op" << std::setw(14) << "cycles/op"
+              << "\n";
+    for (auto &b : benchmarks)
+    {
+        if (b.name.find(filter) == std::string::npos)
+        {
+            continue;
+        }
+        Clock best;
+        uint64_t ops = 0;
+        for (int r = 0; r < REPEATS; r++)
+        {
+            Clock clock;
+            ops = b.run(clock);
+            if (r == 0 || clock.ns < best.ns)
+            {
+                best = clock;
+            }
+        }
+        report(b.name, ops, best);
+    }
+
+    if (Backend::PERSISTENT)
+    {
+        pop.close();
+    }
+    return 0;
+}
@@ -0,0 +1,296 @@
+#include "Affinity.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <numa.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <tuple>
+namespace Dalea
+{
+    static int read_topology(int cpu, const std::string &entry, int fallback)
+    {
+        std::ifstream in("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/" + entry);
+        int value;
+        return (in >> value) ? value : fallback;
+    }
+
+    Affinity::Affinity() : node(-1), placement(Placement::None)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        sched_getaffinity(0, sizeof(set), &set);
+        auto numa = numa_available() >= 0;
+        for (int i = 0; i < CPU_SETSIZE; i++)
+        {
+            if (CPU_ISSET(i, &set))
+            {
+                allowed.push_back({i, numa ? std::max(numa_node_of_cpu(i), 0) : 0,
+                                   read_topology(i, "core_id", i), read_topology(i, "physical_package_id", 0)});
+            }
+        }
+    }
+
+    bool Affinity::ParseCpuList(const std::string &str, std::vector<int> &cpus) noexcept
+    {
+        std::stringstream buf(str);
+        std::string part;
+        std::vector<int> parsed;
+        while (getline(buf, part, ','))
+        {
+            auto dash = part.find('-');
+            auto first = part.substr(0, dash);
+            auto last = dash == std::string::npos ? first : part.substr(dash + 1);
+            if (first.empty() || last.empty() || first.size() > 6 || last.size() > 6 || first.find_first_not_of("0123456789") != std::string::npos ||
+                last.find_first_not_of("0123456789") != std::string::npos)
+            {
+                return false;
+            }
+            auto begin = std::stoi(first);
+            auto end = std::stoi(last);
+            if (begin > end || end >= CPU_SETSIZE)
+            {
+                return false;
+            }
+            for (auto i = begin; i <= end; i++)
+            {
+                parsed.push_back(i);
+            }
+        }
+        if (parsed.empty())
+        {
+            return false;
+        }
+        cpus = parsed;
+        return true;
+    }
+
+    bool Affinity::ParsePlacement(const std::string &str, Placement &p) noexcept
+    {
+        if (str == "none")
+        {
+            p = Placement::None;
+        }
+        else if (str == "compact")
+        {
+            p = Placement::Compact;
+        }
+        else if (str == "scatter")
+        {
+            p = Placement::Scatter;
+        }
+        else
+        {
+            return false;
+        }
+        return true;
+    }
+
+    bool Affinity::Plan(int n, Placement p, const std::vector<int> &worker_cpus, const std::vector<int> &background_cpus) noexcept
+    {
+        if (n >= 0 && (numa_available() < 0 || n > numa_max_node()))
+        {
+            std::cout << "no NUMA node " << n << "\n";
+            return false;
+        }
+        node = n;
+        placement = p;
+
+        std::vector<Cpu> candidates;
+        std::copy_if(allowed.begin(), allowed.end(), std::back_inserter(candidates), [&](const Cpu &c) {
+            return node < 0 || c.node == node;
+        });
+        if (candidates.empty())
+        {
+            std::cout << "no allowed CPU on node " << node << "\n";
+            return false;
+        }
+        auto valid = [&](const std::vector<int> &cpus) {
+            for (auto id : cpus)
+            {
+                auto cpu = find(id);
+                if (cpu == nullptr || (node >= 0 && cpu->node != node))
+                {
+                    std::cout << "CPU " << id << " is not allowed" << (node >= 0 ? " on this node" : "") << "\n";
+                    return false;
+                }
+            }
+            return true;
+        };
+        if (!valid(worker_cpus) || !valid(background_cpus))
+        {
+            return false;
+        }
+
+        workers.clear();
+        if (!worker_cpus.empty())
+        {
+            workers = worker_cpus;
+        }
+        else if (placement == Placement::Compact)
+        {
+            std::sort(candidates.begin(), candidates.end(), [](const Cpu &l, const Cpu &r) {
+                return std::tie(l.node, l.package, l.core, l.id) < std::tie(r.node, r.package, r.core, r.id);
+            });
+            for (const auto &c : candidates)
+            {
+                workers.push_back(c.id);
+            }
+        }
+        else if (placement == Placement::Scatter)
+        {
+            // per node: first sibling of every core, then second ones and so on
+            std::map<int, std::vector<std::pair<std::tuple<int, int, int, int>, int>>> nodes;
+            std::map<std::pair<int, int>, int> siblings;
+            for (const auto &c : candidates)
+            {
+                auto rank = siblings[{c.package, c.core}]++;
+                nodes[c.node].push_back({{rank, c.package, c.core, c.id}, c.id});
+            }
+            size_t longest = 0;
+            for (auto &kv : nodes)
+            {
+                std::sort(kv.second.begin(), kv.second.end());
+                longest = std::max(longest, kv.second.size());
+            }
+            for (size_t i = 0; i < longest; i++)
+            {
+                for (const auto &kv : nodes)
+                {
+                    if (i < kv.second.size())
+                    {
+                        workers.push_back(kv.second[i].second);
+                    }
+                }
+            }
+        }
+
+        background = background_cpus;
+        if (background.empty() && node >= 0)
+        {
+            for (const auto &c : candidates)
+            {
+                background.push_back(c.id);
+            }
+        }
+        return true;
+    }
+
+    void Affinity::PinWorker(int id) const noexcept
+    {
+        if (!workers.empty())
+        {
+            pin({workers[id % workers.size()]});
+        }
+        else if (node >= 0)
+        {
+            numa_run_on_node(node);
+        }
+        if (node >= 0)
+        {
+            numa_set_preferred(node);
+        }
+    }
+
+    void Affinity::PinBackground() const noexcept
+    {
+        if (!background.empty())
+        {
+            pin(background);
+        }
+        if (node >= 0)
+        {
+            numa_set_preferred(node);
+        }
+    }
+
+    void Affinity::Unpin() const noexcept
+    {
+        std::vector<int> all;
+        for (const auto &c : allowed)
+        {
+            all.push_back(c.id);
+        }
+        pin(all);
+        if (numa_available() >= 0)
+        {
+            numa_set_localalloc();
+        }
+    }
+
+    void Affinity::Report(std::ostream &out, int thread_num) const
+    {
+        std::map<int, std::vector<int>> nodes;
+        for (const auto &c : allowed)
+        {
+            nodes[c.node].push_back(c.id);
+        }
+        out << "   topology: " << allowed.size() << " allowed CPUs on " << nodes.size() << " nodes";
+        for (const auto &kv : nodes)
+        {
+            out << ", node " << kv.first << ": " << format(kv.second);
+        }
+        out << "\n";
+
+        static const char *names[] = {"none", "compact", "scatter"};
+        out << "   placement is " << (placement == Placement::None && !workers.empty() ? "explicit" : names[static_cast<int>(placement)])
+            << ", node binding is " << (node >= 0 ? std::to_string(node) : "none") << "\n";
+        out << "   worker CPUs:";
+        if (workers.empty())
+        {
+            out << " unpinned";
+        }
+        for (int i = 0; i < thread_num && !workers.empty(); i++)
+        {
+            auto cpu = find(workers[i % workers.size()]);
+            out << " " << cpu->id << "(node " << cpu->node << ")";
+        }
+        out << "\n";
+        out << "   background CPUs: " << (background.empty() ? "unpinned" : format(background)) << "\n";
+    }
+
+    const Affinity::Cpu *Affinity::find(int id) const noexcept
+    {
+        auto it = std::find_if(allowed.begin(), allowed.end(), [&](const Cpu &c) {
+            return c.id == id;
+        });
+        return it == allowed.end() ? nullptr : &*it;
+    }
+
+    void Affinity::pin(const std::vector<int> &cpus) const noexcept
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (auto id : cpus)
+        {
+            CPU_SET(id, &set);
+        }
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    // ascending CPUs as ranges, e.g. "0-3,8"
+    std::string Affinity::format(const std::vector<int> &cpus)
+    {
+        auto sorted = cpus;
+        std::sort(sorted.begin(), sorted.end());
+        std::stringstream out;
+        for (size_t i = 0; i < sorted.size(); i++)
+        {
+            auto j = i;
+            while (j + 1 < sorted.size() && sorted[j + 1] == sorted[j] + 1)
+            {
+                ++j;
+            }
+            out << (i ? "," : "") << sorted[i];
+            if (j > i)
+            {
+                out << "-" << sorted[j];
+            }
+            i = j;
+        }
+        return out.str();
+    }
+} // namespace Dalea
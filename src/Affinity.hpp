@@ -0,0 +1,67 @@
+#ifndef __DALEA__AFFINITY__
+#define __DALEA__AFFINITY__
+#include <ostream>
+#include <string>
+#include <vector>
+namespace Dalea
+{
+    enum class Placement
+    {
+        // leave threads to the scheduler
+        None,
+        // fill one node first, hyperthread siblings next to each other
+        Compact,
+        // round-robin over nodes, one thread per physical core before siblings
+        Scatter,
+    };
+
+    /*
+     * where bench threads run: worker i is pinned to the i-th CPU of an explicit list or of
+     * the placement order, background threads (segment guardians, shrinker) to their own
+     * list. Binding to a node restricts both to that node's CPUs and prefers its memory
+     */
+    class Affinity
+    {
+    public:
+        // reads the CPUs this process may run on and their node, core and package
+        Affinity();
+        Affinity(const Affinity &) = delete;
+        Affinity(Affinity &&) = delete;
+
+        // "0-3,8,10-11"
+        static bool ParseCpuList(const std::string &str, std::vector<int> &cpus) noexcept;
+        static bool ParsePlacement(const std::string &str, Placement &placement) noexcept;
+
+        // node -1 binds nothing, an explicit worker list overrides the placement
+        bool Plan(int node, Placement placement, const std::vector<int> &worker_cpus, const std::vector<int> &background_cpus) noexcept;
+
+        // the calling thread becomes worker id, or a background thread
+        void PinWorker(int id) const noexcept;
+        void PinBackground() const noexcept;
+        // back to every allowed CPU, e.g. for the main thread after it served as a worker
+        void Unpin() const noexcept;
+
+        // topology and the CPUs the first thread_num workers use
+        void Report(std::ostream &out, int thread_num) const;
+
+    private:
+        struct Cpu
+        {
+            int id;
+            int node;
+            int core;
+            int package;
+        };
+
+        std::vector<Cpu> allowed;
+        int node;
+        Placement placement;
+        std::vector<int> workers;
+        std::vector<int> background;
+
+        const Cpu *find(int id) const noexcept;
+        void pin(const std::vector<int> &cpus) const noexcept;
+        static std::string format(const std::vector<int> &cpus);
+    };
+} // namespace Dalea
+#endif
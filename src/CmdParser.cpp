@@ -26,6 +26,118 @@ namespace Dalea
             {
                 return false;
             }
+            if (parseShards(argv[i], i < argc - 1 ? argv[i + 1] : nullptr) == ParserStatus::Rejected)
+            {
+                return false;
+            }
+            if (parseRecords(argv[i], i < argc - 1 ? argv[i + 1] : nullptr) == ParserStatus::Rejected)
+            {
+                return false;
+            }
+            if (parseOperations(argv[i], i < argc - 1 ? argv[i + 1] : nullptr) == ParserStatus::Rejected)
+            {
+                return false;
+            }
+            if (parseMix(argv[i], i < argc - 1 ? argv[i + 1] : nullptr) == ParserStatus::Rejected)
+            {
+                return false;
+            }
+            if (parseKeySize(argv[i], i < argc - 1 ? argv[i + 1] : nullptr) == ParserStatus::Rejected)
+            {
+                return false;
+            }
+            if (parseValueSize(argv[i], i < argc - 1 ? argv[i + 1] : nullptr) == ParserStatus::Rejected)
+            {
+                return false;
+            }
+            if (parseDistribution(argv[i], i < argc - 1 ? argv[i + 1] : nullptr) == ParserStatus::Rejected)
+            {
+                return false;
+            }
+            if (parseSeed(argv[i], i < argc - 1 ? argv[i + 1] : nullptr) == ParserStatus::Rejected)
+            {
+                return false;
+            }
+            if (parseConvert(argv[i], i < argc - 1 ? argv[i + 1] : nullptr) == ParserStatus::Rejected)
+            {
+                return false;
+            }
+            if (parseBulk(argv[i], i < argc - 1 ? argv[i + 1] : nullptr) == ParserStatus::Rejected)
+            {
+                return false;
+            }
+            if (parseTimeline(argv[i], i < argc - 1 ? argv[i + 1] : nullptr) == ParserStatus::Rejected)
+            {
+                return false;
+            }
+            if (parseInterval(argv[i], i < argc - 1 ? argv[i + 1] : nullptr) == ParserStatus::Rejected)
+            {
+                return false;
+            }
+            if (parseCpus(argv[i], i < argc - 1 ? argv[i + 1] : nullptr) == ParserStatus::Rejected)
+            {
+                return false;
+            }
+            if (parsePlacement(argv[i], i < argc - 1 ? argv[i + 1] : nullptr) == ParserStatus::Rejected)
+            {
+                return false;
+            }
+            if (parseNode(argv[i], i < argc - 1 ? argv[i + 1] : nullptr) == ParserStatus::Rejected)
+            {
+                return false;
+            }
+            if (parseBackground(argv[i], i < argc - 1 ? argv[i + 1] : nullptr) == ParserStatus::Rejected)
+            {
+                return false;
+            }
+            if (parseRate(argv[i], i < argc - 1 ? argv[i + 1] : nullptr) == ParserStatus::Rejected)
+            {
+                return false;
+            }
+            if (parseArrival(argv[i], i < argc - 1 ? argv[i + 1] : nullptr) == ParserStatus::Rejected)
+            {
+                return false;
+            }
+            if (parseEmulate(argv[i], i < argc - 1 ? argv[i + 1] : nullptr) == ParserStatus::Rejected)
+            {
+                return false;
+            }
+            if (parseDecodeLog(argv[i], i < argc - 1 ? argv[i + 1] : nullptr) == ParserStatus::Rejected)
+            {
+                return false;
+            }
+            if (parseTrace(argv[i], i < argc - 1 ? argv[i + 1] : nullptr) == ParserStatus::Rejected)
+            {
+                return false;
+            }
+            if (parseCache(argv[i], i < argc - 1 ? argv[i + 1] : nullptr) == ParserStatus::Rejected)
+            {
+                return false;
+            }
+            if (parseValueLog(argv[i], i < argc - 1 ? argv[i + 1] : nullptr) == ParserStatus::Rejected)
+            {
+                return false;
+            }
+            if (parseReserve(argv[i], i < argc - 1 ? argv[i + 1] : nullptr) == ParserStatus::Rejected)
+            {
+                return false;
+            }
+            if (parseSplitWorkers(argv[i], i < argc - 1 ? argv[i + 1] : nullptr) == ParserStatus::Rejected)
+            {
+                return false;
+            }
+            if (parseFlatten(argv[i], i < argc - 1 ? argv[i + 1] : nullptr) == ParserStatus::Rejected)
+            {
+                return false;
+            }
+            if (parseShrink(argv[i], i < argc - 1 ? argv[i + 1] : nullptr) == ParserStatus::Rejected)
+            {
+                return false;
+            }
+            if (parseReopen(argv[i], i < argc - 1 ? argv[i + 1] : nullptr) == ParserStatus::Rejected)
+            {
+                return false;
+            }
         }
         return true;
     }
@@ -240,4 +352,984 @@ namespace Dalea
         return ParserStatus::Missing;
     }
 
+    ParserStatus CmdParser::parseShards(char *argv, char *next)
+    {
+        if (strncmp("--shards", argv, 8) == 0)
+        {
+            if (strncmp("--shards=", argv, 9) == 0)
+            {
+                std::string value(argv + 9);
+                if (value.length() == 0)
+                {
+                    std::cerr << "please offer a value to shards\n";
+                    return ParserStatus::Rejected;
+                }
+                putOption("shards", value);
+            }
+
+            return ParserStatus::Accepted;
+        }
+
+        if (strncmp("-s", argv, 2) == 0)
+        {
+            if (next)
+            {
+                putOption("shards", next);
+                return ParserStatus::Accepted;
+            }
+            else
+            {
+                std::cerr << "not enough arguments to -s\n";
+                return ParserStatus::Rejected;
+            }
+        }
+
+        return ParserStatus::Missing;
+    }
+
+    ParserStatus CmdParser::parseRecords(char *argv, char *next)
+    {
+        if (strncmp("--records", argv, 9) == 0)
+        {
+            if (strncmp("--records=", argv, 10) == 0)
+            {
+                std::string value(argv + 10);
+                if (value.length() == 0)
+                {
+                    std::cerr << "please offer a value to records\n";
+                    return ParserStatus::Rejected;
+                }
+                putOption("records", value);
+            }
+
+            return ParserStatus::Accepted;
+        }
+
+        if (strncmp("-n", argv, 2) == 0)
+        {
+            if (next)
+            {
+                putOption("records", next);
+                return ParserStatus::Accepted;
+            }
+            else
+            {
+                std::cerr << "not enough arguments to -n\n";
+                return ParserStatus::Rejected;
+            }
+        }
+
+        return ParserStatus::Missing;
+    }
+
+    ParserStatus CmdParser::parseOperations(char *argv, char *next)
+    {
+        if (strncmp("--operations", argv, 12) == 0)
+        {
+            if (strncmp("--operations=", argv, 13) == 0)
+            {
+                std::string value(argv + 13);
+                if (value.length() == 0)
+                {
+                    std::cerr << "please offer a value to operations\n";
+                    return ParserStatus::Rejected;
+                }
+                putOption("operations", value);
+            }
+
+            return ParserStatus::Accepted;
+        }
+
+        if (strncmp("-o", argv, 2) == 0)
+        {
+            if (next)
+            {
+                putOption("operations", next);
+                return ParserStatus::Accepted;
+            }
+            else
+            {
+                std::cerr << "not enough arguments to -o\n";
+                return ParserStatus::Rejected;
+            }
+        }
+
+        return ParserStatus::Missing;
+    }
+
+    ParserStatus CmdParser::parseMix(char *argv, char *next)
+    {
+        if (strncmp("--mix", argv, 5) == 0)
+        {
+            if (strncmp("--mix=", argv, 6) == 0)
+            {
+                std::string value(argv + 6);
+                if (value.length() == 0)
+                {
+                    std::cerr << "please offer a value to mix\n";
+                    return ParserStatus::Rejected;
+                }
+                putOption("mix", value);
+            }
+
+            return ParserStatus::Accepted;
+        }
+
+        if (strncmp("-m", argv, 2) == 0)
+        {
+            if (next)
+            {
+                putOption("mix", next);
+                return ParserStatus::Accepted;
+            }
+            else
+            {
+                std::cerr << "not enough arguments to -m\n";
+                return ParserStatus::Rejected;
+            }
+        }
+
+        return ParserStatus::Missing;
+    }
+
+    ParserStatus CmdParser::parseKeySize(char *argv, char *next)
+    {
+        if (strncmp("--key_size", argv, 10) == 0)
+        {
+            if (strncmp("--key_size=", argv, 11) == 0)
+            {
+                std::string value(argv + 11);
+                if (value.length() == 0)
+                {
+                    std::cerr << "please offer a value to key_size\n";
+                    return ParserStatus::Rejected;
+                }
+                putOption("key_size", value);
+            }
+
+            return ParserStatus::Accepted;
+        }
+
+        if (strncmp("-k", argv, 2) == 0)
+        {
+            if (next)
+            {
+                putOption("key_size", next);
+                return ParserStatus::Accepted;
+            }
+            else
+            {
+                std::cerr << "not enough arguments to -k\n";
+                return ParserStatus::Rejected;
+            }
+        }
+
+        return ParserStatus::Missing;
+    }
+
+    ParserStatus CmdParser::parseValueSize(char *argv, char *next)
+    {
+        if (strncmp("--value_size", argv, 12) == 0)
+        {
+            if (strncmp("--value_size=", argv, 13) == 0)
+            {
+                std::string value(argv + 13);
+                if (value.length() == 0)
+                {
+                    std::cerr << "please offer a value to value_size\n";
+                    return ParserStatus::Rejected;
+                }
+                putOption("value_size", value);
+            }
+
+            return ParserStatus::Accepted;
+        }
+
+        if (strncmp("-v", argv, 2) == 0)
+        {
+            if (next)
+            {
+                putOption("value_size", next);
+                return ParserStatus::Accepted;
+            }
+            else
+            {
+                std::cerr << "not enough arguments to -v\n";
+                return ParserStatus::Rejected;
+            }
+        }
+
+        return ParserStatus::Missing;
+    }
+
+    ParserStatus CmdParser::parseDistribution(char *argv, char *next)
+    {
+        if (strncmp("--distribution", argv, 14) == 0)
+        {
+            if (strncmp("--distribution=", argv, 15) == 0)
+            {
+                std::string value(argv + 15);
+                if (value.length() == 0)
+                {
+                    std::cerr << "please offer a value to distribution\n";
+                    return ParserStatus::Rejected;
+                }
+                putOption("distribution", value);
+            }
+
+            return ParserStatus::Accepted;
+        }
+
+        if (strncmp("-d", argv, 2) == 0)
+        {
+            if (next)
+            {
+                putOption("distribution", next);
+                return ParserStatus::Accepted;
+            }
+            else
+            {
+                std::cerr << "not enough arguments to -d\n";
+                return ParserStatus::Rejected;
+            }
+        }
+
+        return ParserStatus::Missing;
+    }
+
+    ParserStatus CmdParser::parseSeed(char *argv, char *next)
+    {
+        if (strncmp("--seed", argv, 6) == 0)
+        {
+            if (strncmp("--seed=", argv, 7) == 0)
+            {
+                std::string value(argv + 7);
+                if (value.length() == 0)
+                {
+                    std::cerr << "please offer a value to seed\n";
+                    return ParserStatus::Rejected;
+                }
+                putOption("seed", value);
+            }
+
+            return ParserStatus::Accepted;
+        }
+
+        if (strncmp("-e", argv, 2) == 0)
+        {
+            if (next)
+            {
+                putOption("seed", next);
+                return ParserStatus::Accepted;
+            }
+            else
+            {
+                std::cerr << "not enough arguments to -e\n";
+                return ParserStatus::Rejected;
+            }
+        }
+
+        return ParserStatus::Missing;
+    }
+
+    ParserStatus CmdParser::parseConvert(char *argv, char *next)
+    {
+        if (strncmp("--convert", argv, 9) == 0)
+        {
+            if (strncmp("--convert=", argv, 10) == 0)
+            {
+                std::string value(argv + 10);
+                if (value.length() == 0)
+                {
+                    std::cerr << "please offer a value to convert\n";
+                    return ParserStatus::Rejected;
+                }
+                putOption("convert", value);
+            }
+
+            return ParserStatus::Accepted;
+        }
+
+        if (strncmp("-c", argv, 2) == 0)
+        {
+            if (next)
+            {
+                putOption("convert", next);
+                return ParserStatus::Accepted;
+            }
+            else
+            {
+                std::cerr << "not enough arguments to -c\n";
+                return ParserStatus::Rejected;
+            }
+        }
+
+        return ParserStatus::Missing;
+    }
+
+    ParserStatus CmdParser::parseBulk(char *argv, char *next)
+    {
+        if (strncmp("--bulk", argv, 6) == 0)
+        {
+            if (strncmp("--bulk=", argv, 7) == 0)
+            {
+                std::string value(argv + 7);
+                if (value.length() == 0)
+                {
+                    std::cerr << "please offer a value to bulk\n";
+                    return ParserStatus::Rejected;
+                }
+                putOption("bulk", value);
+            }
+
+            return ParserStatus::Accepted;
+        }
+
+        if (strncmp("-l", argv, 2) == 0)
+        {
+            if (next)
+            {
+                putOption("bulk", next);
+                return ParserStatus::Accepted;
+            }
+            else
+            {
+                std::cerr << "not enough arguments to -l\n";
+                return ParserStatus::Rejected;
+            }
+        }
+
+        return ParserStatus::Missing;
+    }
+
+    ParserStatus CmdParser::parseTimeline(char *argv, char *next)
+    {
+        if (strncmp("--timeline", argv, 10) == 0)
+        {
+            if (strncmp("--timeline=", argv, 11) == 0)
+            {
+                std::string value(argv + 11);
+                if (value.length() == 0)
+                {
+                    std::cerr << "please offer a value to timeline\n";
+                    return ParserStatus::Rejected;
+                }
+                putOption("timeline", value);
+            }
+
+            return ParserStatus::Accepted;
+        }
+
+        if (strncmp("-g", argv, 2) == 0)
+        {
+            if (next)
+            {
+                putOption("timeline", next);
+                return ParserStatus::Accepted;
+            }
+            else
+            {
+                std::cerr << "not enough arguments to -g\n";
+                return ParserStatus::Rejected;
+            }
+        }
+
+        return ParserStatus::Missing;
+    }
+
+    ParserStatus CmdParser::parseInterval(char *argv, char *next)
+    {
+        if (strncmp("--interval", argv, 10) == 0)
+        {
+            if (strncmp("--interval=", argv, 11) == 0)
+            {
+                std::string value(argv + 11);
+                if (value.length() == 0)
+                {
+                    std::cerr << "please offer a value to interval\n";
+                    return ParserStatus::Rejected;
+                }
+                putOption("interval", value);
+            }
+
+            return ParserStatus::Accepted;
+        }
+
+        if (strncmp("-i", argv, 2) == 0)
+        {
+            if (next)
+            {
+                putOption("interval", next);
+                return ParserStatus::Accepted;
+            }
+            else
+            {
+                std::cerr << "not enough arguments to -i\n";
+                return ParserStatus::Rejected;
+            }
+        }
+
+        return ParserStatus::Missing;
+    }
+
+    ParserStatus CmdParser::parseCpus(char *argv, char *next)
+    {
+        if (strncmp("--cpus", argv, 6) == 0)
+        {
+            if (strncmp("--cpus=", argv, 7) == 0)
+            {
+                std::string value(argv + 7);
+                if (value.length() == 0)
+                {
+                    std::cerr << "please offer a value to cpus\n";
+                    return ParserStatus::Rejected;
+                }
+                putOption("cpus", value);
+            }
+
+            return ParserStatus::Accepted;
+        }
+
+        if (strncmp("-a", argv, 2) == 0)
+        {
+            if (next)
+            {
+                putOption("cpus", next);
+                return ParserStatus::Accepted;
+            }
+            else
+            {
+                std::cerr << "not enough arguments to -a\n";
+                return ParserStatus::Rejected;
+            }
+        }
+
+        return ParserStatus::Missing;
+    }
+
+    ParserStatus CmdParser::parsePlacement(char *argv, char *next)
+    {
+        if (strncmp("--placement", argv, 11) == 0)
+        {
+            if (strncmp("--placement=", argv, 12) == 0)
+            {
+                std::string value(argv + 12);
+                if (value.length() == 0)
+                {
+                    std::cerr << "please offer a value to placement\n";
+                    return ParserStatus::Rejected;
+                }
+                putOption("placement", value);
+            }
+
+            return ParserStatus::Accepted;
+        }
+
+        if (strncmp("-x", argv, 2) == 0)
+        {
+            if (next)
+            {
+                putOption("placement", next);
+                return ParserStatus::Accepted;
+            }
+            else
+            {
+                std::cerr << "not enough arguments to -x\n";
+                return ParserStatus::Rejected;
+            }
+        }
+
+        return ParserStatus::Missing;
+    }
+
+    ParserStatus CmdParser::parseNode(char *argv, char *next)
+    {
+        if (strncmp("--node", argv, 6) == 0)
+        {
+            if (strncmp("--node=", argv, 7) == 0)
+            {
+                std::string value(argv + 7);
+                if (value.length() == 0)
+                {
+                    std::cerr << "please offer a value to node\n";
+                    return ParserStatus::Rejected;
+                }
+                putOption("node", value);
+            }
+
+            return ParserStatus::Accepted;
+        }
+
+        if (strncmp("-u", argv, 2) == 0)
+        {
+            if (next)
+            {
+                putOption("node", next);
+                return ParserStatus::Accepted;
+            }
+            else
+            {
+                std::cerr << "not enough arguments to -u\n";
+                return ParserStatus::Rejected;
+            }
+        }
+
+        return ParserStatus::Missing;
+    }
+
+    ParserStatus CmdParser::parseBackground(char *argv, char *next)
+    {
+        if (strncmp("--background", argv, 12) == 0)
+        {
+            if (strncmp("--background=", argv, 13) == 0)
+            {
+                std::string value(argv + 13);
+                if (value.length() == 0)
+                {
+                    std::cerr << "please offer a value to background\n";
+                    return ParserStatus::Rejected;
+                }
+                putOption("background", value);
+            }
+
+            return ParserStatus::Accepted;
+        }
+
+        if (strncmp("-y", argv, 2) == 0)
+        {
+            if (next)
+            {
+                putOption("background", next);
+                return ParserStatus::Accepted;
+            }
+            else
+            {
+                std::cerr << "not enough arguments to -y\n";
+                return ParserStatus::Rejected;
+            }
+        }
+
+        return ParserStatus::Missing;
+    }
+
+    ParserStatus CmdParser::parseRate(char *argv, char *next)
+    {
+        if (strncmp("--rate", argv, 6) == 0)
+        {
+            if (strncmp("--rate=", argv, 7) == 0)
+            {
+                std::string value(argv + 7);
+                if (value.length() == 0)
+                {
+                    std::cerr << "please offer a value to rate\n";
+                    return ParserStatus::Rejected;
+                }
+                putOption("rate", value);
+            }
+
+            return ParserStatus::Accepted;
+        }
+
+        if (strncmp("-q", argv, 2) == 0)
+        {
+            if (next)
+            {
+                putOption("rate", next);
+                return ParserStatus::Accepted;
+            }
+            else
+            {
+                std::cerr << "not enough arguments to -q\n";
+                return ParserStatus::Rejected;
+            }
+        }
+
+        return ParserStatus::Missing;
+    }
+
+    ParserStatus CmdParser::parseArrival(char *argv, char *next)
+    {
+        if (strncmp("--arrival", argv, 9) == 0)
+        {
+            if (strncmp("--arrival=", argv, 10) == 0)
+            {
+                std::string value(argv + 10);
+                if (value.length() == 0)
+                {
+                    std::cerr << "please offer a value to arrival\n";
+                    return ParserStatus::Rejected;
+                }
+                putOption("arrival", value);
+            }
+
+            return ParserStatus::Accepted;
+        }
+
+        if (strncmp("-j", argv, 2) == 0)
+        {
+            if (next)
+            {
+                putOption("arrival", next);
+                return ParserStatus::Accepted;
+            }
+            else
+            {
+                std::cerr << "not enough arguments to -j\n";
+                return ParserStatus::Rejected;
+            }
+        }
+
+        return ParserStatus::Missing;
+    }
+
+    ParserStatus CmdParser::parseEmulate(char *argv, char *next)
+    {
+        if (strncmp("--emulate", argv, 9) == 0)
+        {
+            if (strncmp("--emulate=", argv, 10) == 0)
+            {
+                std::string value(argv + 10);
+                if (value.length() == 0)
+                {
+                    std::cerr << "please offer a value to emulate\n";
+                    return ParserStatus::Rejected;
+                }
+                putOption("emulate", value);
+            }
+
+            return ParserStatus::Accepted;
+        }
+
+        if (strncmp("-f", argv, 2) == 0)
+        {
+            if (next)
+            {
+                putOption("emulate", next);
+                return ParserStatus::Accepted;
+            }
+            else
+            {
+                std::cerr << "not enough arguments to -f\n";
+                return ParserStatus::Rejected;
+            }
+        }
+
+        return ParserStatus::Missing;
+    }
+
+    ParserStatus CmdParser::parseDecodeLog(char *argv, char *next)
+    {
+        if (strncmp("--decode_log", argv, 12) == 0)
+        {
+            if (strncmp("--decode_log=", argv, 13) == 0)
+            {
+                std::string value(argv + 13);
+                if (value.length() == 0)
+                {
+                    std::cerr << "please offer a value to decode_log\n";
+                    return ParserStatus::Rejected;
+                }
+                putOption("decode_log", value);
+            }
+
+            return ParserStatus::Accepted;
+        }
+
+        if (strncmp("-z", argv, 2) == 0)
+        {
+            if (next)
+            {
+                putOption("decode_log", next);
+                return ParserStatus::Accepted;
+            }
+            else
+            {
+                std::cerr << "not enough arguments to -z\n";
+                return ParserStatus::Rejected;
+            }
+        }
+
+        return ParserStatus::Missing;
+    }
+
+    ParserStatus CmdParser::parseTrace(char *argv, char *next)
+    {
+        if (strncmp("--trace", argv, 7) == 0)
+        {
+            if (strncmp("--trace=", argv, 8) == 0)
+            {
+                std::string value(argv + 8);
+                if (value.length() == 0)
+                {
+                    std::cerr << "please offer a value to trace\n";
+                    return ParserStatus::Rejected;
+                }
+                putOption("trace", value);
+            }
+
+            return ParserStatus::Accepted;
+        }
+
+        if (strncmp("-T", argv, 2) == 0)
+        {
+            if (next)
+            {
+                putOption("trace", next);
+                return ParserStatus::Accepted;
+            }
+            else
+            {
+                std::cerr << "not enough arguments to -T\n";
+                return ParserStatus::Rejected;
+            }
+        }
+
+        return ParserStatus::Missing;
+    }
+
+    ParserStatus CmdParser::parseCache(char *argv, char *next)
+    {
+        if (strncmp("--cache", argv, 7) == 0)
+        {
+            if (strncmp("--cache=", argv, 8) == 0)
+            {
+                std::string value(argv + 8);
+                if (value.length() == 0)
+                {
+                    std::cerr << "please offer a value to cache\n";
+                    return ParserStatus::Rejected;
+                }
+                putOption("cache", value);
+            }
+
+            return ParserStatus::Accepted;
+        }
+
+        if (strncmp("-C", argv, 2) == 0)
+        {
+            if (next)
+            {
+                putOption("cache", next);
+                return ParserStatus::Accepted;
+            }
+            else
+            {
+                std::cerr << "not enough arguments to -C\n";
+                return ParserStatus::Rejected;
+            }
+        }
+
+        return ParserStatus::Missing;
+    }
+
+    ParserStatus CmdParser::parseValueLog(char *argv, char *next)
+    {
+        if (strncmp("--value_log", argv, 11) == 0)
+        {
+            if (strncmp("--value_log=", argv, 12) == 0)
+            {
+                std::string value(argv + 12);
+                if (value.length() == 0)
+                {
+                    std::cerr << "please offer a value to value_log\n";
+                    return ParserStatus::Rejected;
+                }
+                putOption("value_log", value);
+            }
+
+            return ParserStatus::Accepted;
+        }
+
+        if (strncmp("-V", argv, 2) == 0)
+        {
+            if (next)
+            {
+                putOption("value_log", next);
+                return ParserStatus::Accepted;
+            }
+            else
+            {
+                std::cerr << "not enough arguments to -V\n";
+                return ParserStatus::Rejected;
+            }
+        }
+
+        return ParserStatus::Missing;
+    }
+
+    ParserStatus CmdParser::parseReserve(char *argv, char *next)
+    {
+        if (strncmp("--reserve", argv, 9) == 0)
+        {
+            if (strncmp("--reserve=", argv, 10) == 0)
+            {
+                std::string value(argv + 10);
+                if (value.length() == 0)
+                {
+                    std::cerr << "please offer a value to reserve\n";
+                    return ParserStatus::Rejected;
+                }
+                putOption("reserve", value);
+            }
+
+            return ParserStatus::Accepted;
+        }
+
+        if (strncmp("-R", argv, 2) == 0)
+        {
+            if (next)
+            {
+                putOption("reserve", next);
+                return ParserStatus::Accepted;
+            }
+            else
+            {
+                std::cerr << "not enough arguments to -R\n";
+                return ParserStatus::Rejected;
+            }
+        }
+
+        return ParserStatus::Missing;
+    }
+
+    ParserStatus CmdParser::parseSplitWorkers(char *argv, char *next)
+    {
+        if (strncmp("--split_workers", argv, 15) == 0)
+        {
+            if (strncmp("--split_workers=", argv, 16) == 0)
+            {
+                std::string value(argv + 16);
+                if (value.length() == 0)
+                {
+                    std::cerr << "please offer a value to split_workers\n";
+                    return ParserStatus::Rejected;
+                }
+                putOption("split_workers", value);
+            }
+
+            return ParserStatus::Accepted;
+        }
+
+        if (strncmp("-S", argv, 2) == 0)
+        {
+            if (next)
+            {
+                putOption("split_workers", next);
+                return ParserStatus::Accepted;
+            }
+            else
+            {
+                std::cerr << "not enough arguments to -S\n";
+                return ParserStatus::Rejected;
+            }
+        }
+
+        return ParserStatus::Missing;
+    }
+
+    ParserStatus CmdParser::parseFlatten(char *argv, char *next)
+    {
+        if (strncmp("--flatten", argv, 9) == 0)
+        {
+            if (strncmp("--flatten=", argv, 10) == 0)
+            {
+                std::string value(argv + 10);
+                if (value.length() == 0)
+                {
+                    std::cerr << "please offer a value to flatten\n";
+                    return ParserStatus::Rejected;
+                }
+                putOption("flatten", value);
+            }
+
+            return ParserStatus::Accepted;
+        }
+
+        if (strncmp("-F", argv, 2) == 0)
+        {
+            if (next)
+            {
+                putOption("flatten", next);
+                return ParserStatus::Accepted;
+            }
+            else
+            {
+                std::cerr << "not enough arguments to -F\n";
+                return ParserStatus::Rejected;
+            }
+        }
+
+        return ParserStatus::Missing;
+    }
+
+    ParserStatus CmdParser::parseShrink(char *argv, char *next)
+    {
+        if (strncmp("--shrink", argv, 8) == 0)
+        {
+            if (strncmp("--shrink=", argv, 9) == 0)
+            {
+                std::string value(argv + 9);
+                if (value.length() == 0)
+                {
+                    std::cerr << "please offer a value to shrink\n";
+                    return ParserStatus::Rejected;
+                }
+                putOption("shrink", value);
+            }
+
+            return ParserStatus::Accepted;
+        }
+
+        if (strncmp("-M", argv, 2) == 0)
+        {
+            if (next)
+            {
+                putOption("shrink", next);
+                return ParserStatus::Accepted;
+            }
+            else
+            {
+                std::cerr << "not enough arguments to -M\n";
+                return ParserStatus::Rejected;
+            }
+        }
+
+        return ParserStatus::Missing;
+    }
+
+    ParserStatus CmdParser::parseReopen(char *argv, char *next)
+    {
+        if (strncmp("--reopen", argv, 8) == 0)
+        {
+            if (strncmp("--reopen=", argv, 9) == 0)
+            {
+                std::string value(argv + 9);
+                if (value.length() == 0)
+                {
+                    std::cerr << "please offer a value to reopen\n";
+                    return ParserStatus::Rejected;
+                }
+                putOption("reopen", value);
+            }
+
+            return ParserStatus::Accepted;
+        }
+
+        if (strncmp("-O", argv, 2) == 0)
+        {
+            if (next)
+            {
+                putOption("reopen", next);
+                return ParserStatus::Accepted;
+            }
+            else
+            {
+                std::cerr << "not enough arguments to -O\n";
+                return ParserStatus::Rejected;
+            }
+        }
+
+        return ParserStatus::Missing;
+    }
+
 } // namespace Dalea
@@ -37,5 +37,61 @@ namespace Dalea
         ParserStatus parseThreads(char *argv, char *next);
 
         ParserStatus parseBatch(char *argv, char *next);
+
+        ParserStatus parseShards(char *argv, char *next);
+
+        ParserStatus parseRecords(char *argv, char *next);
+
+        ParserStatus parseOperations(char *argv, char *next);
+
+        ParserStatus parseMix(char *argv, char *next);
+
+        ParserStatus parseKeySize(char *argv, char *next);
+
+        ParserStatus parseValueSize(char *argv, char *next);
+
+        ParserStatus parseDistribution(char *argv, char *next);
+
+        ParserStatus parseSeed(char *argv, char *next);
+
+        ParserStatus parseConvert(char *argv, char *next);
+
+        ParserStatus parseBulk(char *argv, char *next);
+
+        ParserStatus parseTimeline(char *argv, char *next);
+
+        ParserStatus parseInterval(char *argv, char *next);
+
+        ParserStatus parseCpus(char *argv, char *next);
+
+        ParserStatus parsePlacement(char *argv, char *next);
+
+        ParserStatus parseNode(char *argv, char *next);
+
+        ParserStatus parseBackground(char *argv, char *next);
+
+        ParserStatus parseRate(char *argv, char *next);
+
+        ParserStatus parseArrival(char *argv, char *next);
+
+        ParserStatus parseEmulate(char *argv, char *next);
+
+        ParserStatus parseDecodeLog(char *argv, char *next);
+
+        ParserStatus parseTrace(char *argv, char *next);
+
+        ParserStatus parseCache(char *argv, char *next);
+
+        ParserStatus parseValueLog(char *argv, char *next);
+
+        ParserStatus parseReserve(char *argv, char *next);
+
+        ParserStatus parseSplitWorkers(char *argv, char *next);
+
+        ParserStatus parseFlatten(char *argv, char *next);
+
+        ParserStatus parseShrink(char *argv, char *next);
+
+        ParserStatus parseReopen(char *argv, char *next);
     };
 } // namespace Dalea
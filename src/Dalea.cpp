@@ -1,5 +1,6 @@
 #include "Dalea.hpp"
 
+#include <algorithm>
 #include <chrono>
 #include <iomanip>
 #include <thread>
@@ -8,14 +9,37 @@
     {                                         \
         Log(std::to_string(__LINE__) + "\n"); \
     }
-// #define TIMING
 #define PREALLOCATION
 namespace Dalea
 {
+    static uint64_t reverse_bits(uint64_t v)
+    {
+        v = ((v >> 1) & 0x5555555555555555UL) | ((v & 0x5555555555555555UL) << 1);
+        v = ((v >> 2) & 0x3333333333333333UL) | ((v & 0x3333333333333333UL) << 2);
+        v = ((v >> 4) & 0x0F0F0F0F0F0F0F0FUL) | ((v & 0x0F0F0F0F0F0F0F0FUL) << 4);
+        return __builtin_bswap64(v);
+    }
+
+    // body(worker, begin, end) on thread_num contiguous ranges of [0, total)
+    static void parallel_ranges(int thread_num, uint64_t total, const std::function<void(int, uint64_t, uint64_t)> &body)
+    {
+        auto part = (total + thread_num - 1) / thread_num;
+        std::vector<std::thread> workers;
+        for (int t = 0; t < thread_num; t++)
+        {
+            auto begin = std::min(total, t * part);
+            workers.emplace_back(body, t, begin, std::min(total, begin + part));
+        }
+        for (auto &w : workers)
+        {
+            w.join();
+        }
+    }
+
     SegmentPtrQueue::SegmentPtrQueue(PoolBase &pop, int init_cap) : capacity(init_cap), size(0)
     {
-        TX::run(pop, [&]() {
-            buffer = pobj::make_persistent<SegmentPtr[]>(init_cap + 1);
+        Backend::Run(pop, [&]() {
+            buffer = Backend::Make<SegmentPtr[]>(init_cap + 1);
         });
 
         head = tail = 0;
@@ -59,37 +83,123 @@ namespace Dalea
         return size != capacity;
     }
 
-    HashTable::HashTable(PoolBase &pop, int thread_num)
-        : dir(pop),
+    HashTable::HashTable(PoolBase &pop, int thread_num, uint64_t reserve, int pool_segments, const std::string &log_file)
+        : segment_pool(pop, pool_segments),
           depth(1),
+          reserved_depth(1),
+          dir(pop),
+          capacity(2 * SEG_SIZE * BUCKET_SIZE),
           to_double(false),
           readers(0),
-          logger(std::string("./dalea.log")),
-          capacity(2 * SEG_SIZE * BUCKET_SIZE),
-          segment_pool(pop, 4096 * 8)
+          scanners(0),
+          splitters(0),
+          logger(log_file),
+          cache(nullptr),
+          slab(nullptr),
+          values(nullptr),
+          overflow(nullptr),
+          defer_splits(false),
+          flatten_threshold(0),
+          retired(nullptr),
+          removed(0),
+          shrink_cursor(0),
+          shrinking(false)
     {
         std::cout << "segment pool is at " << &segment_pool << "\n";
-        stash_limits.reserve(thread_num);
-        for (int i = 0; i < thread_num; i++)
-        {
-            stash_limits.push_back(0);
-        }
+        slab = new SlabAllocator(slabs);
+        values = new ValueLog(value_chunks);
+        slab->LogValues(values, 0);
+        overflow = new OverflowArea(pop, overflow_slots);
+        retired = new std::vector<std::pair<SegmentPtr, uint64_t>>;
 #ifdef PREALLOCATION
-        TX::run(pop, [&]() {
-            for (int i = 0; i < 4096 * 8; i++)
+        Backend::Run(pop, [&]() {
+            for (int i = 0; i < pool_segments; i++)
             {
-                auto ptr = pobj::make_persistent<Segment>(pop, 0, 0, false);
+                auto ptr = Backend::Make<Segment>(pop, 0, 0, false);
                 segment_pool.Push(ptr);
             }
         });
 
 #endif
+        if (reserve != 0 && Reserve(pop, reserve, thread_num) != FunctionStatus::Ok)
+        {
+            std::cout << "reserving failed\n";
+        }
     }
 
     FunctionStatus HashTable::Put(PoolBase &pop, Stats &stats, int thread_id, const std::string &key, const std::string &value) noexcept
     {
         auto hv = HashValue(std::hash<std::string>{}(key));
+        auto full = false;
+        auto ret = modify(pop, stats, hv, [&](Bucket &bkt, Bucket::BucketCache *side, uint64_t segno) {
+            // an update frees the old pair, the cache must not hand it out from then on
+            if (cache)
+            {
+                cache->Invalidate(hv.GetRaw());
+            }
+            auto slot = overflow_slot(bkt, side, segno, key, hv);
+            if (slot != -1)
+            {
+                overflow->Replace(pop, *slab, slot, key, value);
+                Metrics::Add(Metric::PutUpdates);
+                return FunctionStatus::Ok;
+            }
+#ifdef LOGGING
+            auto ret = bkt.Put(logger, pop, *slab, key, value, hv, segno, side);
+#else
+            auto ret = bkt.Put(pop, *slab, key, value, hv, segno, side);
+#endif
+            if (ret == FunctionStatus::SplitRequired && defer_splits)
+            {
+                if (overflow->Insert(pop, *slab, key, value, hv))
+                {
+                    Metrics::Add(Metric::PutInserts);
+                    return FunctionStatus::Ok;
+                }
+                full = true;
+            }
+            return ret;
+        });
+        if (full)
+        {
+            Metrics::Add(Metric::OverflowFull);
+        }
+        if (ret != FunctionStatus::Ok)
+        {
+            Metrics::Add(Metric::PutFailures);
+        }
+        return ret;
+    }
+
+    FunctionStatus HashTable::FetchAdd(PoolBase &pop, Stats &stats, const std::string &key, int64_t delta, int64_t &previous) noexcept
+    {
+        auto hv = HashValue(std::hash<std::string>{}(key));
+        return modify(pop, stats, hv, [&](Bucket &bkt, Bucket::BucketCache *side, uint64_t segno) {
+            // parked pairs are never counters
+            if (overflow_slot(bkt, side, segno, key, hv) != -1)
+            {
+                return FunctionStatus::Failed;
+            }
+            return bkt.FetchAdd(pop, *slab, key, delta, previous, hv, segno, side);
+        });
+    }
+
+    FunctionStatus HashTable::CompareExchange(PoolBase &pop, Stats &stats, const std::string &key, int64_t &expected, int64_t desired) noexcept
+    {
+        auto hv = HashValue(std::hash<std::string>{}(key));
+        return modify(pop, stats, hv, [&](Bucket &bkt, Bucket::BucketCache *side, uint64_t segno) {
+            if (overflow_slot(bkt, side, segno, key, hv) != -1)
+            {
+                return FunctionStatus::Failed;
+            }
+            return bkt.CompareExchange(pop, key, expected, desired, hv, segno, side);
+        });
+    }
 
+    template <typename F>
+    FunctionStatus HashTable::modify(PoolBase &pop, Stats &stats, const HashValue &hv, F &&op) noexcept
+    {
+        Epoch::Guard guard;
         // make sure there is no doubling thread
     RETRY:
 
@@ -99,8 +209,8 @@ namespace Dalea
             // if (stash_limits[thread_id] < STASH_LIMIT)
             // {
             //     KVPairPtr ptr = nullptr;
-            //     TX::run(pop, [&]() {
-            //         ptr = pobj::make_persistent<KVPair>(key, value);
+            //     Backend::Run(pop, [&]() {
+            //         ptr = Backend::Make<KVPair>(key, value);
             //     });
             //     HashPair p(ptr, hv);
             //     stash.insert({key, p});
@@ -108,6 +218,7 @@ namespace Dalea
             // }
             // else
             // {
+                Metrics::Add(Metric::RetryDoubling);
                 goto RETRY;
             // }
         }
@@ -117,149 +228,856 @@ namespace Dalea
 
         // starts trying put
         auto pos = hv.SegmentBits(depth);
-        auto seg = dir.GetSegment(pos);
-        auto bkt = &seg->buckets[hv.BucketBits()];
+        auto seg = dir.GetShadow(pos);
+        auto bkt = &seg->segment->buckets[hv.BucketBits()];
+        auto side = seg->Side(hv.BucketBits());
 
 #ifdef LOGGING
-        std::stringstream log_buf;
-        log_buf << "first putting " << key << "(" << std::hex << hv.GetRaw() << std::dec << ")"
-                << " to (" << seg->segment_no << ", " << hv.BucketBits() << "), global depth: "
-                << uint64_t(depth) << ", bucket depth: " << uint64_t(bkt->metainfo.local_depth) << "\n";
-        Log(log_buf);
+        logger.Record(LogEvent::PutFirst, hv.GetRaw(), seg->segment_no, hv.BucketBits(), depth, bkt->GetDepth(side));
 #endif
-        if (bkt->metainfo.has_ancestor)
+        auto redirected = bkt->HasAncestor(side);
+        if (redirected)
         {
-            auto ans = bkt->GetAncestor();
-            seg = dir.GetSegment(ans);
-            bkt = &seg->buckets[hv.BucketBits()];
+            auto ans = bkt->GetAncestor(side);
+            seg = dir.GetShadow(ans);
+            bkt = &seg->segment->buckets[hv.BucketBits()];
+            side = seg->Side(hv.BucketBits());
 #ifdef LOGGING
-            log_buf << ">#< changing putting " << key << "(" << std::hex << hv.GetRaw() << std::dec << ")"
-                    << " to (" << seg->segment_no << ", " << hv.BucketBits() << "), global depth: " << uint64_t(depth) << "\n";
-            Log(log_buf);
+            logger.Record(LogEvent::PutRedirect, hv.GetRaw(), seg->segment_no, hv.BucketBits(), depth);
 #endif
         }
-#ifdef LOGGING
-        else
-        {
-            log_buf << ">#< no ancestor detected\n";
-            Log(log_buf);
-        }
-#endif
-        if (!bkt->TryLock())
+        if (!bkt->TryLock(side))
         {
+            Metrics::Add(Metric::LockFailures);
+            Metrics::Add(Metric::RetryLocked);
             // reader_lock.unlock_shared();
             --readers;
             goto RETRY;
         }
-#ifdef LOGGING
-        auto ret = bkt->Put(logger, pop, key, value, hv, seg->segment_no);
-#else
-        auto ret = bkt->Put(pop, key, value, hv, seg->segment_no);
-#endif
+        auto ret = op(*bkt, side, seg->segment_no);
         switch (ret)
         {
         case FunctionStatus::Retry:
         {
 #ifdef LOGGING
-            std::stringstream buf;
-            buf << "Reader lock unlocked "
-                << " (" << seg->segment_no << ", " << hv.BucketBits() << ") in Retry\n";
-            Log(buf);
+            logger.Record(LogEvent::PutRetry, hv.GetRaw(), seg->segment_no, hv.BucketBits());
 #endif
         }
-            bkt->Unlock();
+            Metrics::Add(Metric::RetryStale);
+            bkt->Unlock(side);
             //reader_lock.unlock_shared();
             --readers;
             goto RETRY;
         case FunctionStatus::SplitRequired:
         {
+            // a running scan or Shrink forbids moving pairs, back off without holding the bucket
+            if (!enter_split())
+            {
+                Metrics::Add(Metric::RetryScan);
+                bkt->Unlock(side);
+                --readers;
+                goto RETRY;
+            }
             // lock is acquired inside split depending on global depth
-            split(pop, stats, *bkt, hv, seg, seg->segment_no);
+            split(pop, stats, *bkt, hv, seg->segment, seg->segment_no);
+            leave_split();
 
 #ifdef LOGGING
-            std::stringstream buf;
-            buf << "Reader lock unlocked "
-                << " (" << seg->segment_no << ", " << hv.BucketBits() << ") in SplitRequired\n";
-            Log(buf);
+            logger.Record(LogEvent::PutSplit, hv.GetRaw(), seg->segment_no, hv.BucketBits());
+#endif
+        }
+            Metrics::Add(Metric::RetrySplit);
+            bkt->Unlock(side);
+            // reader_lock.unlock_shared();
+            --readers;
+            goto RETRY;
+        default:
+        {
+#ifdef LOGGING
+            logger.Record(LogEvent::PutDone, hv.GetRaw(), seg->segment_no, hv.BucketBits(), ret);
 #endif
         }
-            bkt->Unlock();
-            // reader_lock.unlock_shared();
-            --readers;
-            goto RETRY;
-        case FunctionStatus::FlattenRequired:
+            if (redirected)
+            {
+                Metrics::Add(Metric::AncestorRedirects);
+                if (ret == FunctionStatus::Ok && flatten_threshold != 0 && bkt->Count(seg->segment_no, side) >= int(flatten_threshold))
+                {
+                    flatten_bucket(pop, stats, *bkt, hv, seg->segment_no);
+                }
+            }
+            bkt->Unlock(side);
+            // reader_lock.unlock_shared();
+            --readers;
+            ++loaded;
+            return ret;
+        }
+    }
+
+    KVPairPtr HashTable::Get(const std::string &key) const noexcept
+    {
+        KVPairPtr ret = nullptr;
+        // keeps pairs freed and segments unlinked by Shrink meanwhile from being reused, on every path
+        Epoch::Guard guard;
+
+        auto hv = HashValue(std::hash<std::string>{}(key));
+        uint64_t version = 0;
+        if (cache)
+        {
+            if (cache->Get(hv.GetRaw(), key, ret, version))
+            {
+                Metrics::Add(Metric::CacheHits);
+                return ret;
+            }
+            Metrics::Add(Metric::CacheMisses);
+        }
+        // a parked pair is linked into its bucket before its slot is cleared, so look here first
+        if (overflow->Used() != 0 && overflow->Get(key, hv, ret))
+        {
+            Metrics::Add(Metric::GetHits);
+            return ret;
+        }
+RETRY:
+        auto seg = dir.GetShadow(hv, depth);
+        auto bkt = &seg->segment->buckets[hv.BucketBits()];
+        auto side = seg->Side(hv.BucketBits());
+#ifdef LOGGING
+        logger.Record(LogEvent::GetSearch, hv.GetRaw(), seg->segment_no, hv.BucketBits());
+#endif
+        // keys of a bucket that has not split yet live in its ancestor, as in Put
+        auto redirected = bkt->HasAncestor(side);
+        if (redirected)
+        {
+            auto ans = bkt->GetAncestor(side);
+            seg = dir.GetShadow(ans);
+            bkt = &seg->segment->buckets[hv.BucketBits()];
+            side = seg->Side(hv.BucketBits());
+#ifdef LOGGING
+            logger.Record(LogEvent::GetRedirect, hv.GetRaw(), seg->segment_no, hv.BucketBits());
+#endif
+        }
+        auto status = bkt->Get(key, hv, ret, seg->segment_no, side);
+        // counted once per lookup, a retry looks the bucket up anew
+        if (redirected && status != FunctionStatus::Retry)
+        {
+            Metrics::Add(Metric::AncestorRedirects);
+        }
+        switch (status)
+        {
+            case FunctionStatus::Ok:
+                Metrics::Add(Metric::GetHits);
+                if (cache)
+                {
+                    cache->Insert(hv.GetRaw(), ret, version);
+                }
+                break;
+            case FunctionStatus::Retry:
+                Metrics::Add(Metric::RetryStale);
+                goto RETRY;
+            default:
+                Metrics::Add(Metric::GetMisses);
+                return nullptr;
+        }
+        return ret;
+    }
+
+    FunctionStatus HashTable::Remove(PoolBase &pop, const std::string &key) noexcept
+    {
+        auto hv = HashValue(std::hash<std::string>{}(key));
+        Epoch::Guard guard;
+    RETRY:
+        // directory doubling and halving concurrency control, same as Put
+        if (to_double)
+        {
+            Metrics::Add(Metric::RetryDoubling);
+            goto RETRY;
+        }
+        ++readers;
+
+        auto seg = dir.GetShadow(hv, depth);
+        auto bkt = &seg->segment->buckets[hv.BucketBits()];
+        auto side = seg->Side(hv.BucketBits());
+        auto redirected = bkt->HasAncestor(side);
+        if (redirected)
+        {
+            seg = dir.GetShadow(bkt->GetAncestor(side));
+            bkt = &seg->segment->buckets[hv.BucketBits()];
+            side = seg->Side(hv.BucketBits());
+        }
+        if (!bkt->TryLock(side))
+        {
+            Metrics::Add(Metric::LockFailures);
+            Metrics::Add(Metric::RetryLocked);
+            --readers;
+            goto RETRY;
+        }
+        // before the pair is freed, as in Put
+        if (cache)
+        {
+            cache->Invalidate(hv.GetRaw());
+        }
+        auto ret = FunctionStatus::Ok;
+        auto slot = overflow_slot(*bkt, side, seg->segment_no, key, hv);
+        if (slot != -1)
+        {
+            overflow->Remove(pop, *slab, slot);
+        }
+        else
+        {
+            ret = bkt->Remove(pop, *slab, key, hv, seg->segment_no, side);
+        }
+        bkt->Unlock(side);
+        --readers;
+        if (ret == FunctionStatus::Retry)
+        {
+            Metrics::Add(Metric::RetryStale);
+            goto RETRY;
+        }
+        if (redirected)
+        {
+            Metrics::Add(Metric::AncestorRedirects);
+        }
+        if (ret == FunctionStatus::Ok)
+        {
+            removed.fetch_add(1, std::memory_order_relaxed);
+        }
+        Metrics::Add(ret == FunctionStatus::Ok ? Metric::RemoveHits : Metric::RemoveMisses);
+        return ret;
+    }
+
+    /*
+     * Puts, Removes and Gets keep running, bucket locks fence them off from a merge; splits
+     * and scans wait, so that no bucket changes its depth or ancestor but through Shrink
+     * 1. recycle segments unlinked by earlier calls once no operation can still be in them
+     * 2. below the cursor, merge buddy buckets as long as both are sparse enough, and unlink
+     *    segments that own no bucket; their directory entries alias the segment that would
+     *    have been there had they never been created. Descending, so that an alias
+     *    redirected to a segment unlinked later is fixed again
+     * 3. at the end of a sweep, halve the directory while its upper half only holds aliases
+     */
+    uint64_t HashTable::Shrink(PoolBase &pop, Stats &stats) noexcept
+    {
+        if (shrink_cursor == 0 && removed.load(std::memory_order_relaxed) == 0 && retired->empty())
+        {
+            return 0;
+        }
+        if (!enter_shrink())
+        {
+            return 0;
+        }
+
+        reclaim_segments(pop);
+
+        if (shrink_cursor == 0 && removed.exchange(0) != 0)
+        {
+            shrink_cursor = (1UL << depth);
+        }
+        auto retiring = retired->size();
+        uint64_t merged = 0;
+        auto last = shrink_cursor > SHRINK_SLICE ? shrink_cursor - SHRINK_SLICE : 0;
+        for (auto i = shrink_cursor; i > last; i--)
+        {
+            auto root = dir.GetShadowSegment(i - 1);
+            if (root->segment_no != i - 1)
+            {
+                continue;
+            }
+            for (uint64_t j = 0; j < SEG_SIZE; j++)
+            {
+                // a merged bucket may be sparse enough to merge with its buddy one level up
+                while (merge_buckets(pop, stats, root, i - 1, j))
+                {
+                    ++merged;
+                }
+            }
+            if (i - 1 >= 2 && !root->OwnsBuckets())
+            {
+                free_segment(pop, stats, i - 1);
+            }
+        }
+        shrink_cursor = last;
+        if (retired->size() != retiring)
+        {
+            auto epoch = Epoch::Advance();
+            for (auto it = retired->begin() + retiring; it != retired->end(); ++it)
+            {
+                it->second = epoch;
+            }
+        }
+
+        // halving changes the depth Puts and Removes work with, so it holds them off like a doubling
+        auto expected = false;
+        if (shrink_cursor == 0 && depth > 1 && !materialized(depth) && to_double.compare_exchange_strong(expected, true))
+        {
+            while (readers != 0)
+                ;
+            while (depth > 1 && !materialized(depth))
+            {
+                --depth;
+                Persist(pop, &depth, sizeof(depth));
+                stats.halvings++;
+                Timeline::Record(Event::Halving, Timeline::Now(), 0);
+            }
+            to_double = false;
+        }
+        leave_shrink();
+        return merged;
+    }
+
+    bool HashTable::materialized(uint8_t at) const noexcept
+    {
+        auto half = (1UL << (at - 1));
+        for (auto i = half; i < 2 * half; i++)
+        {
+            if (dir.GetShadowSegment(i)->segment_no == i)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    FunctionStatus HashTable::BulkLoad(PoolBase &pop, const std::vector<BulkPair> &pairs, int thread_num) noexcept
+    {
+        return exclusive([&]() {
+            return bulk_build(pop, pairs, thread_num);
+        });
+    }
+
+    FunctionStatus HashTable::Reserve(PoolBase &pop, uint64_t n, int thread_num) noexcept
+    {
+        uint8_t depth_limit = 63 - __builtin_clzl(uint64_t(METADIR_SIZE) * SUBDIR_SIZE);
+        uint8_t new_depth = 1;
+        while (new_depth < depth_limit && (SEG_SIZE * BUCKET_SIZE * RESERVE_LOAD) * (1UL << new_depth) < n)
+        {
+            new_depth++;
+        }
+        return exclusive([&]() {
+            return reserve_segments(pop, new_depth, thread_num);
+        });
+    }
+
+    FunctionStatus HashTable::exclusive(const std::function<FunctionStatus()> &build) noexcept
+    {
+        auto expected = false;
+        if (!to_double.compare_exchange_strong(expected, true))
+        {
+            return FunctionStatus::Failed;
+        }
+        while (readers != 0)
+            ;
+        if (!enter_split())
+        {
+            to_double = false;
+            return FunctionStatus::Failed;
+        }
+        auto ret = build();
+        leave_split();
+        to_double = false;
+        return ret;
+    }
+
+    bool HashTable::pristine() const noexcept
+    {
+        if (depth != 1 || overflow->Used() != 0)
+        {
+            return false;
+        }
+        for (uint64_t i = 0; i < 2; i++)
+        {
+            for (const auto &bkt : dir.GetShadowSegment(i)->buckets)
+            {
+                if (bkt.Count(i) != 0)
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // every segment of new_depth is made at that depth, segments 0 and 1 are replaced
+    FunctionStatus HashTable::reserve_segments(PoolBase &pop, uint8_t new_depth, int thread_num) noexcept
+    {
+        if (!pristine())
+        {
+            return FunctionStatus::Failed;
+        }
+        if (new_depth == depth)
+        {
+            return FunctionStatus::Ok;
+        }
+
+        std::vector<SegmentPtr> table(1UL << new_depth, nullptr);
+        parallel_ranges(std::max(thread_num, 1), table.size(), [&](int t, uint64_t first, uint64_t last) {
+            for (auto segno = first; segno < last; segno++)
+            {
+                auto seg = new_segment(pop, new_depth, segno);
+                for (auto &bkt : seg->buckets)
+                {
+                    // a preallocated segment comes with depth 0
+                    bkt.SetDepth(new_depth);
+                }
+                seg->status = SegStatus::Quiescent;
+                Persist(pop, seg.get(), sizeof(Segment));
+                table[segno] = seg;
+            }
+        });
+
+        publish_segments(pop, table, new_depth);
+        reserved_depth = new_depth;
+        Persist(pop, &reserved_depth, sizeof(reserved_depth));
+        capacity = table.size() * SEG_SIZE * BUCKET_SIZE;
+        return FunctionStatus::Ok;
+    }
+
+    /*
+     * 1. hash every key and radix partition by bucket bits
+     * 2. per bucket, sort by reversed hash so that every class of segment bits is one
+     *    contiguous range, then split classes from depth 1 on until each fits into a bucket
+     * 3. the deepest class decides global depth; each class is owned by the bucket in the
+     *    segment named by its bits, buckets of deeper segments in the class redirect to it
+     * 4. fill every owning segment with one allocation transaction and one flush, then
+     *    publish the directory
+     */
+    FunctionStatus HashTable::bulk_build(PoolBase &pop, const std::vector<BulkPair> &pairs, int thread_num) noexcept
+    {
+        if (!pristine())
+        {
+            return FunctionStatus::Failed;
+        }
+        thread_num = std::max(thread_num, 1);
+        auto total = pairs.size();
+
+        std::vector<uint64_t> hashes(total);
+        std::vector<std::vector<uint64_t>> offsets(thread_num, std::vector<uint64_t>(SEG_SIZE, 0));
+        parallel_ranges(thread_num, total, [&](int t, uint64_t begin, uint64_t end) {
+            for (auto i = begin; i < end; i++)
+            {
+                // same value as std::hash<std::string> on equal characters
+                HashValue hv(std::hash<std::string_view>{}(pairs[i].first));
+                hashes[i] = hv.GetRaw();
+                offsets[t][hv.BucketBits()]++;
+            }
+        });
+
+        // bucket major, worker minor, so that workers scatter into disjoint ranges
+        std::vector<uint64_t> bucket_begin(SEG_SIZE + 1, 0);
+        std::vector<uint64_t> bucket_end(SEG_SIZE, 0);
+        uint64_t running = 0;
+        for (int b = 0; b < SEG_SIZE; b++)
+        {
+            bucket_begin[b] = running;
+            for (int t = 0; t < thread_num; t++)
+            {
+                auto count = offsets[t][b];
+                offsets[t][b] = running;
+                running += count;
+            }
+        }
+        bucket_begin[SEG_SIZE] = running;
+
+        // (reversed hash, index into pairs)
+        std::vector<std::pair<uint64_t, uint64_t>> entries(total);
+        parallel_ranges(thread_num, total, [&](int t, uint64_t begin, uint64_t end) {
+            for (auto i = begin; i < end; i++)
+            {
+                entries[offsets[t][HashValue(hashes[i]).BucketBits()]++] = {reverse_bits(hashes[i]), i};
+            }
+        });
+
+        struct Leaf
+        {
+            uint64_t key; // reversed prefix, leaves of a bucket are sorted by it
+            uint64_t prefix;
+            uint8_t depth;
+            uint64_t begin;
+            uint64_t end;
+        };
+        std::vector<std::vector<Leaf>> leaves(SEG_SIZE);
+        std::vector<uint8_t> max_depth(thread_num, 1);
+        std::atomic_bool too_deep = false;
+        uint8_t depth_limit = 63 - __builtin_clzl(uint64_t(METADIR_SIZE) * SUBDIR_SIZE);
+        parallel_ranges(thread_num, SEG_SIZE, [&](int t, uint64_t first, uint64_t last) {
+            for (auto b = first; b < last; b++)
+            {
+                auto begin = entries.begin() + bucket_begin[b];
+                auto end = entries.begin() + bucket_begin[b + 1];
+                std::sort(begin, end, [&](const auto &l, const auto &r) {
+                    if (l.first != r.first)
+                    {
+                        return l.first < r.first;
+                    }
+                    auto cmp = pairs[l.second].first.compare(pairs[r.second].first);
+                    return cmp != 0 ? cmp < 0 : l.second < r.second;
+                });
+
+                // the last occurrence of a key wins
+                auto kept = begin;
+                for (auto it = begin; it != end; ++it)
+                {
+                    auto next = it + 1;
+                    if (next != end && next->first == it->first && pairs[next->second].first == pairs[it->second].first)
+                    {
+                        continue;
+                    }
+                    *kept++ = *it;
+                }
+                bucket_end[b] = kept - entries.begin();
+
+                // depth 0 always splits, segments 0 and 1 exist from the start
+                std::function<void(uint64_t, uint8_t, uint64_t, uint64_t)> classify = [&](uint64_t prefix, uint8_t d, uint64_t lo, uint64_t hi) {
+                    if (d > 0 && hi - lo <= BUCKET_SIZE)
+                    {
+                        leaves[b].push_back({reverse_bits(prefix), prefix, d, lo, hi});
+                        max_depth[t] = std::max(max_depth[t], d);
+                        return;
+                    }
+                    if (d == depth_limit)
+                    {
+                        too_deep = true;
+                        return;
+                    }
+                    // bit d of a hash is bit 63 - d of its reverse
+                    auto mid = std::partition_point(entries.begin() + lo, entries.begin() + hi, [&](const auto &e) {
+                                   return ((e.first >> (63 - d)) & 1) == 0;
+                               }) -
+                               entries.begin();
+                    classify(prefix, d + 1, lo, mid);
+                    classify(prefix | (1UL << d), d + 1, mid, hi);
+                };
+                classify(0, 0, bucket_begin[b], bucket_end[b]);
+            }
+        });
+        if (too_deep)
+        {
+            return FunctionStatus::Failed;
+        }
+
+        auto new_depth = *std::max_element(max_depth.begin(), max_depth.end());
+        std::vector<uint8_t> materialized(1UL << new_depth, 0);
+        materialized[0] = materialized[1] = 1;
+        for (const auto &ls : leaves)
+        {
+            for (const auto &leaf : ls)
+            {
+                materialized[leaf.prefix] = 1;
+            }
+        }
+        std::vector<uint64_t> segnos;
+        for (uint64_t i = 0; i < materialized.size(); i++)
+        {
+            if (materialized[i])
+            {
+                segnos.push_back(i);
+            }
+        }
+
+        std::vector<SegmentPtr> table(1UL << new_depth, nullptr);
+        parallel_ranges(thread_num, segnos.size(), [&](int t, uint64_t first, uint64_t last) {
+            std::vector<const Leaf *> classes(SEG_SIZE);
+            std::vector<KVPairPtr> fresh;
+            for (auto i = first; i < last; i++)
+            {
+                auto segno = segnos[i];
+                auto key = reverse_bits(segno);
+                for (int b = 0; b < SEG_SIZE; b++)
+                {
+                    // the class containing segno, the first leaf always has key 0
+                    classes[b] = &*(std::upper_bound(leaves[b].begin(), leaves[b].end(), key, [](uint64_t k, const Leaf &l) {
+                                        return k < l.key;
+                                    }) -
+                                    1);
+                }
+
+                auto seg = new_segment(pop, 1, segno);
+                fresh.clear();
+                for (int b = 0; b < SEG_SIZE; b++)
+                {
+                    if (classes[b]->prefix != segno)
+                    {
+                        continue;
+                    }
+                    for (auto e = classes[b]->begin; e < classes[b]->end; e++)
+                    {
+                        const auto &kv = pairs[entries[e].second];
+                        fresh.push_back(slab->Make(pop, kv.first, kv.second));
+                    }
+                }
+
+                auto next = fresh.begin();
+                for (int b = 0; b < SEG_SIZE; b++)
+                {
+                    auto &bkt = seg->buckets[b];
+                    bkt.SetDepth(classes[b]->depth);
+                    if (classes[b]->prefix != segno)
+                    {
+                        bkt.SetAncestor(classes[b]->prefix);
+                        continue;
+                    }
+                    int slot = 0;
+                    for (auto e = classes[b]->begin; e < classes[b]->end; e++)
+                    {
+                        bkt.Fill(slot++, *next++, HashValue(reverse_bits(entries[e].first)));
+                    }
+                }
+                seg->status = SegStatus::Quiescent;
+                Persist(pop, seg.get(), sizeof(Segment));
+                table[segno] = seg;
+            }
+        });
+
+        publish_segments(pop, table, new_depth);
+        capacity = segnos.size() * SEG_SIZE * BUCKET_SIZE;
+        return FunctionStatus::Ok;
+    }
+
+    uint64_t HashTable::Capacity() const noexcept
+    {
+        return capacity;
+    }
+
+    void HashTable::EnableCache(uint64_t capacity) noexcept
+    {
+        // nothing may run on the table meanwhile
+        delete cache;
+        cache = capacity ? new ReadCache(capacity) : nullptr;
+    }
+
+    void HashTable::EnableFlattening(uint64_t threshold) noexcept
+    {
+        flatten_threshold = threshold == 0 ? 0 : std::max<uint64_t>(threshold, MERGE_THRESHOLD + 1);
+    }
+
+    void HashTable::EnableValueLog(uint64_t threshold) noexcept
+    {
+        slab->LogValues(values, threshold);
+    }
+
+    void HashTable::CollectValues(PoolBase &pop, Stats &stats) noexcept
+    {
+        if (values->Select() == 0)
+        {
+            return;
+        }
+        if (values->VictimBytes() != 0)
+        {
+            // pairs stay in their buckets while no split runs, so the walk sees each once
+            auto moving = [&](const KVPairPtr &pair) {
+                if (!pair->Logged() || !values->Collecting(pair->Ref()))
+                {
+                    return false;
+                }
+                // a Get cannot find the old pair meanwhile, the bucket is locked
+                if (cache)
+                {
+                    cache->Invalidate(HashValue(std::hash<std::string_view>{}(pair->Key())).GetRaw());
+                }
+                return true;
+            };
+            enter_scan();
+            for (uint64_t i = 0; i < DirectorySize(); i++)
+            {
+                auto seg = dir.GetShadowSegment(i);
+                if (seg->segment_no != i)
+                {
+                    continue;
+                }
+                for (auto &bkt : seg->buckets)
+                {
+                    bkt.Lock();
+                    stats.relocated_values += bkt.Relocate(pop, *slab, i, moving);
+                    bkt.Unlock();
+                }
+            }
+            // no pair is drained meanwhile, that takes a split
+            stats.relocated_values += overflow->Relocate(pop, *slab, moving);
+            leave_scan();
+        }
+        // Gets that read values from the victims may still run, they are reused next time only
+        stats.collected_chunks += values->Retire();
+    }
+
+    void HashTable::DeferSplits(bool defer) noexcept
+    {
+        defer_splits = defer;
+    }
+
+    uint64_t HashTable::RunSplits(PoolBase &pop, Stats &stats, std::chrono::microseconds wait) noexcept
+    {
+        uint64_t served = 0;
+        int slot;
+        HashValue hv;
+        while (overflow->Next(slot, hv, served == 0 ? wait : 0us))
         {
-            // fall through
+            // splits the bucket as often as it takes to link the pair
+            modify(pop, stats, hv, [&](Bucket &bkt, Bucket::BucketCache *side, uint64_t segno) {
+                // a scan must not see the pair in both places or in none
+                if (!bkt.Owns(hv, segno, side) || !enter_split())
+                {
+                    return FunctionStatus::Retry;
+                }
+                auto ret = overflow->Drain(pop, slot, hv, [&](const KVPairPtr &pair) {
+                    return bkt.Link(pop, pair, hv, segno, side);
+                });
+                leave_split();
+                return ret;
+            });
+            Metrics::Add(Metric::SplitsServed);
+            ++served;
         }
-        default:
+        return served;
+    }
+
+    uint64_t HashTable::PendingSplits() const noexcept
+    {
+        return overflow->Pending();
+    }
+
+    uint64_t HashTable::PeakPendingSplits() const noexcept
+    {
+        return overflow->PeakPending();
+    }
+
+    int HashTable::overflow_slot(const Bucket &bkt, Bucket::BucketCache *side, uint64_t segno, const std::string &key, const HashValue &hv) const noexcept
+    {
+        // a slot is only touched under the lock of the bucket owning its key
+        if (overflow->Used() == 0 || !bkt.Owns(hv, segno, side))
         {
-#ifdef LOGGING
-            std::stringstream buf;
-            buf << "Reader lock unlocked "
-                << " (" << seg->segment_no << ", " << hv.BucketBits() << ") in Default\n";
-            Log(buf);
-#endif
-        }
-            bkt->Unlock();
-            // reader_lock.unlock_shared();
-            --readers;
-            ++loaded;
-            return ret;
+            return -1;
         }
+        return overflow->Find(key, hv);
     }
 
-    KVPairPtr HashTable::Get(const std::string &key) const noexcept
+    void HashTable::ForEach(const std::function<void(const KVPairPtr &)> &func) noexcept
     {
-        KVPairPtr ret = nullptr;
+        ForEachInRange(0, DirectorySize(), func);
+    }
 
-        auto hv = HashValue(std::hash<std::string>{}(key));
-RETRY:
-        auto seg = dir.GetSegment(hv, depth);
-        auto bkt = &seg->buckets[hv.BucketBits()];
-#ifdef LOGGING
-        std::stringstream log_buf;
-        log_buf << "Searching " << key << ": (" << seg->segment_no << ", " << hv.BucketBits() << ")\n";
-        Log(log_buf);
-#endif
-        // if (bkt->metainfo.has_ancestor)
-        // {
-        //     auto ans = bkt->GetAncestor();
-        //     seg = dir.GetSegment(ans);
-        //     bkt = &seg->buckets[hv.BucketBits()];
-#ifdef LOGGING
-            log_buf << "Searching " << key << ": (" << seg->segment_no << ", " << hv.BucketBits() << ")\n";
-            Log(log_buf);
-#endif
-        // }
-#ifdef LOGGING
-        logger.Write(log_buf.str());
-#endif
-        switch (bkt->Get(key, hv, ret, seg->segment_no))
+    void HashTable::ForEach(int thread_num, const std::function<void(int, const KVPairPtr &)> &func) noexcept
+    {
+        enter_scan();
+        // depth is stable from here on since no split can start
+        auto total = DirectorySize();
+        auto part = (total + thread_num - 1) / thread_num;
+        std::vector<std::thread> workers;
+        for (int t = 0; t < thread_num; t++)
         {
-            case FunctionStatus::Ok:
-                break;
-            case FunctionStatus::Retry:
-                goto RETRY;
-            default:
-                return nullptr;
+            workers.emplace_back([&, t]() {
+                scan_segments(std::min(total, t * part), std::min(total, (t + 1) * part), [&](const KVPairPtr &kv) {
+                    func(t, kv);
+                });
+            });
         }
-        return ret;
+        for (auto &w : workers)
+        {
+            w.join();
+        }
+        leave_scan();
     }
 
-    FunctionStatus HashTable::Remove(PoolBase &pop, const std::string &key) noexcept
+    void HashTable::ForEachInRange(uint64_t begin, uint64_t end, const std::function<void(const KVPairPtr &)> &func) noexcept
     {
-        return FunctionStatus::Ok;
+        enter_scan();
+        scan_segments(begin, std::min(end, DirectorySize()), func);
+        leave_scan();
     }
 
-    uint64_t HashTable::Capacity() const noexcept
+    uint64_t HashTable::DirectorySize() const noexcept
     {
-        return capacity;
+        return 1UL << depth;
     }
 
     void HashTable::Destory() noexcept
     {
     }
 
+    void HashTable::Recover(PoolBase &pop, int thread_num, const std::string &log_file) noexcept
+    {
+        to_double = false;
+        readers = 0;
+        scanners = 0;
+        splitters = 0;
+        defer_splits = false;
+        flatten_threshold = 0;
+        // segments retired by the previous run stay unlinked, they are never reached again
+        retired = new std::vector<std::pair<SegmentPtr, uint64_t>>;
+        removed = 0;
+        shrink_cursor = 0;
+        shrinking = false;
+        // the cache of the previous run is gone with its process, EnableCache makes a new one
+        cache = nullptr;
+        // so are its log sink and whoever held these locks
+        new (&logger) Logger(log_file);
+        new (&doubling_lock) std::shared_mutex;
+        new (&segment_pool.lock) std::mutex;
+
+        // distinct segments are recovered in parallel; aliases share the owner's segment
+        auto total = (1UL << depth);
+        auto part = (total + thread_num - 1) / thread_num;
+        std::vector<std::thread> workers;
+        for (int t = 0; t < thread_num; t++)
+        {
+            workers.emplace_back([&, t]() {
+                auto end = std::min(total, (t + 1) * part);
+                for (auto i = t * part; i < end; i++)
+                {
+                    auto &seg = dir.GetSegment(i);
+                    if (seg->segment_no == i)
+                    {
+                        seg->Recover();
+                        seg->MakeShadow();
+                    }
+                }
+            });
+        }
+        for (auto &w : workers)
+        {
+            w.join();
+        }
+
+        // preallocated segments carry volatile state as well, but no shadow
+        for (int i = 0; i < segment_pool.size; i++)
+        {
+            segment_pool.buffer[(segment_pool.head + i) % segment_pool.capacity]->Recover();
+        }
+        // the mirror points to the shadows the segments made just now
+        dir.Recover(depth);
+
+        /*
+         * slots are free unless a linked pair holds them; stale slots left by splits are
+         * marked as well, a record that is still allocated may be leaked but never reused
+         */
+        slab = new SlabAllocator(slabs);
+        // every chunk is sealed until collected, EnableValueLog turns logging on again
+        values = new ValueLog(value_chunks);
+        slab->LogValues(values, 0);
+        overflow = new OverflowArea(pop, overflow_slots);
+        overflow->Mark(*slab);
+        for (uint64_t i = 0; i < total; i++)
+        {
+            auto seg = dir.GetShadowSegment(i);
+            if (seg->segment_no != i)
+            {
+                continue;
+            }
+            for (const auto &bkt : seg->buckets)
+            {
+                for (const auto &pair : bkt.pairs)
+                {
+                    if (pair)
+                    {
+                        slab->Mark(pair);
+                    }
+                }
+            }
+        }
+        slab->Sweep(pop);
+
+        // pairs parked before the restart are linked right away
+        Stats stats;
+        RunSplits(pop, stats, 0us);
+    }
+
     void HashTable::Debug() const noexcept
     {
         segment_pool.Pop();
@@ -352,10 +1170,88 @@ RETRY:
         msg_s.str("");
     }
 
+    bool HashTable::enter_split() noexcept
+    {
+        if (scanners != 0 || shrinking)
+        {
+            return false;
+        }
+        ++splitters;
+        if (scanners != 0 || shrinking)
+        {
+            --splitters;
+            return false;
+        }
+        return true;
+    }
+
+    void HashTable::leave_split() noexcept
+    {
+        --splitters;
+    }
+
+    void HashTable::enter_scan() noexcept
+    {
+        ++scanners;
+        // a Shrink call is short, the scan waits for it instead of failing it
+        while (shrinking)
+        {
+            --scanners;
+            std::this_thread::yield();
+            ++scanners;
+        }
+        while (splitters != 0)
+            ;
+    }
+
+    void HashTable::leave_scan() noexcept
+    {
+        --scanners;
+    }
+
+    bool HashTable::enter_shrink() noexcept
+    {
+        if (shrinking.exchange(true))
+        {
+            return false;
+        }
+        if (scanners != 0)
+        {
+            shrinking = false;
+            return false;
+        }
+        while (splitters != 0)
+            ;
+        return true;
+    }
+
+    void HashTable::leave_shrink() noexcept
+    {
+        shrinking = false;
+    }
+
+    void HashTable::scan_segments(uint64_t begin, uint64_t end, const std::function<void(const KVPairPtr &)> &func) const noexcept
+    {
+        for (auto i = begin; i < end; i++)
+        {
+            auto seg = dir.GetShadowSegment(i);
+            // an alias left by doubling, its owner is visited at its own index
+            if (seg->segment_no != i)
+            {
+                continue;
+            }
+            for (const auto &bkt : seg->buckets)
+            {
+                bkt.ForEach(i, func);
+            }
+        }
+        overflow->ForEach(begin, end, depth, func);
+    }
+
     /*
      * bucket bkt is already locked if this method is called
      */
-    void HashTable::split(PoolBase &pop, Stats &stats, Bucket &bkt, const HashValue &hv, SegmentPtr &seg, uint64_t segno) noexcept
+    void HashTable::split(PoolBase &pop, Stats &stats, Bucket &bkt, const HashValue &hv, Segment *seg, uint64_t segno) noexcept
     {
 #ifdef LOGGING
         Log(">>>> entering split\n");
@@ -371,7 +1267,7 @@ RETRY:
 #ifdef LOGGING
             Log(">>>> to complex split ");
 #endif
-            auto start = std::chrono::steady_clock::now();
+            auto event_start = Timeline::Now();
             auto expected = false;
             to_double.compare_exchange_strong(expected, true);
             if (expected)
@@ -379,25 +1275,26 @@ RETRY:
                 return;
             }
 
-            // complex split thread is the only reader;
-            while (readers != 1)
-                ;
+            {
+                // complex split thread is the only reader;
+                Tracer::Span wait("wait_for_readers");
+                while (readers != 1)
+                    ;
+            }
 
             if (!doubling_lock.try_lock())
             {
+                Metrics::Add(Metric::LockFailures);
 #ifdef LOGGING
                 Log(">>>> leaving split\n");
 #endif
                 return;
             }
-            auto wait_end = std::chrono::steady_clock::now();
-            std::cout << "complex waited for(ns): " << (wait_end - start).count() << "\n";
             complex_split(pop, stats, bkt, hv, seg, segno);
             // these two lines are executed inside compelx_split for fine-grained concurrency
             // doubling_lock.unlock();
             // to_double = false;
-            auto end = std::chrono::steady_clock::now();
-            std::cout << "complex split consumed(ns) in total: " << (end - start).count() << "\n";
+            Timeline::Record(Event::ComplexSplit, event_start, Timeline::Now() - event_start);
         }
 #ifdef LOGGING
         Log(">>>> leaving split\n");
@@ -430,6 +1327,7 @@ RETRY:
         stats.simple_splits++;
         capacity += BUCKET_SIZE;
         auto start = std::chrono::steady_clock::now();
+        Tracer::Span span("simple_split", "segment", buddy_segno);
 #ifdef LOGGING
         Log(">>>> entering simple_split\n");
 #endif
@@ -458,23 +1356,7 @@ RETRY:
             {
                 // a reference pointer pointing to one ancestor
                 // dir.SetSegment(pop, buddy_seg, walk);
-                SegmentPtr pre_seg = nullptr;
-#ifndef PREALLOCATION
-                TX::run(pop, [&]() {
-                    pre_seg = pobj::make_persistent<Segment>(pop, bkt.GetDepth(), walk, true);
-                });
-#else
-                if ((pre_seg = segment_pool.Pop()) == nullptr)
-                {
-                    TX::run(pop, [&]() {
-                        pre_seg = pobj::make_persistent<Segment>(pop, bkt.GetDepth(), walk, true);
-                    });
-                }
-                else
-                {
-                    pre_seg->segment_no = walk;
-                }
-#endif
+                SegmentPtr pre_seg = new_segment(pop, bkt.GetDepth(), walk);
 #ifdef LOGGING
                 std::stringstream log;
                 log << ">>>> creating new segment " << walk << " which connects to "
@@ -502,7 +1384,7 @@ RETRY:
 #endif
                 }
                 pre_seg->buckets[bktbits].SetAncestor(buddy_bkt->HasAncestor() ? buddy_bkt->GetAncestor() : buddy_segno);
-                TX::run(pop, [&]() {
+                Backend::Run(pop, [&]() {
                     dir.AddSegment(pop, pre_seg, walk);
                 });
                 dir.UnlockSegment(walk);
@@ -546,6 +1428,8 @@ RETRY:
 #ifdef LOGGING
         Log("entering traditional_split\n");
 #endif
+        Tracer::Span span("traditional_split", "segment", segno);
+        auto event_start = Timeline::Now();
         auto prev_depth = bkt.GetDepth();
         if (helper)
         {
@@ -564,9 +1448,13 @@ RETRY:
 
         // traditional split is combined here
         auto buddy = dir.LockSegment(buddy_segno);
-        if (root == buddy)
+        auto allocating = (root == buddy);
+        if (allocating)
         {
+            auto buddy_start = std::chrono::steady_clock::now();
             make_buddy_segment(pop, root, segno, buddy_segno, bkt);
+            stats.make_buddy++;
+            stats.make_buddy_time += (std::chrono::steady_clock::now() - buddy_start).count() / 1000000.0;
             stats.traditional_splits++;
             stats.simple_splits--;
             capacity += SEG_SIZE * BUCKET_SIZE;
@@ -575,6 +1463,7 @@ RETRY:
 
         simple_split(pop, stats, root_segno, buddy_segno, bkt, bktbits);
         bkt.ClearSplitPersist(pop);
+        Timeline::Record(allocating ? Event::TraditionalSplit : Event::SimpleSplit, event_start, Timeline::Now() - event_start);
 #ifdef LOGGING
         Log("leaving traditional_split\n");
 #endif
@@ -591,16 +1480,13 @@ RETRY:
      * 
      * only one thread woulding calling this method
      */
-    void HashTable::complex_split(PoolBase &pop, Stats &stats, Bucket &bkt, const HashValue &hv, SegmentPtr &seg, uint64_t segno) noexcept
+    void HashTable::complex_split(PoolBase &pop, Stats &stats, Bucket &bkt, const HashValue &hv, Segment *seg, uint64_t segno) noexcept
     {
         stats.complex_splits++;
 #ifdef LOGGING
         Log("entering complex_split\n");
 #endif
-#ifdef TIMING
-        std::cout << "Doing a complex split\n";
-        auto start = std::chrono::steady_clock::now();
-#endif
+        Tracer::Span span("complex_split", "segment", segno);
         /* 
          * bucket depth would not be changed during a doubling
          * becaused all puts to this bucket result in 
@@ -614,96 +1500,253 @@ RETRY:
         auto buddy_segno = root_segno | (1UL << prev_depth);
 
         SegmentPtr buddy = nullptr;
-#ifdef TIMING
-        auto d_start = std::chrono::steady_clock::now();
-#endif
-        dir.DoublingLink(pop, depth, depth + 1);
-#ifdef TIMING
-        auto d_end = std::chrono::steady_clock::now();
-        std::cout << "DoublingLink: " << (d_end - d_start).count() << "\n";
-#endif
+        auto link_start = Timeline::Now();
+        {
+            Tracer::Span link("DoublingLink", "new_depth", depth + 1);
+            dir.DoublingLink(pop, depth, depth + 1);
+        }
+        Timeline::Record(Event::Doubling, link_start, Timeline::Now() - link_start);
         auto root = dir.GetSegment(root_segno);
 
         // if (root == dir.GetSegment(buddy_segno))
         // {
-#ifdef TIMING
-        d_start = std::chrono::steady_clock::now();
-#endif
         ++depth;
-        pmemobj_persist(pop.handle(), &depth, sizeof(depth));
+        Persist(pop, &depth, sizeof(depth));
         dir.LockSegment(buddy_segno);
         doubling_lock.unlock();
         to_double = false;
+        auto buddy_start = std::chrono::steady_clock::now();
         buddy = make_buddy_segment(pop, root, segno, buddy_segno, bkt);
-#ifdef TIMING
-        d_end = std::chrono::steady_clock::now();
-        std::cout << "MakeBuddySegemnt: " << (d_end - d_start).count() << "\n";
-#endif
+        stats.make_buddy++;
+        stats.make_buddy_time += (std::chrono::steady_clock::now() - buddy_start).count() / 1000000.0;
         // }
 
         // traditional_split(pop, bkt, hv, segno, true);
-#ifdef TIMING
-        d_start = std::chrono::steady_clock::now();
-#endif
         simple_split(pop, stats, root_segno, buddy_segno, bkt, hv.BucketBits());
-#ifdef TIMING
-        d_end = std::chrono::steady_clock::now();
-        std::cout << "SimpleSplit: " << (d_end - d_start).count() << "\n";
-#endif
         buddy->status = SegStatus::Quiescent;
-        pmemobj_persist(pop.handle(), &buddy->status, sizeof(SegStatus));
+        Persist(pop, &buddy->status, sizeof(SegStatus));
         bkt.ClearSplitPersist(pop);
         dir.UnlockSegment(buddy_segno);
-#ifdef TIMING
-        auto end = std::chrono::steady_clock::now();
-        std::cout << "Finishing a complex split\n";
-        std::cout << "Time consumed(ns): " << (end - start).count() << "\n";
-#endif
 #ifdef LOGGING
         Log("leaving complex_split\n");
 #endif
     }
 
     /*
-     * NOT REQUIRED FOR DALEA NOW
+     * merge bucket bktbits of root with its buddy if both are sparse, runs while no split
+     * does; Puts and Removes are fenced off by the bucket locks, so both buckets are checked
+     * again once locked, and find the buddy redirecting afterwards
+     * 1. move the buddy's pairs into the root bucket (split byte marks the window)
+     * 2. root drops one level, buddy becomes a redirect to root
+     * 3. descendants that redirected to the buddy now redirect to root, there is no chaining
      */
-    void HashTable::flatten_bucket(PoolBase &pop, Bucket &bkt, const HashValue &hv, uint64_t segno) noexcept
+    bool HashTable::merge_buckets(PoolBase &pop, Stats &stats, Segment *root, uint64_t segno, uint64_t bktbits) noexcept
     {
+        auto &bkt = root->buckets[bktbits];
+        auto local_depth = bkt.GetDepth();
+        // only the lower buddy initiates a merge
+        if (bkt.HasAncestor() || local_depth <= reserved_depth || (segno >> (local_depth - 1)) != 0)
+        {
+            return false;
+        }
+
+        auto buddy_segno = segno | (1UL << (local_depth - 1));
+        auto buddy_seg = dir.GetShadowSegment(buddy_segno);
+        if (buddy_seg->segment_no != buddy_segno)
+        {
+            return false;
+        }
+        auto &buddy_bkt = buddy_seg->buckets[bktbits];
+        if (buddy_bkt.HasAncestor() || buddy_bkt.GetDepth() != local_depth)
+        {
+            return false;
+        }
+        if (bkt.Count(segno) > MERGE_THRESHOLD || buddy_bkt.Count(buddy_segno) > MERGE_THRESHOLD)
+        {
+            return false;
+        }
+
+        bkt.Lock();
+        buddy_bkt.Lock();
+        if (bkt.Count(segno) > MERGE_THRESHOLD || buddy_bkt.Count(buddy_segno) > MERGE_THRESHOLD)
+        {
+            buddy_bkt.Unlock();
+            bkt.Unlock();
+            return false;
+        }
+        bkt.SetSplitPersist(pop);
+        bkt.Merge(pop, buddy_bkt, segno, buddy_segno);
+        bkt.SetMetaPersist(pop, local_depth - 1, 1, (1UL << 49));
+        buddy_bkt.SetMetaPersist(pop, local_depth - 1, 0, segno);
+        bkt.ClearSplitPersist(pop);
+        buddy_bkt.Unlock();
+        bkt.Unlock();
+
+        for (auto walk = buddy_segno + (1UL << local_depth); walk < (1UL << depth); walk += (1UL << local_depth))
+        {
+            auto walk_ptr = dir.GetShadowSegment(walk);
+            if (walk_ptr->segment_no != walk)
+            {
+                continue;
+            }
+            auto &walk_bkt = walk_ptr->buckets[bktbits];
+            if (walk_bkt.HasAncestor() && walk_bkt.GetAncestor() == buddy_segno)
+            {
+                walk_bkt.Lock();
+                walk_bkt.SetAncestorPersist(pop, segno);
+                walk_bkt.Unlock();
+            }
+        }
+
+        stats.merges++;
+        capacity -= BUCKET_SIZE;
+        return true;
     }
 
-    SegmentPtr HashTable::make_buddy_segment(PoolBase &pop, const SegmentPtr &root, uint64_t segno, uint64_t buddy_segno, const Bucket &bkt) noexcept
+    /*
+     * segno owns no bucket, so every bucket's owner sits at a depth not covering segno's
+     * highest bit; the entry without that bit resolves all of them identically
+     */
+    void HashTable::free_segment(PoolBase &pop, Stats &stats, uint64_t segno) noexcept
     {
-#ifdef LOGGING
-        std::stringstream log;
-        log << ">>>> creating new segment " << buddy_segno << "\n";
-        Log(log);
-#endif
-        SegmentPtr buddy = nullptr;
-#ifdef TIMING
-        auto start = std::chrono::steady_clock::now();
-#endif
+        auto high = 63 - __builtin_clzl(segno);
+        SegmentPtr victim = dir.GetSegment(segno);
+        SegmentPtr replacement = dir.GetSegment(segno & ~(1UL << high));
+        Backend::Run(pop, [&]() {
+            for (auto i = segno; i < (1UL << depth); i += (1UL << (high + 1)))
+            {
+                if (dir.GetSegment(i) == victim)
+                {
+                    dir.SetSegment(pop, replacement, i);
+                }
+            }
+        });
+        // operations may still be inside, Shrink tags it with an epoch before recycling it
+        retired->emplace_back(victim, 0);
+        stats.freed_segments++;
+        capacity -= SEG_SIZE * BUCKET_SIZE;
+    }
 
+    SegmentPtr HashTable::new_segment(PoolBase &pop, uint8_t local_depth, uint64_t segno) noexcept
+    {
+        SegmentPtr seg = nullptr;
 #ifndef PREALLOCATION
-        TX::run(pop, [&]() {
-            buddy = pobj::make_persistent<Segment>(pop, bkt.GetDepth(), buddy_segno, true);
+        Tracer::Span span("allocate_segment", "segment", segno);
+        Backend::Run(pop, [&]() {
+            seg = Backend::Make<Segment>(pop, local_depth, segno, true);
         });
 #else
-        if ((buddy = segment_pool.Pop()) == nullptr)
         {
-            TX::run(pop, [&]() {
-                buddy = pobj::make_persistent<Segment>(pop, bkt.GetDepth(), buddy_segno, true);
+            Tracer::Span span("segment_pool_pop");
+            seg = segment_pool.Pop();
+        }
+        Metrics::Add(seg == nullptr ? Metric::SegmentPoolMisses : Metric::SegmentPoolHits);
+        if (seg == nullptr)
+        {
+            Tracer::Span span("allocate_segment", "segment", segno);
+            Backend::Run(pop, [&]() {
+                seg = Backend::Make<Segment>(pop, local_depth, segno, true);
             });
         }
         else
         {
-            buddy->segment_no = buddy_segno;
+            seg->Renumber(segno);
         }
 #endif
-#ifdef TIMING
-        auto end = std::chrono::steady_clock::now();
-        std::cout << "Allocating and initiailize new segment: " << (end - start).count() << "\n";
-        start = std::chrono::steady_clock::now();
+        // segments wait in the pool without DRAM copies, they are made once one is taken
+        seg->MakeShadow();
+        return seg;
+    }
+
+    void HashTable::recycle_segment(PoolBase &pop, const SegmentPtr &seg) noexcept
+    {
+        // a renumbered segment must not find pairs of its former encoding in slots or fingerprints
+        for (auto &bkt : seg->buckets)
+        {
+            bkt.Clear(pop);
+            bkt.SetMetaPersist(pop, 0, 0, (1UL << 49));
+        }
+        seg->DropShadow();
+        if (!segment_pool.Push(seg))
+        {
+            Backend::Run(pop, [&]() {
+                Backend::Delete<Segment>(seg);
+            });
+        }
+    }
+
+    void HashTable::reclaim_segments(PoolBase &pop) noexcept
+    {
+        auto live = std::partition(retired->begin(), retired->end(), [](const std::pair<SegmentPtr, uint64_t> &r) {
+            return !Epoch::Safe(r.second);
+        });
+        for (auto it = live; it != retired->end(); ++it)
+        {
+            recycle_segment(pop, it->first);
+        }
+        retired->erase(live, retired->end());
+    }
+
+    /*
+     * entries from 2 on are written while invisible behind the old depth; entries 0 and 1
+     * are swapped together with the depth in one transaction, which is the publishing point
+     */
+    void HashTable::publish_segments(PoolBase &pop, std::vector<SegmentPtr> &table, uint8_t new_depth) noexcept
+    {
+        SegmentPtr old[2] = {dir.GetSegment(0), dir.GetSegment(1)};
+        auto size = (1UL << new_depth);
+        for (uint64_t i = 2; i < size; i++)
+        {
+            if (table[i] == nullptr)
+            {
+                // already resolved, so this is the materialized buddy with the longest common suffix
+                table[i] = table[i & ~(1UL << (63 - __builtin_clzl(i)))];
+            }
+            dir.AddSegment(pop, table[i], i);
+        }
+        dir.Persist(pop, 2, size);
+
+        Backend::Run(pop, [&]() {
+            dir.SetSegment(pop, table[0], 0);
+            dir.SetSegment(pop, table[1], 1);
+            Backend::Snapshot(&depth, sizeof(depth));
+            depth = new_depth;
+        });
+        dir.RebuildShadow(depth);
+
+        // lock-free Gets may still be inside the replaced segments, usually none is and they are recycled at once
+        auto epoch = Epoch::Advance();
+        retired->emplace_back(old[0], epoch);
+        retired->emplace_back(old[1], epoch);
+        reclaim_segments(pop);
+    }
+
+    /*
+     * bkt is the locked ancestor an operation on hv was redirected to, the segment hv picks
+     * exists, so bkt sits below global depth and splits without a doubling. Each split halves
+     * the segments redirecting to bkt, hv gets a bucket of its own once bkt's local depth
+     * reaches its segment's. Skipped while a scan runs, a later operation tries again
+     */
+    void HashTable::flatten_bucket(PoolBase &pop, Stats &stats, Bucket &bkt, const HashValue &hv, uint64_t segno) noexcept
+    {
+        if (bkt.GetDepth() >= depth || !enter_split())
+        {
+            return;
+        }
+        traditional_split(pop, stats, bkt, hv, segno, false);
+        leave_split();
+        stats.flattens++;
+    }
+
+    SegmentPtr HashTable::make_buddy_segment(PoolBase &pop, const SegmentPtr &root, uint64_t segno, uint64_t buddy_segno, const Bucket &bkt) noexcept
+    {
+#ifdef LOGGING
+        std::stringstream log;
+        log << ">>>> creating new segment " << buddy_segno << "\n";
+        Log(log);
 #endif
+        Tracer::Span span("make_buddy_segment", "segment", buddy_segno);
+        SegmentPtr buddy = new_segment(pop, bkt.GetDepth(), buddy_segno);
         for (int i = 0; i < SEG_SIZE; i++)
         {
             // do not persist here
@@ -728,19 +1771,10 @@ RETRY:
 #endif
             }
         }
-#ifdef TIMING
-        end = std::chrono::steady_clock::now();
-        std::cout << "Initiailize buckets in new segment: " << (end - start).count() << "\n";
-
-        start = std::chrono::steady_clock::now();
-#endif
-        TX::run(pop, [&]() {
+        Backend::Run(pop, [&]() {
+            Tracer::Span add("AddSegment", "segment", buddy_segno);
             dir.AddSegment(pop, buddy, buddy_segno);
         });
-#ifdef TIMING
-        end = std::chrono::steady_clock::now();
-        std::cout << "nAdding segment: " << (end - start).count() << "\n";
-#endif
         return buddy;
     }
 } // namespace Dalea
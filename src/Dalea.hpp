@@ -1,15 +1,20 @@
 #ifndef __DALEA__
 #define __DALEA__
+#include "Cache/Cache.hpp"
 #include "Directory/Directory.hpp"
+#include "Epoch/Epoch.hpp"
 #include "Logger/Logger.hpp"
+#include "Overflow/Overflow.hpp"
 #include "Stats/Stats.hpp"
+#include "Timeline/Timeline.hpp"
+#include "Tracer/Tracer.hpp"
 
 #include <atomic>
 #include <chrono>
+#include <functional>
 #include <sstream>
+#include <string_view>
 #include <thread>
-#include <libpmemobj++/container/concurrent_hash_map.hpp>
-#include <libpmemobj++/container/vector.hpp>
 namespace Dalea
 {
     using namespace std::chrono_literals;
@@ -22,36 +27,115 @@ namespace Dalea
         bool HasSpace() const noexcept;
 
         std::mutex lock;
-        pobj::persistent_ptr<SegmentPtr[]> buffer;
+        Backend::Ptr<SegmentPtr[]> buffer;
         uint64_t head;
         uint64_t tail;
         int capacity;
         int size;
     };
 
-    struct HashPair
-    {
-        KVPairPtr kv;
-        HashValue hv;
-        HashPair(const KVPairPtr &_kv, const HashValue &_hv) : kv(_kv), hv(_hv) {};
-        HashPair(const HashPair &) = default;
-        HashPair(HashPair &&) = default;
-        HashPair &operator=(const HashPair &rhs) = default;
-    };
+    // key and value of a bulk load, both owned by the caller
+    using BulkPair = std::pair<std::string_view, std::string_view>;
 
     class HashTable
     {
     public:
-        HashTable(PoolBase &pop, int thread_num);
+        // share of the slots Reserve plans to fill, lower than what splits reach to spare them
+        static constexpr double RESERVE_LOAD = 0.5;
+        // directory entries one Shrink call sweeps
+        static constexpr uint64_t SHRINK_SLICE = 256;
+        // segments a table preallocates and keeps in its pool
+        static constexpr int POOL_SEGMENTS = 4096 * 8;
+        static constexpr const char *LOG_FILE = "./dalea.log";
+
+        // reserve > 0 presizes the table for that many pairs, see Reserve; tables sharing a process need log files of their own
+        HashTable(PoolBase &pop, int thread_num, uint64_t reserve = 0, int pool_segments = POOL_SEGMENTS, const std::string &log_file = LOG_FILE);
         HashTable() = delete;
         HashTable(const HashTable &) = delete;
         HashTable(HashTable &&) = delete;
 
         FunctionStatus Put(PoolBase &pop, Stats &stats, int thread_id, const std::string &key, const std::string &value) noexcept;
+        /*
+         * counters: the value is an int64 updated in place with one atomic store and one flush
+         * under the bucket lock. FetchAdd makes a counter of delta if the key is missing and
+         * sets previous to the value before, 0 then; Failed if the key holds no counter.
+         * CompareExchange stores desired if the counter equals expected, otherwise it sets
+         * expected to the current value and fails, as it does for a missing key or no counter
+         */
+        FunctionStatus FetchAdd(PoolBase &pop, Stats &stats, const std::string &key, int64_t delta, int64_t &previous) noexcept;
+        FunctionStatus CompareExchange(PoolBase &pop, Stats &stats, const std::string &key, int64_t &expected, int64_t desired) noexcept;
+        // the pair stays valid until Get returns, callers keeping it longer hold an Epoch::Guard around the call
         KVPairPtr Get(const std::string &key) const noexcept;
         FunctionStatus Remove(PoolBase &pop, const std::string &key) noexcept;
+        /*
+         * inverse of splitting, meant to be called periodically by a background thread:
+         * merges sparse buddy buckets, unlinks segments that no longer own any bucket and
+         * halves the directory when its upper half only holds aliases. A call sweeps at most
+         * SHRINK_SLICE directory entries, a sweep only starts after pairs were removed.
+         * Operations keep running, splits and scans wait for the call. Returns merges done
+         */
+        uint64_t Shrink(PoolBase &pop, Stats &stats) noexcept;
+        /*
+         * bottom-up construction of an empty table from a known key set: keys are partitioned
+         * by bucket, local depths are chosen so that no bucket overflows, segments are filled
+         * in parallel and the directory is published at once. Nothing else may run on the table
+         * meanwhile and the last value of a repeated key wins. Failed if the table is not empty
+         * or the keys need more segments than the directory holds
+         */
+        FunctionStatus BulkLoad(PoolBase &pop, const std::vector<BulkPair> &pairs, int thread_num) noexcept;
+        /*
+         * presizes an empty table for n pairs: global depth is set so that n pairs fill the
+         * segments to RESERVE_LOAD, and every segment is allocated at that depth and linked in
+         * parallel, so that loading n uniformly hashed pairs splits for skew only. Capped at the
+         * size of the directory; Failed if the table is not empty. Shrink keeps the depth reserved
+         */
+        FunctionStatus Reserve(PoolBase &pop, uint64_t n, int thread_num) noexcept;
         uint64_t Capacity() const noexcept;
+        // puts a read cache of capacity pairs in front of Get, volatile like the shadow directory
+        void EnableCache(uint64_t capacity) noexcept;
+        /*
+         * a Put redirected to an ancestor holding at least threshold pairs splits it right
+         * away, so that later operations on the redirecting segments find their own buckets
+         * and skip the extra segment and bucket read. Never below MERGE_THRESHOLD + 1, or
+         * Shrink would merge the halves back; 0 leaves ancestors to split when full
+         */
+        void EnableFlattening(uint64_t threshold) noexcept;
+        // values of at least threshold bytes go to a value log from now on, 0 keeps them inline
+        void EnableValueLog(uint64_t threshold) noexcept;
+        /*
+         * value log garbage collection, meant to be called periodically by a background thread:
+         * live values of mostly dead chunks are copied to a new chunk under their bucket locks,
+         * the chunks are reused by the next call. Splits wait meanwhile
+         */
+        void CollectValues(PoolBase &pop, Stats &stats) noexcept;
+        /*
+         * with splits deferred, an insert into a full bucket parks its pair in the overflow
+         * area and returns, the split is left to a background worker calling RunSplits.
+         * Inserts split in place while the area is full, counters always do
+         */
+        void DeferSplits(bool defer) noexcept;
+        /*
+         * background split worker: serves queued split requests until none is left, waiting
+         * up to wait for the first one, and returns their number. Splits count into stats
+         */
+        uint64_t RunSplits(PoolBase &pop, Stats &stats, std::chrono::microseconds wait) noexcept;
+        uint64_t PendingSplits() const noexcept;
+        uint64_t PeakPendingSplits() const noexcept;
+
+        /*
+         * full-table scan: every stored pair is visited exactly once, directory aliases and
+         * buckets redirecting to ancestors are skipped. Splits wait while a scan is running,
+         * so a pair can neither be missed nor reported twice
+         */
+        void ForEach(const std::function<void(const KVPairPtr &)> &func) noexcept;
+        // split the scan into thread_num contiguous segment ranges, func receives worker id
+        void ForEach(int thread_num, const std::function<void(int, const KVPairPtr &)> &func) noexcept;
+        // scan directory entries [begin, end), end is clamped to the current directory size
+        void ForEachInRange(uint64_t begin, uint64_t end, const std::function<void(const KVPairPtr &)> &func) noexcept;
+        uint64_t DirectorySize() const noexcept;
         void Destory() noexcept;
+        // rebuild volatile state after the pool holding this table is opened again
+        void Recover(PoolBase &pop, int thread_num, const std::string &log_file = LOG_FILE) noexcept;
         void Debug() const noexcept;
         void DebugToLog() const;
         void Log(std::string msg) const;
@@ -59,10 +143,14 @@ namespace Dalea
         void Log(std::stringstream &msg_s) const;
 
         mutable SegmentPtrQueue segment_pool;
-        mutable pobj::concurrent_hash_map<std::string, HashPair> stash;
 
     private:
+        // bench/micro.cpp times private steps such as make_buddy_segment in isolation
+        friend class MicroBench;
+
         uint8_t depth;
+        // set by Reserve, Shrink merges no bucket down to it
+        uint8_t reserved_depth;
         bool doubling;
         Directory dir;
 
@@ -71,17 +159,71 @@ namespace Dalea
 
         std::atomic_bool to_double;
         std::atomic_int readers;
+        // scans and splits exclude each other, each kind runs concurrently with itself
+        std::atomic_int scanners;
+        std::atomic_int splitters;
         std::shared_mutex doubling_lock;
         mutable Logger logger;
-        pobj::vector<int> stash_limits;
+        ReadCache *cache;
+        // every pair is a record in one of these slabs
+        SlabList slabs;
+        SlabAllocator *slab;
+        ChunkList value_chunks;
+        ValueLog *values;
+        OverflowSlots overflow_slots;
+        OverflowArea *overflow;
+        bool defer_splits;
+        // pairs an ancestor holds before a redirected Put flattens it, 0 if it never does
+        uint64_t flatten_threshold;
+        // segments unlinked by Shrink or a bulk publish and the epoch after which they are recycled, volatile
+        std::vector<std::pair<SegmentPtr, uint64_t>> *retired;
+        // pairs removed since the last sweep of Shrink began
+        std::atomic<uint64_t> removed;
+        // directory entry the running sweep of Shrink goes on below, 0 between sweeps
+        uint64_t shrink_cursor;
+        // set while Shrink moves pairs, splits and scans wait for it
+        std::atomic_bool shrinking;
 
 
-        void split(PoolBase &pop, Stats &stats, Bucket &bkt, const HashValue &hv, SegmentPtr &seg, uint64_t segno) noexcept;
+        // locks the bucket of hv and runs op(bucket, side, segno) on it, splits and retries as op requires
+        template <typename F>
+        FunctionStatus modify(PoolBase &pop, Stats &stats, const HashValue &hv, F &&op) noexcept;
+        void split(PoolBase &pop, Stats &stats, Bucket &bkt, const HashValue &hv, Segment *seg, uint64_t segno) noexcept;
         void simple_split(PoolBase &pop, Stats &stats, uint64_t root_segno, uint64_t buddy_segno, Bucket &bkt, uint64_t bktbits) noexcept;
         void traditional_split(PoolBase &pop, Stats &stats, Bucket &bkt, const HashValue &hv, uint64_t segno, bool helper) noexcept;
-        void complex_split(PoolBase &pop, Stats &stats, Bucket &bkt, const HashValue &hv, SegmentPtr &ptr, uint64_t segno) noexcept;
+        void complex_split(PoolBase &pop, Stats &stats, Bucket &bkt, const HashValue &hv, Segment *seg, uint64_t segno) noexcept;
+
+        bool enter_split() noexcept;
+        void leave_split() noexcept;
+        void enter_scan() noexcept;
+        void leave_scan() noexcept;
+        // false if another Shrink or a scan runs, otherwise waits for running splits
+        bool enter_shrink() noexcept;
+        void leave_shrink() noexcept;
+        void scan_segments(uint64_t begin, uint64_t end, const std::function<void(const KVPairPtr &)> &func) const noexcept;
+
+        bool merge_buckets(PoolBase &pop, Stats &stats, Segment *root, uint64_t segno, uint64_t bktbits) noexcept;
+        void free_segment(PoolBase &pop, Stats &stats, uint64_t segno) noexcept;
+        // whether the upper half of a directory of depth at holds a segment of its own
+        bool materialized(uint8_t at) const noexcept;
+        // runs build with writers and Shrink kept out like a doubling does
+        FunctionStatus exclusive(const std::function<FunctionStatus()> &build) noexcept;
+        // slot of the overflow area holding key, -1 if none does or bkt does not own hv
+        int overflow_slot(const Bucket &bkt, Bucket::BucketCache *side, uint64_t segno, const std::string &key, const HashValue &hv) const noexcept;
+        // depth 1 and not a pair stored, as constructed
+        bool pristine() const noexcept;
+        FunctionStatus bulk_build(PoolBase &pop, const std::vector<BulkPair> &pairs, int thread_num) noexcept;
+        FunctionStatus reserve_segments(PoolBase &pop, uint8_t new_depth, int thread_num) noexcept;
+        // a preallocated segment if any is left, otherwise a new one
+        SegmentPtr new_segment(PoolBase &pop, uint8_t local_depth, uint64_t segno) noexcept;
+        // back to the state of a preallocated segment, deleted if the pool is full
+        void recycle_segment(PoolBase &pop, const SegmentPtr &seg) noexcept;
+        // recycle the retired segments no operation can still be in
+        void reclaim_segments(PoolBase &pop) noexcept;
+        // link table as a directory of new_depth, null entries alias their lower buddies; segments 0 and 1 are retired
+        void publish_segments(PoolBase &pop, std::vector<SegmentPtr> &table, uint8_t new_depth) noexcept;
 
-        void flatten_bucket(PoolBase &pop, Bucket &bkt, const HashValue &hv, uint64_t segno) noexcept;
+        void flatten_bucket(PoolBase &pop, Stats &stats, Bucket &bkt, const HashValue &hv, uint64_t segno) noexcept;
         SegmentPtr make_buddy_segment(PoolBase &pop, const SegmentPtr &root, uint64_t segno, uint64_t buddy_segno, const Bucket &bkt) noexcept;
     };
 } // namespace Dalea
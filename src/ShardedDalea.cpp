@@ -0,0 +1,158 @@
+#include "ShardedDalea.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <numa.h>
+#include <thread>
+namespace Dalea
+{
+    ShardedHashTable::ShardedHashTable(const std::vector<std::string> &pool_files, int shard_num, int thread_num, size_t pool_size, uint64_t reserve)
+        : node_num(pool_files.size())
+    {
+        pools.reserve(shard_num);
+        shards.reserve(shard_num);
+        // the shards together take what a single table would
+        auto shard_size = std::max<size_t>(pool_size / shard_num, PMEMOBJ_MIN_POOL);
+        auto shard_segments = std::max(HashTable::POOL_SEGMENTS / shard_num, 1);
+        for (int i = 0; i < shard_num; i++)
+        {
+            auto node = NodeOf(i);
+            // first touch of the volatile parts happens on the shard's own node
+            BindToNode(node);
+            auto file = pool_files[node] + "." + std::to_string(i);
+#ifdef DRAM_BACKEND
+            // no pool files, the root is an ordinary object and the pool handle stays empty
+            pools.emplace_back();
+            auto r = Backend::Make<ShardRoot>();
+#else
+            remove(file.c_str());
+            pools.push_back(pobj::pool<ShardRoot>::create(file, "Dalea", shard_size, S_IWUSR | S_IRUSR));
+            auto r = pools.back().root();
+#endif
+            Backend::Run(pools.back(), [&]() {
+                r->map = Backend::Make<HashTable>(pools.back(), thread_num, (reserve + shard_num - 1) / shard_num, shard_segments, file + ".log");
+            });
+            shards.push_back(r->map.get());
+        }
+        BindToNode(-1);
+    }
+
+    ShardedHashTable::~ShardedHashTable()
+    {
+        for (auto &pop : pools)
+        {
+            if (Backend::PERSISTENT)
+            {
+                pop.close();
+            }
+        }
+    }
+
+    FunctionStatus ShardedHashTable::Put(Stats &stats, int thread_id, const std::string &key, const std::string &value) noexcept
+    {
+        auto shard = ShardOf(key);
+        return shards[shard]->Put(pools[shard], stats, thread_id, key, value);
+    }
+
+    KVPairPtr ShardedHashTable::Get(const std::string &key) const noexcept
+    {
+        return shards[ShardOf(key)]->Get(key);
+    }
+
+    FunctionStatus ShardedHashTable::Remove(const std::string &key) noexcept
+    {
+        auto shard = ShardOf(key);
+        return shards[shard]->Remove(pools[shard], key);
+    }
+
+    FunctionStatus ShardedHashTable::FetchAdd(Stats &stats, const std::string &key, int64_t delta, int64_t &previous) noexcept
+    {
+        auto shard = ShardOf(key);
+        return shards[shard]->FetchAdd(pools[shard], stats, key, delta, previous);
+    }
+
+    FunctionStatus ShardedHashTable::CompareExchange(Stats &stats, const std::string &key, int64_t &expected, int64_t desired) noexcept
+    {
+        auto shard = ShardOf(key);
+        return shards[shard]->CompareExchange(pools[shard], stats, key, expected, desired);
+    }
+
+    FunctionStatus ShardedHashTable::BulkLoad(const std::vector<BulkPair> &pairs, int thread_num) noexcept
+    {
+        std::vector<std::vector<BulkPair>> parts(shards.size());
+        for (const auto &kv : pairs)
+        {
+            parts[ShardOf(kv.first)].push_back(kv);
+        }
+
+        std::atomic_bool ok = true;
+        std::vector<std::thread> loaders;
+        for (size_t i = 0; i < shards.size(); i++)
+        {
+            loaders.emplace_back([&, i]() {
+                BindToNode(NodeOf(i));
+                auto per_shard = std::max<int>(1, thread_num / shards.size());
+                if (shards[i]->BulkLoad(pools[i], parts[i], per_shard) != FunctionStatus::Ok)
+                {
+                    ok = false;
+                }
+            });
+        }
+        for (auto &t : loaders)
+        {
+            t.join();
+        }
+        return ok ? FunctionStatus::Ok : FunctionStatus::Failed;
+    }
+
+    int ShardedHashTable::ShardOf(std::string_view key) const noexcept
+    {
+        // same value as std::hash<std::string> on equal characters
+        auto hv = std::hash<std::string_view>{}(key);
+        return (hv >> (64 - META_BITS)) % shards.size();
+    }
+
+    int ShardedHashTable::ShardNum() const noexcept
+    {
+        return shards.size();
+    }
+
+    int ShardedHashTable::NodeNum() const noexcept
+    {
+        return node_num;
+    }
+
+    int ShardedHashTable::NodeOf(int shard) const noexcept
+    {
+        return shard % node_num;
+    }
+
+    HashTable &ShardedHashTable::Shard(int shard) noexcept
+    {
+        return *shards[shard];
+    }
+
+    PoolBase &ShardedHashTable::Pool(int shard) noexcept
+    {
+        return pools[shard];
+    }
+
+    // node -1 lifts the binding
+    void ShardedHashTable::BindToNode(int node) noexcept
+    {
+        if (numa_available() < 0 || node > numa_max_node())
+        {
+            return;
+        }
+        numa_run_on_node(node);
+        if (node < 0)
+        {
+            numa_set_localalloc();
+        }
+        else
+        {
+            numa_set_preferred(node);
+        }
+    }
+} // namespace Dalea
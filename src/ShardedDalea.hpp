@@ -0,0 +1,61 @@
+#ifndef __DALEA__SHARDED__
+#define __DALEA__SHARDED__
+#include "Dalea.hpp"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+namespace Dalea
+{
+    struct ShardRoot
+    {
+        Backend::Ptr<HashTable> map;
+    };
+
+    /*
+     * N independent HashTables, each in its own pool, routed by the META_BITS highest hash
+     * bits which no HashTable uses (segment bits are the lowest ones, bucket bits sit right
+     * below them), so every shard still sees uniformly distributed hash values
+     *
+     * pool_files holds one path per NUMA node, e.g. one per pmem namespace. Shard i lives
+     * on node i % pool_files.size() in file "<pool_files[node]>.<i>", its volatile parts
+     * (shadow directory, bucket locks) are allocated by a thread running on that node.
+     * It logs to "<pool_files[node]>.<i>.log" and gets an even share of pool_size and of
+     * the preallocated segments of a single table
+     */
+    class ShardedHashTable
+    {
+    public:
+        // reserve pairs in total are spread evenly over the shards, see HashTable::Reserve
+        ShardedHashTable(const std::vector<std::string> &pool_files, int shard_num, int thread_num, size_t pool_size, uint64_t reserve = 0);
+        ShardedHashTable() = delete;
+        ShardedHashTable(const ShardedHashTable &) = delete;
+        ShardedHashTable(ShardedHashTable &&) = delete;
+        ~ShardedHashTable();
+
+        FunctionStatus Put(Stats &stats, int thread_id, const std::string &key, const std::string &value) noexcept;
+        KVPairPtr Get(const std::string &key) const noexcept;
+        FunctionStatus Remove(const std::string &key) noexcept;
+        FunctionStatus FetchAdd(Stats &stats, const std::string &key, int64_t delta, int64_t &previous) noexcept;
+        FunctionStatus CompareExchange(Stats &stats, const std::string &key, int64_t &expected, int64_t desired) noexcept;
+        // partition by shard and bulk load every shard on its own node, thread_num split among shards
+        FunctionStatus BulkLoad(const std::vector<BulkPair> &pairs, int thread_num) noexcept;
+
+        int ShardOf(std::string_view key) const noexcept;
+        int ShardNum() const noexcept;
+        int NodeNum() const noexcept;
+        int NodeOf(int shard) const noexcept;
+        HashTable &Shard(int shard) noexcept;
+        PoolBase &Pool(int shard) noexcept;
+
+        // run the calling thread on node and prefer its memory, no-op without NUMA support
+        static void BindToNode(int node) noexcept;
+
+    private:
+        int node_num;
+        std::vector<pobj::pool<ShardRoot>> pools;
+        std::vector<HashTable *> shards;
+    };
+} // namespace Dalea
+#endif
@@ -0,0 +1,227 @@
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+namespace Dalea
+{
+    static const std::string_view OP_NAMES[4] = {"INSERT", "READ", "UPDATE", "DELETE"};
+    static const Ops OP_TYPES[4] = {Ops::Insert, Ops::Read, Ops::Update, Ops::Delete};
+
+    Trace::~Trace()
+    {
+        if (mapping)
+        {
+            munmap(mapping, length);
+        }
+    }
+
+    bool Trace::Load(const std::string &file, int threads) noexcept
+    {
+        if (!map_file(file))
+        {
+            return false;
+        }
+        if (length >= sizeof(TRACE_MAGIC) && memcmp(mapping, TRACE_MAGIC, sizeof(TRACE_MAGIC)) == 0)
+        {
+            return parse_binary();
+        }
+        return parse_text(threads);
+    }
+
+    void Trace::Generate(WorkloadGenerator &gen, uint64_t operations) noexcept
+    {
+        items.reserve(items.size() + operations);
+        for (uint64_t i = 0; i < operations; i++)
+        {
+            // deque never moves its elements, so views stay valid
+            owned.emplace_back();
+            auto type = gen.Next(owned.back());
+            items.emplace_back(type, owned.back());
+        }
+    }
+
+    const std::vector<WorkloadItem> &Trace::Items() const noexcept
+    {
+        return items;
+    }
+
+    bool Trace::Convert(const std::string &text_file, const std::string &trace_file, int threads) noexcept
+    {
+        Trace text;
+        if (!text.map_file(text_file) || !text.parse_text(threads))
+        {
+            return false;
+        }
+
+        for (const auto &item : text.items)
+        {
+            if (item.key.length() > UINT16_MAX)
+            {
+                std::cout << "key too long for a trace: " << item.key << "\n";
+                return false;
+            }
+        }
+
+        std::ofstream out(trace_file, std::ios::binary | std::ios::trunc);
+        uint64_t count = text.items.size();
+        out.write(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+        out.write(reinterpret_cast<const char *>(&count), sizeof(count));
+        for (const auto &item : text.items)
+        {
+            auto op = static_cast<uint8_t>(item.type);
+            auto len = static_cast<uint16_t>(item.key.length());
+            out.write(reinterpret_cast<const char *>(&op), sizeof(op));
+            out.write(reinterpret_cast<const char *>(&len), sizeof(len));
+            out.write(item.key.data(), len);
+        }
+        return out.good();
+    }
+
+    bool Trace::map_file(const std::string &file) noexcept
+    {
+        auto fd = open(file.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            std::cout << "can not open " << file << "\n";
+            return false;
+        }
+        struct stat st;
+        fstat(fd, &st);
+        length = st.st_size;
+        if (length == 0)
+        {
+            close(fd);
+            return true;
+        }
+        auto addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        close(fd);
+        if (addr == MAP_FAILED)
+        {
+            std::cout << "can not map " << file << "\n";
+            length = 0;
+            return false;
+        }
+        mapping = static_cast<char *>(addr);
+        madvise(mapping, length, MADV_SEQUENTIAL);
+        return true;
+    }
+
+    bool Trace::parse_binary() noexcept
+    {
+        auto cursor = mapping + sizeof(TRACE_MAGIC);
+        auto end = mapping + length;
+        uint64_t count;
+        if (end - cursor < (long)sizeof(count))
+        {
+            std::cout << "truncated trace header\n";
+            return false;
+        }
+        memcpy(&count, cursor, sizeof(count));
+        cursor += sizeof(count);
+
+        items.reserve(count);
+        for (uint64_t i = 0; i < count; i++)
+        {
+            uint8_t op;
+            uint16_t len;
+            if (end - cursor < (long)(sizeof(op) + sizeof(len)))
+            {
+                std::cout << "truncated trace at operation " << i << "\n";
+                return false;
+            }
+            memcpy(&op, cursor, sizeof(op));
+            memcpy(&len, cursor + sizeof(op), sizeof(len));
+            cursor += sizeof(op) + sizeof(len);
+            if (op > static_cast<uint8_t>(Ops::Delete) || end - cursor < len)
+            {
+                std::cout << "corrupted trace at operation " << i << "\n";
+                return false;
+            }
+            items.emplace_back(static_cast<Ops>(op), std::string_view(cursor, len));
+            cursor += len;
+        }
+        return true;
+    }
+
+    /*
+     * chunks are cut at line boundaries and parsed independently, then concatenated in
+     * order, so the result is the same for any number of threads
+     */
+    bool Trace::parse_text(int threads) noexcept
+    {
+        if (length == 0)
+        {
+            return true;
+        }
+        threads = std::max(threads, 1);
+        std::vector<size_t> bounds(threads + 1, length);
+        bounds[0] = 0;
+        for (int i = 1; i < threads; i++)
+        {
+            auto pos = std::max(bounds[i - 1], length / threads * i);
+            auto nl = static_cast<const char *>(memchr(mapping + pos, '\n', length - pos));
+            bounds[i] = nl ? nl - mapping + 1 : length;
+        }
+
+        std::vector<std::vector<WorkloadItem>> parts(threads);
+        std::atomic_bool ok = true;
+        auto parse = [&](int id) {
+            auto cursor = mapping + bounds[id];
+            auto end = mapping + bounds[id + 1];
+            while (cursor < end && ok)
+            {
+                auto nl = static_cast<const char *>(memchr(cursor, '\n', end - cursor));
+                std::string_view line(cursor, (nl ? nl : end) - cursor);
+                cursor += line.length() + 1;
+                if (line.empty())
+                {
+                    continue;
+                }
+                int op = 0;
+                while (op < 4 && line.compare(0, OP_NAMES[op].length(), OP_NAMES[op]) != 0)
+                {
+                    ++op;
+                }
+                if (op == 4)
+                {
+                    std::cout << "unknown operation: " << line << "\n";
+                    ok = false;
+                    return;
+                }
+                // same key as getline based parsing: everything behind the operation name
+                parts[id].emplace_back(OP_TYPES[op], line.substr(OP_NAMES[op].length()));
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (int i = 1; i < threads; i++)
+        {
+            workers.emplace_back(parse, i);
+        }
+        parse(0);
+        for (auto &t : workers)
+        {
+            t.join();
+        }
+
+        size_t total = items.size();
+        for (const auto &p : parts)
+        {
+            total += p.size();
+        }
+        items.reserve(total);
+        for (const auto &p : parts)
+        {
+            items.insert(items.end(), p.begin(), p.end());
+        }
+        return ok;
+    }
+} // namespace Dalea
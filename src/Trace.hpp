@@ -0,0 +1,49 @@
+#ifndef __DALEA__TRACE__
+#define __DALEA__TRACE__
+#include "Workload.hpp"
+
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+namespace Dalea
+{
+    /*
+     * binary trace layout, all integers little endian
+     *   header: TRACE_MAGIC (8 bytes), number of operations (8 bytes)
+     *   operation: op code (1 byte, Ops), key length (2 bytes), key bytes
+     */
+    constexpr char TRACE_MAGIC[8] = {'D', 'A', 'L', 'E', 'A', 'T', 'R', '1'};
+
+    /*
+     * a workload held in one place, its items only view keys stored here: in the mapping of
+     * a binary or text trace file, or in keys taken over from a generator
+     */
+    class Trace
+    {
+    public:
+        Trace() : mapping(nullptr), length(0){};
+        Trace(const Trace &) = delete;
+        Trace(Trace &&) = delete;
+        ~Trace();
+
+        // binary traces are recognized by their magic, text ones are parsed by threads in parallel
+        // a Trace loads one file at most
+        bool Load(const std::string &file, int threads) noexcept;
+        void Generate(WorkloadGenerator &gen, uint64_t operations) noexcept;
+        const std::vector<WorkloadItem> &Items() const noexcept;
+
+        static bool Convert(const std::string &text_file, const std::string &trace_file, int threads) noexcept;
+
+    private:
+        char *mapping;
+        size_t length;
+        std::vector<WorkloadItem> items;
+        std::deque<std::string> owned;
+
+        bool map_file(const std::string &file) noexcept;
+        bool parse_binary() noexcept;
+        bool parse_text(int threads) noexcept;
+    };
+} // namespace Dalea
+#endif
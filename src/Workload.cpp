@@ -0,0 +1,208 @@
+#include "Workload.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+namespace Dalea
+{
+    // YCSB defaults
+    constexpr double ZIPFIAN_CONSTANT = 0.99;
+    constexpr double HOTSPOT_DATA_FRACTION = 0.2;
+    constexpr double HOTSPOT_OPN_FRACTION = 0.8;
+    // scrambled zipfian draws from this many items and folds them into the key space,
+    // zeta is then a constant instead of a sum over all records
+    constexpr uint64_t SCRAMBLED_ITEMS = 10000000000UL;
+    constexpr double SCRAMBLED_ZETAN = 26.46902820178302;
+
+    static uint64_t fnv_hash(uint64_t val)
+    {
+        uint64_t hash = 0xCBF29CE484222325UL;
+        for (int i = 0; i < 8; i++)
+        {
+            hash ^= val & 0xff;
+            hash *= 1099511628211UL;
+            val >>= 8;
+        }
+        return hash;
+    }
+
+    bool WorkloadSpec::ParseMix(const std::string &str) noexcept
+    {
+        std::stringstream buf(str);
+        std::string part;
+        int parsed[4];
+        int i = 0;
+        int sum = 0;
+        while (getline(buf, part, ':'))
+        {
+            if (i == 4 || part.empty() || part.find_first_not_of("0123456789") != std::string::npos)
+            {
+                return false;
+            }
+            parsed[i] = std::stoi(part);
+            sum += parsed[i++];
+        }
+        if (i != 4 || sum != 100)
+        {
+            return false;
+        }
+        std::copy(parsed, parsed + 4, mix);
+        return true;
+    }
+
+    bool WorkloadSpec::ParseDistribution(const std::string &str) noexcept
+    {
+        if (str == "uniform")
+        {
+            distribution = Distribution::Uniform;
+        }
+        else if (str == "zipfian")
+        {
+            distribution = Distribution::Zipfian;
+        }
+        else if (str == "latest")
+        {
+            distribution = Distribution::Latest;
+        }
+        else if (str == "hotspot")
+        {
+            distribution = Distribution::Hotspot;
+        }
+        else
+        {
+            return false;
+        }
+        return true;
+    }
+
+    WorkloadGenerator::WorkloadGenerator(const WorkloadSpec &s)
+        : spec(s), rng(s.seed), uniform(0.0, 1.0), inserted(s.records),
+          zipf_items(0), zeta_n(0)
+    {
+        zeta_2 = 1 + std::pow(0.5, ZIPFIAN_CONSTANT);
+        alpha = 1.0 / (1.0 - ZIPFIAN_CONSTANT);
+        eta = 0;
+        if (spec.distribution == Distribution::Zipfian)
+        {
+            zipf_items = SCRAMBLED_ITEMS;
+            zeta_n = SCRAMBLED_ZETAN;
+            eta = (1 - std::pow(2.0 / zipf_items, 1 - ZIPFIAN_CONSTANT)) / (1 - zeta_2 / zeta_n);
+        }
+        else if (spec.distribution == Distribution::Latest)
+        {
+            zeta_grow(inserted);
+        }
+    }
+
+    Ops WorkloadGenerator::Next(std::string &key) noexcept
+    {
+        static const Ops types[4] = {Ops::Read, Ops::Insert, Ops::Update, Ops::Delete};
+        auto dice = uniform(rng) * 100;
+        int i = 0;
+        double bound = spec.mix[0];
+        while (i < 3 && dice >= bound)
+        {
+            bound += spec.mix[++i];
+        }
+        key = Key(types[i] == Ops::Insert ? inserted++ : next_record());
+        return types[i];
+    }
+
+    std::string WorkloadGenerator::Key(uint64_t id) const noexcept
+    {
+        auto key = "user" + std::to_string(fnv_hash(id));
+        if (key.size() < size_t(spec.key_size))
+        {
+            key.resize(spec.key_size, 'x');
+        }
+        return key;
+    }
+
+    void WorkloadGenerator::Value(uint64_t n, std::string &value) const noexcept
+    {
+        // the low digits of n in front of the padding, all of them unless the value is shorter
+        auto digits = std::to_string(n);
+        auto len = std::min(digits.size(), size_t(spec.value_size));
+        value.assign(spec.value_size, 'v');
+        value.replace(0, len, digits, digits.size() - len, len);
+    }
+
+    uint64_t WorkloadGenerator::Records() const noexcept
+    {
+        return inserted;
+    }
+
+    const WorkloadSpec &WorkloadGenerator::Spec() const noexcept
+    {
+        return spec;
+    }
+
+    uint64_t WorkloadGenerator::next_record() noexcept
+    {
+        if (inserted == 0)
+        {
+            return 0;
+        }
+        switch (spec.distribution)
+        {
+        case Distribution::Uniform:
+            return rng() % inserted;
+        case Distribution::Zipfian:
+        {
+            // fold into the final key space so that hot records stay hot while inserting; a
+            // record not inserted yet maps to one that is, so a draw never has to be repeated
+            auto key_space = spec.records + spec.operations * spec.mix[1] / 100 + 1;
+            auto id = fnv_hash(zipfian(SCRAMBLED_ITEMS)) % key_space;
+            return id < inserted ? id : id % inserted;
+        }
+        case Distribution::Latest:
+            // the most recent records are the hottest
+            if (zipf_items != inserted)
+            {
+                zeta_grow(inserted);
+            }
+            return inserted - 1 - zipfian(inserted);
+        case Distribution::Hotspot:
+        {
+            uint64_t hot = std::max<uint64_t>(1, inserted * HOTSPOT_DATA_FRACTION);
+            if (uniform(rng) < HOTSPOT_OPN_FRACTION || hot == inserted)
+            {
+                return rng() % hot;
+            }
+            return hot + rng() % (inserted - hot);
+        }
+        default:
+            return 0;
+        }
+    }
+
+    uint64_t WorkloadGenerator::zipfian(uint64_t items) noexcept
+    {
+        auto u = uniform(rng);
+        auto uz = u * zeta_n;
+        if (uz < 1.0)
+        {
+            return 0;
+        }
+        if (uz < zeta_2)
+        {
+            return 1;
+        }
+        auto ret = uint64_t(items * std::pow(eta * u - eta + 1, alpha));
+        return std::min(ret, items - 1);
+    }
+
+    // zeta(n) = sum of 1 / i^theta over [1, n], only the new terms are added
+    void WorkloadGenerator::zeta_grow(uint64_t items) noexcept
+    {
+        for (auto i = zipf_items; i < items; i++)
+        {
+            zeta_n += 1 / std::pow(i + 1, ZIPFIAN_CONSTANT);
+        }
+        zipf_items = items;
+        if (zipf_items > 2)
+        {
+            eta = (1 - std::pow(2.0 / zipf_items, 1 - ZIPFIAN_CONSTANT)) / (1 - zeta_2 / zeta_n);
+        }
+    }
+} // namespace Dalea
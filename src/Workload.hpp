@@ -0,0 +1,90 @@
+#ifndef __DALEA__WORKLOAD__
+#define __DALEA__WORKLOAD__
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+namespace Dalea
+{
+    enum class Ops
+    {
+        Insert,
+        Read,
+        Update,
+        Delete,
+    };
+
+    // the key is owned by whoever loaded the workload, see Trace
+    struct WorkloadItem
+    {
+        Ops type;
+        std::string_view key;
+
+        WorkloadItem(const Ops &t, std::string_view k) : type(t), key(k){};
+    };
+
+    enum class Distribution
+    {
+        Uniform,
+        Zipfian,
+        Latest,
+        Hotspot,
+    };
+
+    struct WorkloadSpec
+    {
+        uint64_t records = 0;
+        uint64_t operations = 0;
+        // percentages of read, insert, update and delete, summing up to 100
+        int mix[4] = {50, 0, 50, 0};
+        int key_size = 16;
+        int value_size = 16;
+        Distribution distribution = Distribution::Zipfian;
+        uint64_t seed = 0;
+
+        // "read:insert:update:delete", e.g. "95:5:0:0"
+        bool ParseMix(const std::string &str) noexcept;
+        bool ParseDistribution(const std::string &str) noexcept;
+    };
+
+    /*
+     * a YCSB-like operation stream, fully determined by the spec and its seed
+     * records [0, records) are the warmup keys, inserts of the run phase append new records
+     * and the chosen distribution picks among the records inserted so far
+     */
+    class WorkloadGenerator
+    {
+    public:
+        WorkloadGenerator(const WorkloadSpec &spec);
+        WorkloadGenerator() = delete;
+        WorkloadGenerator(const WorkloadGenerator &) = delete;
+        WorkloadGenerator(WorkloadGenerator &&) = delete;
+
+        // type of the next operation, its key is stored into key
+        Ops Next(std::string &key) noexcept;
+        // key of record id, scrambled so that consecutive ids spread over the key space
+        std::string Key(uint64_t id) const noexcept;
+        // value of size value_size for the n-th operation, different for every n so that updates change the pair
+        void Value(uint64_t n, std::string &value) const noexcept;
+        uint64_t Records() const noexcept;
+        const WorkloadSpec &Spec() const noexcept;
+
+    private:
+        WorkloadSpec spec;
+        std::mt19937_64 rng;
+        std::uniform_real_distribution<double> uniform;
+        uint64_t inserted;
+
+        // zipfian state, see Gray et al., Quickly Generating Billion-Record Synthetic Databases
+        uint64_t zipf_items;
+        double zeta_n;
+        double zeta_2;
+        double alpha;
+        double eta;
+
+        uint64_t next_record() noexcept;
+        uint64_t zipfian(uint64_t items) noexcept;
+        void zeta_grow(uint64_t items) noexcept;
+    };
+} // namespace Dalea
+#endif
@@ -6,5 +6,33 @@ code.build do
   value "run_file, r"
   value "threads, t"
   value "batch, b"
+  value "shards, s"
+  value "records, n"
+  value "operations, o"
+  value "mix, m"
+  value "key_size, k"
+  value "value_size, v"
+  value "distribution, d"
+  value "seed, e"
+  value "convert, c"
+  value "bulk, l"
+  value "timeline, g"
+  value "interval, i"
+  value "cpus, a"
+  value "placement, x"
+  value "node, u"
+  value "background, y"
+  value "rate, q"
+  value "arrival, j"
+  value "emulate, f"
+  value "decode_log, z"
+  value "trace, T"
+  value "cache, C"
+  value "value_log, V"
+  value "reserve, R"
+  value "split_workers, S"
+  value "flatten, F"
+  value "shrink, M"
+  value "reopen, O"
 end
 code.generate!
\ No newline at end of file
@@ -0,0 +1,262 @@
+#ifndef __DALEA__BACKEND__BACKEND__
+#define __DALEA__BACKEND__BACKEND__
+#include "Metrics/Metrics.hpp"
+
+#include <libpmemobj++/container/array.hpp>
+#include <libpmemobj++/container/string.hpp>
+#include <libpmemobj++/container/vector.hpp>
+#include <libpmemobj++/make_persistent.hpp>
+#include <libpmemobj++/make_persistent_array.hpp>
+#include <libpmemobj++/p.hpp>
+#include <libpmemobj++/persistent_ptr.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/shared_mutex.hpp>
+#include <libpmemobj++/transaction.hpp>
+
+#include <array>
+#include <cstddef>
+#include <shared_mutex>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+namespace Dalea
+{
+    using PoolBase = pmem::obj::pool_base;
+    using TX = pmem::obj::transaction;
+    namespace pobj = pmem::obj;
+
+    /*
+     * persistence policies: the index allocates, links, snapshots and flushes only through
+     * Backend, so splits and doublings run unchanged on either of them
+     *   PMBackend:   everything lives in a libpmemobj pool, changes are made in transactions
+     *   DRAMBackend: plain heap memory, no flushes and no transactions, for a volatile index
+     *                or a DRAM baseline; pools passed along are never opened
+     * Make and Delete are called within Run
+     */
+    struct PMBackend
+    {
+        template <typename T>
+        using Ptr = pobj::persistent_ptr<T>;
+        template <typename T, std::size_t N>
+        using Array = pobj::array<T, N>;
+        template <typename T>
+        using Field = pobj::p<T>;
+        template <typename T>
+        using Vector = pobj::vector<T>;
+        using Str = pobj::string;
+        using SharedMutex = pobj::shared_mutex;
+
+        static constexpr bool PERSISTENT = true;
+
+        template <typename F>
+        static void Run(PoolBase &pop, F &&func)
+        {
+            TX::run(pop, std::forward<F>(func));
+        }
+
+        // T[] takes the number of elements
+        template <typename T, typename... Args>
+        static Ptr<T> Make(Args &&... args)
+        {
+            Metrics::Add(Metric::Allocations);
+            return pobj::make_persistent<T>(std::forward<Args>(args)...);
+        }
+
+        template <typename T>
+        static void Delete(const Ptr<T> &ptr)
+        {
+            pobj::delete_persistent<T>(ptr);
+        }
+
+        // a T placed offset bytes into an allocation of chars, not deleted on its own
+        template <typename T>
+        static Ptr<T> At(const Ptr<char[]> &base, std::size_t offset) noexcept
+        {
+            auto oid = base.raw();
+            oid.off += offset;
+            return Ptr<T>(oid);
+        }
+
+        // adds a range to the running transaction
+        static void Snapshot(const void *addr, std::size_t len)
+        {
+            pmemobj_tx_add_range_direct(addr, len);
+        }
+
+        static void Persist(PoolBase &pop, const void *addr, std::size_t len) noexcept
+        {
+            pmemobj_persist(pop.handle(), addr, len);
+        }
+    };
+
+    // raw pointer with the part of persistent_ptr's interface the index uses
+    template <typename T>
+    class VolatilePtr
+    {
+    public:
+        using element_type = std::remove_extent_t<T>;
+
+        VolatilePtr() noexcept : ptr(nullptr){};
+        VolatilePtr(std::nullptr_t) noexcept : ptr(nullptr){};
+        explicit VolatilePtr(element_type *p) noexcept : ptr(p){};
+
+        element_type *get() const noexcept
+        {
+            return ptr;
+        }
+
+        element_type *operator->() const noexcept
+        {
+            return ptr;
+        }
+
+        element_type &operator*() const noexcept
+        {
+            return *ptr;
+        }
+
+        element_type &operator[](std::ptrdiff_t i) const noexcept
+        {
+            return ptr[i];
+        }
+
+        explicit operator bool() const noexcept
+        {
+            return ptr != nullptr;
+        }
+
+        bool operator==(const VolatilePtr &rhs) const noexcept
+        {
+            return ptr == rhs.ptr;
+        }
+
+        bool operator!=(const VolatilePtr &rhs) const noexcept
+        {
+            return ptr != rhs.ptr;
+        }
+
+        bool operator==(std::nullptr_t) const noexcept
+        {
+            return ptr == nullptr;
+        }
+
+        bool operator!=(std::nullptr_t) const noexcept
+        {
+            return ptr != nullptr;
+        }
+
+    private:
+        element_type *ptr;
+    };
+
+    template <typename T, std::size_t N>
+    struct VolatileArray : std::array<T, N>
+    {
+        const T *cdata() const noexcept
+        {
+            return this->data();
+        }
+    };
+
+    template <typename T>
+    struct VolatileField
+    {
+        VolatileField() = default;
+        VolatileField(const T &v) : value(v){};
+
+        VolatileField &operator=(const T &v) noexcept
+        {
+            value = v;
+            return *this;
+        }
+
+        operator T() const noexcept
+        {
+            return value;
+        }
+
+        const T &get_ro() const noexcept
+        {
+            return value;
+        }
+
+        T &get_rw() noexcept
+        {
+            return value;
+        }
+
+        T value;
+    };
+
+    struct DRAMBackend
+    {
+        template <typename T>
+        using Ptr = VolatilePtr<T>;
+        template <typename T, std::size_t N>
+        using Array = VolatileArray<T, N>;
+        template <typename T>
+        using Field = VolatileField<T>;
+        template <typename T>
+        using Vector = std::vector<T>;
+        using Str = std::string;
+        using SharedMutex = std::shared_mutex;
+
+        static constexpr bool PERSISTENT = false;
+
+        template <typename F>
+        static void Run(PoolBase &, F &&func)
+        {
+            func();
+        }
+
+        template <typename T, typename... Args>
+        static Ptr<T> Make(Args &&... args)
+        {
+            Metrics::Add(Metric::Allocations);
+            if constexpr (std::is_array_v<T>)
+            {
+                std::size_t n = (static_cast<std::size_t>(args) + ...);
+                return Ptr<T>(new std::remove_extent_t<T>[n]());
+            }
+            else
+            {
+                return Ptr<T>(new T(std::forward<Args>(args)...));
+            }
+        }
+
+        template <typename T>
+        static void Delete(const Ptr<T> &ptr)
+        {
+            if constexpr (std::is_array_v<T>)
+            {
+                delete[] ptr.get();
+            }
+            else
+            {
+                delete ptr.get();
+            }
+        }
+
+        template <typename T>
+        static Ptr<T> At(const Ptr<char[]> &base, std::size_t offset) noexcept
+        {
+            return Ptr<T>(reinterpret_cast<T *>(base.get() + offset));
+        }
+
+        static void Snapshot(const void *, std::size_t) noexcept
+        {
+        }
+
+        static void Persist(PoolBase &, const void *, std::size_t) noexcept
+        {
+        }
+    };
+
+#ifdef DRAM_BACKEND
+    using Backend = DRAMBackend;
+#else
+    using Backend = PMBackend;
+#endif
+} // namespace Dalea
+#endif
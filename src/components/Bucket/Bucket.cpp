@@ -1,4 +1,5 @@
 #include "Bucket.hpp"
+#include "Tracer/Tracer.hpp"
 namespace Dalea
 {
     Bucket::Bucket()
@@ -11,30 +12,39 @@ namespace Dalea
             fingerprints[i] = hv;
             pairs[i] = nullptr;
         }
+#ifdef HYBRID
+        // Segment attaches the DRAM copy and the lock
+        cache = nullptr;
+#ifndef PLOCK
+        mux = nullptr;
+#endif
+#else
 #ifndef PLOCK
         mux = new std::shared_mutex;
+#endif
 #endif
     }
 
-    FunctionStatus Bucket::Get(const String &key, const HashValue &hash_value, KVPairPtr &ret, uint64_t segno) const noexcept
+    FunctionStatus Bucket::Get(const String &key, const HashValue &hash_value, KVPairPtr &ret, uint64_t segno, BucketCache *side) const noexcept
     {
 #ifdef PLOCK
         std::shared_lock s(mux);
 #else
-        std::shared_lock s(*mux);
+        std::shared_lock s(mutex(side));
 #endif
         // auto encoding = hash_value.GetRaw() & (((1UL << GetDepth()) - 1));
-        auto mask = ((1UL << GetDepth()) - 1);
+        auto mask = ((1UL << GetDepth(side)) - 1);
         auto encoding = hash_value.GetRaw() & mask; // (((1UL << GetDepth()) - 1));
         auto tag = segno & mask;
         /* 
          * access to a splitting bucket and then obtained a lock, however the split has finished
-         * tag may have changed
+         * tag may have changed, or the bucket has been merged into its buddy meanwhile
          */
-        if (tag != encoding)
+        if (tag != encoding || HasAncestor(side))
         {
             return FunctionStatus::Retry;
         }
+        emulate_scan();
 
         for (auto search = 0; search < BUCKET_SIZE; search++)
         {
@@ -45,11 +55,12 @@ namespace Dalea
             //     fingerprints[search].Invalidate();
             // }
 #ifdef USE_FP
-            if (fingerprints[search] == hash_value)
+            if (fps(side)[search] == hash_value)
             {
-                if (pairs[search]->key == key)
+                EmulateRead(pairs[search]);
+                if (pairs[search]->Key() == key)
 #else
-            if (pairs[search] && pairs[search]->key == key)
+            if (pairs[search] && pairs[search]->Key() == key)
 #endif
 
                 {
@@ -65,7 +76,7 @@ namespace Dalea
         return FunctionStatus::Failed;
     }
 
-    FunctionStatus Bucket::Put(PoolBase &pop, const String &key, const String &value, const HashValue &hash_value, uint64_t segno) noexcept
+    FunctionStatus Bucket::Put(PoolBase &pop, SlabAllocator &slab, const String &key, const String &value, const HashValue &hash_value, uint64_t segno, BucketCache *side) noexcept
     {
         // if (HasAncestor())
         // {
@@ -73,40 +84,38 @@ namespace Dalea
         // }
 
         int slot = -1;
-        auto mask = ((1UL << GetDepth()) - 1);
+        auto mask = ((1UL << GetDepth(side)) - 1);
         auto encoding = hash_value.GetRaw() & mask; // (((1UL << GetDepth()) - 1));
         auto tag = segno & mask;
         /* 
          * access to a splitting bucket and then obtained a lock, however the split has finished
-         * tag may have changed
+         * tag may have changed, or the bucket has been merged into its buddy meanwhile
          */
-        if (tag != encoding)
+        if (tag != encoding || HasAncestor(side))
         {
             return FunctionStatus::Retry;
         }
+        emulate_scan();
 
         for (auto search = 0; search < BUCKET_SIZE; search++)
         {
             // the later condition is used for lazy deletion, also postpone splitting as much as possible
-            auto f = fingerprints[search].GetRaw() & (((1UL << GetDepth()) - 1));
-            if (fingerprints[search].IsInvalid() || f != encoding)
+            auto f = fps(side)[search].GetRaw() & (((1UL << GetDepth(side)) - 1));
+            if (fps(side)[search].IsInvalid() || f != encoding)
             {
                 slot = search;
             }
 #ifdef USE_FP
-            if (fingerprints[search] == hash_value)
+            if (fps(side)[search] == hash_value)
             {
-                if (pairs[search]->key == key && pairs[search]->value != value)
+                EmulateRead(pairs[search]);
+                if (pairs[search]->Key() == key && pairs[search]->Value() != value)
 #else
-            if (pairs[search] && pairs[search]->key == key && pairs[search]->value != value)
+            if (pairs[search] && pairs[search]->Key() == key && pairs[search]->Value() != value)
 #endif
                 {
-                    // std::cout << "dup key: " << key << "\n";
-                    // Not a good update strategy
-                    TX::run(pop, [&]() {
-                        // replace_content would be called
-                        pairs[search]->value = value;
-                    });
+                    replace(pop, slab, search, key, value);
+                    Metrics::Add(Metric::PutUpdates);
                     return FunctionStatus::Ok;
                 }
 #ifdef USE_FP
@@ -121,86 +130,297 @@ namespace Dalea
         {
             return FunctionStatus::SplitRequired;
         }
-        KVPairPtr pair = nullptr;
-        TX::run(pop, [&]() {
-            pair = pmem::obj::make_persistent<KVPair>(
-                key,
-                value);
-        });
-        pairs[slot] = pair;
-        fingerprints[slot] = hash_value;
-        pmemobj_persist(pop.handle(), pairs + slot, sizeof(KVPair));
-        pmemobj_persist(pop.handle(), fingerprints + slot, sizeof(uint64_t));
+        Tracer::Span span("allocate_pair", "slot", slot);
+        pairs[slot] = slab.Make(pop, key, value);
+        fps(side)[slot] = hash_value;
+        Persist(pop, pairs + slot, sizeof(KVPairPtr));
+#ifndef HYBRID
+        Persist(pop, fingerprints + slot, sizeof(uint64_t));
+#endif
+        Metrics::Add(Metric::PutInserts);
         return FunctionStatus::Ok;
     }
 
-    FunctionStatus Bucket::Put(Logger &logger, PoolBase &pop, const String &key, const String &value, const HashValue &hash_value, uint64_t segno) noexcept
+    FunctionStatus Bucket::Put(Logger &logger, PoolBase &pop, SlabAllocator &slab, const String &key, const String &value, const HashValue &hash_value, uint64_t segno, BucketCache *side) noexcept
     {
-        if (HasAncestor())
+        if (HasAncestor(side))
         {
-            std::stringstream buf;
-            buf << "Ancestor detected " << GetAncestor() << " in (" << segno << ", "
-                << hash_value.BucketBits() << ")\n";
-            logger.Write(buf.str());
-            return FunctionStatus::FlattenRequired;
+            logger.Record(LogEvent::BucketAncestor, hash_value.GetRaw(), GetAncestor(side), segno, hash_value.BucketBits());
+            return FunctionStatus::Retry;
         }
 
         int slot = -1;
-        auto mask = ((1UL << GetDepth()) - 1);
+        auto mask = ((1UL << GetDepth(side)) - 1);
         auto encoding = hash_value.GetRaw() & mask; // (((1UL << GetDepth()) - 1));
         auto tag = segno & mask;
         /* 
          * access to a splitting bucket and then obtained a lock, however the split has finished
-         * tag may have changed
+         * tag may have changed, or the bucket has been merged into its buddy meanwhile
          */
         if (tag != encoding)
         {
             return FunctionStatus::Retry;
         }
+        emulate_scan();
 
         for (auto search = 0; search < BUCKET_SIZE; search++)
         {
-            auto iter = std::to_string(search);
             // the later condition is used for lazy deletion, also postpone splitting as much as possible
-            auto f = fingerprints[search].GetRaw() & (((1UL << GetDepth()) - 1));
-            if (fingerprints[search].IsInvalid() || f != encoding)
+            auto f = fps(side)[search].GetRaw() & (((1UL << GetDepth(side)) - 1));
+            if (fps(side)[search].IsInvalid() || f != encoding)
             {
                 slot = search;
             }
-            if (fingerprints[search] == hash_value)
+#ifdef USE_FP
+            if (fps(side)[search] == hash_value)
             {
-                if (pairs[search]->key == key)
+                EmulateRead(pairs[search]);
+                if (pairs[search]->Key() == key && pairs[search]->Value() != value)
+#else
+            if (pairs[search] && pairs[search]->Key() == key && pairs[search]->Value() != value)
+#endif
                 {
-                    TX::manual tx(pop);
-                    pairs[search]->value = value;
-                    TX::commit();
+                    replace(pop, slab, search, key, value);
+                    Metrics::Add(Metric::PutUpdates);
                     return FunctionStatus::Ok;
                 }
+#ifdef USE_FP
+                else
+                {
+                    return FunctionStatus::Failed;
+                }
             }
+#endif
         }
         if (slot == -1)
         {
             return FunctionStatus::SplitRequired;
         }
-        TX::run(pop, [&]() {
-            auto pair = pmem::obj::make_persistent<KVPair>(
-                key,
-                value);
-            pairs[slot] = pair;
-            fingerprints[slot] = hash_value;
-        });
+        Tracer::Span span("allocate_pair", "slot", slot);
+        pairs[slot] = slab.Make(pop, key, value);
+        fps(side)[slot] = hash_value;
+        Persist(pop, pairs + slot, sizeof(KVPairPtr));
+#ifndef HYBRID
+        Persist(pop, fingerprints + slot, sizeof(uint64_t));
+#endif
 #ifdef LOGGING
-        std::string msg{">>>> putting finished\n"};
-        logger.Write(msg);
+        logger.Record(LogEvent::BucketPutDone, hash_value.GetRaw(), slot);
+#endif
+        Metrics::Add(Metric::PutInserts);
+        return FunctionStatus::Ok;
+    }
+
+    FunctionStatus Bucket::Remove(PoolBase &pop, SlabAllocator &slab, const String &key, const HashValue &hash_value, uint64_t segno, BucketCache *side) noexcept
+    {
+        auto mask = ((1UL << GetDepth(side)) - 1);
+        auto encoding = hash_value.GetRaw() & mask;
+        auto tag = segno & mask;
+        if (tag != encoding || HasAncestor(side))
+        {
+            return FunctionStatus::Retry;
+        }
+        emulate_scan();
+
+        for (auto search = 0; search < BUCKET_SIZE; search++)
+        {
+#ifdef USE_FP
+            if (fps(side)[search] == hash_value && (EmulateRead(pairs[search]), pairs[search]->Key() == key))
+#else
+            if (pairs[search] && pairs[search]->Key() == key)
+#endif
+            {
+                // slot is free once its fingerprint is gone, the pair is reclaimed afterwards
+                KVPairPtr victim = pairs[search];
+                fps(side)[search].Invalidate();
+#ifndef HYBRID
+                Persist(pop, fingerprints + search, sizeof(HashValue));
+#endif
+                pairs[search] = nullptr;
+                Persist(pop, pairs + search, sizeof(KVPairPtr));
+                slab.Free(pop, victim);
+                return FunctionStatus::Ok;
+            }
+        }
+        return FunctionStatus::Failed;
+    }
+
+    FunctionStatus Bucket::FetchAdd(PoolBase &pop, SlabAllocator &slab, const String &key, int64_t delta, int64_t &previous, const HashValue &hash_value, uint64_t segno, BucketCache *side) noexcept
+    {
+        auto mask = ((1UL << GetDepth(side)) - 1);
+        auto encoding = hash_value.GetRaw() & mask;
+        auto tag = segno & mask;
+        if (tag != encoding || HasAncestor(side))
+        {
+            return FunctionStatus::Retry;
+        }
+        emulate_scan();
+
+        auto slot = find(key, hash_value, side);
+        if (slot != -1)
+        {
+            if (!pairs[slot]->IsCounter())
+            {
+                return FunctionStatus::Failed;
+            }
+            // the bucket lock orders writers, no read-modify-write instruction is needed
+            previous = pairs[slot]->Counter();
+            pairs[slot]->SetCounter(previous + delta);
+            Persist(pop, pairs[slot]->data(), sizeof(int64_t));
+            Metrics::Add(Metric::CounterUpdates);
+            return FunctionStatus::Ok;
+        }
+
+        slot = vacant(encoding, side);
+        if (slot == -1)
+        {
+            return FunctionStatus::SplitRequired;
+        }
+        previous = 0;
+        pairs[slot] = slab.MakeCounter(pop, key, delta);
+        fps(side)[slot] = hash_value;
+        Persist(pop, pairs + slot, sizeof(KVPairPtr));
+#ifndef HYBRID
+        Persist(pop, fingerprints + slot, sizeof(uint64_t));
 #endif
+        Metrics::Add(Metric::PutInserts);
+        return FunctionStatus::Ok;
+    }
+
+    FunctionStatus Bucket::CompareExchange(PoolBase &pop, const String &key, int64_t &expected, int64_t desired, const HashValue &hash_value, uint64_t segno, BucketCache *side) noexcept
+    {
+        auto mask = ((1UL << GetDepth(side)) - 1);
+        auto encoding = hash_value.GetRaw() & mask;
+        auto tag = segno & mask;
+        if (tag != encoding || HasAncestor(side))
+        {
+            return FunctionStatus::Retry;
+        }
+        emulate_scan();
+
+        auto slot = find(key, hash_value, side);
+        if (slot == -1 || !pairs[slot]->IsCounter())
+        {
+            return FunctionStatus::Failed;
+        }
+        auto current = pairs[slot]->Counter();
+        if (current != expected)
+        {
+            expected = current;
+            Metrics::Add(Metric::CounterConflicts);
+            return FunctionStatus::Failed;
+        }
+        pairs[slot]->SetCounter(desired);
+        Persist(pop, pairs[slot]->data(), sizeof(int64_t));
+        Metrics::Add(Metric::CounterUpdates);
         return FunctionStatus::Ok;
     }
 
-    FunctionStatus Bucket::Remove(const String &key, const HashValue &hash_value, std::shared_mutex &mux) const noexcept
+    int Bucket::Count(uint64_t segno, BucketCache *side) const noexcept
+    {
+        auto mask = ((1UL << GetDepth(side)) - 1);
+        auto tag = segno & mask;
+        int count = 0;
+        for (int i = 0; i < BUCKET_SIZE; i++)
+        {
+#ifdef USE_FP
+            if (!fps(side)[i].IsInvalid() && (fps(side)[i].GetRaw() & mask) == tag)
+#else
+            if (pairs[i] && (std::hash<std::string_view>{}(pairs[i]->Key()) & mask) == tag)
+#endif
+            {
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    FunctionStatus Bucket::Link(PoolBase &pop, const KVPairPtr &pair, const HashValue &hash_value, uint64_t segno, BucketCache *side) noexcept
     {
+        if (!Owns(hash_value, segno, side))
+        {
+            return FunctionStatus::Retry;
+        }
+        // left linked by a crash before the overflow slot was cleared
+        for (int i = 0; i < BUCKET_SIZE; i++)
+        {
+            if (fps(side)[i] == hash_value && pairs[i] == pair)
+            {
+                return FunctionStatus::Ok;
+            }
+        }
+        auto slot = vacant(hash_value.GetRaw() & ((1UL << GetDepth(side)) - 1), side);
+        if (slot == -1)
+        {
+            return FunctionStatus::SplitRequired;
+        }
+        pairs[slot] = pair;
+        fps(side)[slot] = hash_value;
+        Persist(pop, pairs + slot, sizeof(KVPairPtr));
+#ifndef HYBRID
+        Persist(pop, fingerprints + slot, sizeof(uint64_t));
+#endif
         return FunctionStatus::Ok;
     }
 
+    bool Bucket::Owns(const HashValue &hash_value, uint64_t segno, BucketCache *side) const noexcept
+    {
+        auto mask = ((1UL << GetDepth(side)) - 1);
+        return (segno & mask) == (hash_value.GetRaw() & mask) && !HasAncestor(side);
+    }
+
+    int Bucket::Relocate(PoolBase &pop, SlabAllocator &slab, uint64_t segno, const std::function<bool(const KVPairPtr &)> &moving) noexcept
+    {
+        if (HasAncestor())
+        {
+            return 0;
+        }
+        auto mask = ((1UL << GetDepth()) - 1);
+        auto tag = segno & mask;
+        int moved = 0;
+        for (int i = 0; i < BUCKET_SIZE; i++)
+        {
+#ifdef USE_FP
+            if (!fps()[i].IsInvalid() && (fps()[i].GetRaw() & mask) == tag && moving(pairs[i]))
+#else
+            if (pairs[i] && (std::hash<std::string_view>{}(pairs[i]->Key()) & mask) == tag && moving(pairs[i]))
+#endif
+            {
+                // the views stay valid until replace frees the old pair
+                replace(pop, slab, i, pairs[i]->Key(), pairs[i]->Value());
+                ++moved;
+            }
+        }
+        return moved;
+    }
+
+    void Bucket::ForEach(uint64_t segno, const std::function<void(const KVPairPtr &)> &func) const noexcept
+    {
+#ifdef PLOCK
+        std::shared_lock s(mux);
+#else
+        std::shared_lock s(*mux);
+#endif
+        if (HasAncestor())
+        {
+            return;
+        }
+
+        // slots whose encoding differs are lazily deleted leftovers of a split
+        auto mask = ((1UL << GetDepth()) - 1);
+        auto tag = segno & mask;
+        for (int i = 0; i < BUCKET_SIZE; i++)
+        {
+#ifdef USE_FP
+            if (!fps()[i].IsInvalid() && (fps()[i].GetRaw() & mask) == tag)
+#else
+            if (pairs[i] && (std::hash<std::string_view>{}(pairs[i]->Key()) & mask) == tag)
+#endif
+            {
+                func(pairs[i]);
+            }
+        }
+    }
+
     void Bucket::Lock() noexcept
     {
 #ifdef PLOCK
@@ -210,21 +430,21 @@ namespace Dalea
 #endif
     }
 
-    bool Bucket::TryLock() noexcept
+    bool Bucket::TryLock(BucketCache *side) noexcept
     {
 #ifdef PLOCK
         return mux.try_lock();
 #else
-        return mux->try_lock();
+        return mutex(side).try_lock();
 #endif
     }
 
-    void Bucket::Unlock() noexcept
+    void Bucket::Unlock(BucketCache *side) noexcept
     {
 #ifdef PLOCK
         mux.unlock();
 #else
-        mux->unlock();
+        mutex(side).unlock();
 #endif
     }
 
@@ -255,15 +475,16 @@ namespace Dalea
 #endif
     }
 
-    bool Bucket::HasAncestor() const noexcept
+    bool Bucket::HasAncestor(BucketCache *side) const noexcept
     {
-        return metainfo.has_ancestor;
+        return meta(side).has_ancestor;
     }
 
     void Bucket::SetAncestor(int64_t an) noexcept
     {
         metainfo.has_ancestor = 1;
         metainfo.ancestor = an;
+        sync_meta();
     }
 
     void Bucket::SetAncestorPersist(PoolBase &pop, int64_t an) noexcept
@@ -272,78 +493,89 @@ namespace Dalea
         tmp.has_ancestor = 1;
         tmp.ancestor = an;
         metainfo = tmp;
-        pmemobj_persist(pop.handle(), &metainfo, sizeof(BucketMeta));
+        Persist(pop, &metainfo, sizeof(BucketMeta));
+        sync_meta();
     }
 
-    uint64_t Bucket::GetAncestor() const noexcept
+    uint64_t Bucket::GetAncestor(BucketCache *side) const noexcept
     {
-        auto tmp = metainfo;
+        auto tmp = meta(side);
         return tmp.ancestor;
     }
 
     void Bucket::ClearAncestor() noexcept
     {
         metainfo.has_ancestor = 1;
+        sync_meta();
     }
 
     void Bucket::ClearAncestorPersist(PoolBase &pop) noexcept
     {
         metainfo.has_ancestor = 0;
-        pmemobj_persist(pop.handle(), &metainfo, sizeof(BucketMeta));
+        Persist(pop, &metainfo, sizeof(BucketMeta));
+        sync_meta();
     }
 
     void Bucket::SetDepth(uint8_t depth) noexcept
     {
         metainfo.local_depth = depth;
+        sync_meta();
     }
 
     void Bucket::SetDepthPersist(PoolBase &pop, uint8_t depth) noexcept
     {
         metainfo.local_depth = depth;
-        pmemobj_persist(pop.handle(), &metainfo, sizeof(BucketMeta));
+        Persist(pop, &metainfo, sizeof(BucketMeta));
+        sync_meta();
     }
 
     void Bucket::IncDepth() noexcept
     {
         metainfo.local_depth += 1;
+        sync_meta();
     }
 
     void Bucket::IncDepthPersist(PoolBase &pop) noexcept
     {
         metainfo.local_depth += 1;
-        pmemobj_persist(pop.handle(), &metainfo, sizeof(BucketMeta));
+        Persist(pop, &metainfo, sizeof(BucketMeta));
+        sync_meta();
     }
 
-    uint8_t Bucket::GetDepth() const noexcept
+    uint8_t Bucket::GetDepth(BucketCache *side) const noexcept
     {
-        return metainfo.local_depth;
+        return meta(side).local_depth;
     }
 
     void Bucket::SetSplit() noexcept
     {
         metainfo.split_flag = 1;
+        sync_meta();
     }
 
     void Bucket::SetSplitPersist(PoolBase &pop) noexcept
     {
         metainfo.split_flag = 1;
-        pmemobj_persist(pop.handle(), &metainfo, sizeof(BucketMeta));
+        Persist(pop, &metainfo, sizeof(BucketMeta));
+        sync_meta();
     }
 
     bool Bucket::IsSplitting() const noexcept
     {
-        return metainfo.split_flag;
+        return meta().split_flag;
     }
 
     void Bucket::ClearSplit() noexcept
     {
         metainfo.split_flag = 0;
+        sync_meta();
     }
 
     void Bucket::ClearSplitPersist(PoolBase &pop) noexcept
     {
         metainfo.split_flag = 0;
-        pmemobj_persist(pop.handle(), &metainfo, sizeof(BucketMeta));
+        Persist(pop, &metainfo, sizeof(BucketMeta));
+        sync_meta();
     }
 
     void Bucket::SetMetaPersist(PoolBase &pop, uint8_t dep, uint8_t split, uint64_t an) noexcept
@@ -361,7 +593,8 @@ namespace Dalea
             tmp.ancestor = an;
         }
         metainfo = tmp;
-        pmemobj_persist(pop.handle(), &metainfo, sizeof(BucketMeta));
+        Persist(pop, &metainfo, sizeof(BucketMeta));
+        sync_meta();
     }
 
     void Bucket::UpdateSplitMetaPersist(PoolBase &pop) noexcept
@@ -370,7 +603,8 @@ namespace Dalea
         ++tmp.local_depth;
         tmp.split_flag = 1;
         metainfo = tmp;
-        pmemobj_persist(pop.handle(), &metainfo, sizeof(BucketMeta));
+        Persist(pop, &metainfo, sizeof(BucketMeta));
+        sync_meta();
     }
 
     void Bucket::Migrate(PoolBase &pop, Bucket &buddy, uint64_t encoding) noexcept
@@ -379,23 +613,25 @@ namespace Dalea
         for (int i = 0; i < BUCKET_SIZE; i++)
         {
 #ifdef USE_FP
-            if (!fingerprints[i].IsInvalid())
+            if (!fps()[i].IsInvalid())
             {
-                if ((fingerprints[i].GetRaw() & mask) != encoding)
+                if ((fps()[i].GetRaw() & mask) != encoding)
                 {
 #else
             if (pairs[i])
             {
-                auto hv = std::hash<std::string>{}(std::string(pairs[i]->key.c_str()));
+                auto hv = std::hash<std::string_view>{}(pairs[i]->Key());
                 if ((hv & mask) != encoding)
                 {
 #endif
                     // buddy bucket is ensured to be empty
-                    buddy.fingerprints[i] = fingerprints[i];
+                    buddy.fps()[i] = fps()[i];
                     buddy.pairs[i] = pairs[i];
-                    pmemobj_persist(pop.handle(), buddy.pairs + i, sizeof(KVPairPtr));
-                    pmemobj_persist(pop.handle(), buddy.fingerprints + i, sizeof(HashValue));
-                    fingerprints[i].Invalidate();
+                    Persist(pop, buddy.pairs + i, sizeof(KVPairPtr));
+#ifndef HYBRID
+                    Persist(pop, buddy.fingerprints + i, sizeof(HashValue));
+#endif
+                    fps()[i].Invalidate();
                     pairs[i] = nullptr;
                 }
             }
@@ -403,24 +639,224 @@ namespace Dalea
         buddy.ClearAncestorPersist(pop);
     }
 
+    void Bucket::Merge(PoolBase &pop, Bucket &buddy, uint64_t encoding, uint64_t buddy_encoding) noexcept
+    {
+        uint64_t mask = (1UL << GetDepth()) - 1;
+        uint64_t buddy_mask = (1UL << buddy.GetDepth()) - 1;
+        int slot = 0;
+        for (int i = 0; i < BUCKET_SIZE; i++)
+        {
+#ifdef USE_FP
+            if (buddy.fps()[i].IsInvalid() || (buddy.fps()[i].GetRaw() & buddy_mask) != (buddy_encoding & buddy_mask))
+            {
+                continue;
+            }
+#else
+            if (!buddy.pairs[i] || (std::hash<std::string_view>{}(buddy.pairs[i]->Key()) & buddy_mask) != (buddy_encoding & buddy_mask))
+            {
+                continue;
+            }
+#endif
+            // the caller ensures both buddies together fit into this bucket
+            while (!fps()[slot].IsInvalid() && (fps()[slot].GetRaw() & mask) == (encoding & mask))
+            {
+                ++slot;
+            }
+            fps()[slot] = buddy.fps()[i];
+            pairs[slot] = buddy.pairs[i];
+            Persist(pop, pairs + slot, sizeof(KVPairPtr));
+#ifndef HYBRID
+            Persist(pop, fingerprints + slot, sizeof(HashValue));
+#endif
+            buddy.fps()[i].Invalidate();
+            buddy.pairs[i] = nullptr;
+            Persist(pop, buddy.pairs + i, sizeof(KVPairPtr));
+            ++slot;
+        }
+    }
+
+    void Bucket::Clear(PoolBase &pop) noexcept
+    {
+        for (int i = 0; i < BUCKET_SIZE; i++)
+        {
+            fps()[i].Invalidate();
+            pairs[i] = nullptr;
+        }
+#ifndef HYBRID
+        Persist(pop, fingerprints, sizeof(fingerprints));
+#endif
+        Persist(pop, pairs, sizeof(pairs));
+    }
+
+    void Bucket::Recover() noexcept
+    {
+#ifdef HYBRID
+        // the DRAM copy of the previous run went away with its process, Segment attaches a new one
+        cache = nullptr;
+#ifndef PLOCK
+        mux = nullptr;
+#endif
+#elif !defined(PLOCK)
+        // the lock of the previous run went away with its process
+        mux = new std::shared_mutex;
+#endif
+    }
+
+#ifdef HYBRID
+    void Bucket::Attach(BucketCache *side) noexcept
+    {
+        cache = side;
+#ifndef PLOCK
+        mux = side ? &side->mux : nullptr;
+#endif
+        if (side == nullptr)
+        {
+            return;
+        }
+        cache->metainfo = metainfo;
+        // empty for a new segment, slots left by splits included for a recovered one
+        for (int i = 0; i < BUCKET_SIZE; i++)
+        {
+            if (pairs[i] != nullptr)
+            {
+                cache->fingerprints[i] = HashValue(std::hash<std::string_view>{}(pairs[i]->Key()));
+            }
+            else
+            {
+                cache->fingerprints[i].Invalidate();
+            }
+        }
+    }
+#endif
+
+    // metainfo and fingerprints are read from PM unless HYBRID keeps them in DRAM
+    void Bucket::emulate_scan() const noexcept
+    {
+#ifndef HYBRID
+        EmulateRead(&metainfo, sizeof(metainfo) + sizeof(fingerprints));
+#endif
+    }
+
+    Bucket::BucketMeta &Bucket::meta(BucketCache *side) noexcept
+    {
+#ifdef HYBRID
+        return (side ? side : cache)->metainfo;
+#else
+        return metainfo;
+#endif
+    }
+
+    const Bucket::BucketMeta &Bucket::meta(BucketCache *side) const noexcept
+    {
+#ifdef HYBRID
+        return (side ? side : cache)->metainfo;
+#else
+        return metainfo;
+#endif
+    }
+
+    HashValue *Bucket::fps(BucketCache *side) noexcept
+    {
+#ifdef HYBRID
+        return (side ? side : cache)->fingerprints;
+#else
+        return fingerprints;
+#endif
+    }
+
+    const HashValue *Bucket::fps(BucketCache *side) const noexcept
+    {
+#ifdef HYBRID
+        return (side ? side : cache)->fingerprints;
+#else
+        return fingerprints;
+#endif
+    }
+
+#ifndef PLOCK
+    std::shared_mutex &Bucket::mutex(BucketCache *side) const noexcept
+    {
+#ifdef HYBRID
+        return side ? side->mux : *mux;
+#else
+        return *mux;
+#endif
+    }
+#endif
+
+    void Bucket::sync_meta() noexcept
+    {
+#ifdef HYBRID
+        // a segment in the pool has no DRAM copy until it is linked
+        if (cache != nullptr)
+        {
+            cache->metainfo = metainfo;
+        }
+#endif
+    }
+
+    int Bucket::find(const String &key, const HashValue &hash_value, BucketCache *side) const noexcept
+    {
+        for (int i = 0; i < BUCKET_SIZE; i++)
+        {
+#ifdef USE_FP
+            if (fps(side)[i] == hash_value && (EmulateRead(pairs[i]), pairs[i]->Key() == key))
+#else
+            if (pairs[i] && pairs[i]->Key() == key)
+#endif
+            {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    int Bucket::vacant(uint64_t encoding, BucketCache *side) const noexcept
+    {
+        auto mask = ((1UL << GetDepth(side)) - 1);
+        for (int i = 0; i < BUCKET_SIZE; i++)
+        {
+            if (fps(side)[i].IsInvalid() || (fps(side)[i].GetRaw() & mask) != encoding)
+            {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    void Bucket::replace(PoolBase &pop, SlabAllocator &slab, int slot, std::string_view key, std::string_view value) noexcept
+    {
+        // out of place, a crash leaves either pair linked and Sweep frees the other
+        auto old = pairs[slot];
+        pairs[slot] = slab.Make(pop, key, value);
+        Persist(pop, pairs + slot, sizeof(KVPairPtr));
+        slab.Free(pop, old);
+    }
+
+    void Bucket::Fill(int slot, const KVPairPtr &pair, const HashValue &hash_value) noexcept
+    {
+        pairs[slot] = pair;
+        fps()[slot] = hash_value;
+    }
+
     void Bucket::PersistMeta(PoolBase &pop) const noexcept
     {
-        pmemobj_persist(pop.handle(), &metainfo, 8 * sizeof(uint8_t));
+        Persist(pop, &metainfo, 8 * sizeof(uint8_t));
     }
 
     void Bucket::PersistFingerprints(PoolBase &pop, int index) const noexcept
     {
-        pmemobj_persist(pop.handle(), &fingerprints[index], sizeof(HashValue));
+        Persist(pop, &fingerprints[index], sizeof(HashValue));
     }
 
     void Bucket::PersistAncestor(PoolBase &pop) const noexcept
     {
-        pmemobj_persist(pop.handle(), &metainfo, sizeof(uint64_t));
+        Persist(pop, &metainfo, sizeof(uint64_t));
     }
 
     void Bucket::PersistAll(PoolBase &pop) const noexcept
     {
-        pmemobj_persist(pop.handle(), this, sizeof(Bucket));
+        Persist(pop, this, sizeof(Bucket));
     }
 
     void Bucket::Debug(uint64_t tag) const noexcept
@@ -431,7 +867,7 @@ namespace Dalea
         std::for_each(std::begin(pairs), std::end(pairs), [&](const KVPairPtr &kvp) {
             if (kvp != nullptr)
             {
-                std::cout << "       >> " << kvp->key.c_str() << "\n";
+                std::cout << "       >> " << kvp->Key() << "\n";
             }
         });
 
@@ -449,7 +885,7 @@ namespace Dalea
         std::for_each(std::begin(pairs), std::end(pairs), [&](const KVPairPtr &kvp) {
             if (kvp != nullptr)
             {
-                strm << "       >> " << kvp->key.c_str() << "\n";
+                strm << "       >> " << kvp->Key() << "\n";
             }
         });
 
@@ -1,8 +1,9 @@
 #ifndef __DALEA__BUCKET__BUCKET__
 #define __DALEA__BUCKET__BUCKET__
-#include "KVPair/KVPair.hpp"
 #include "Logger/Logger.hpp"
+#include "Slab/Slab.hpp"
 
+#include <functional>
 #include <optional>
 #include <shared_mutex>
 namespace Dalea
@@ -14,6 +15,41 @@ namespace Dalea
      */
     struct Bucket
     {
+    private:
+        /*
+         * metainfo:
+         *     local depth: 1 byte
+         *     split flag:  1 byte
+         *     ancestor:    6 byte
+         */
+        struct BucketMeta
+        {
+            uint64_t local_depth : 8;
+            uint64_t split_flag : 1;
+            uint64_t has_ancestor : 1;
+            uint64_t : 6;
+            uint64_t ancestor : 48;
+        };
+
+    public:
+#ifdef HYBRID
+        /*
+         * DRAM copy of metainfo and fingerprints, and the lock; metainfo is still persisted for
+         * recovery, fingerprints are never written to PM and are recomputed from pairs by Attach.
+         * Kept per segment in the side array of its ShadowSegment
+         */
+        struct BucketCache
+        {
+            BucketMeta metainfo;
+            HashValue fingerprints[BUCKET_SIZE];
+#ifndef PLOCK
+            std::shared_mutex mux;
+#endif
+        };
+#else
+        struct BucketCache;
+#endif
+
         Bucket();
         Bucket(const Bucket &) = delete;
         Bucket(Bucket &&) = delete;
@@ -23,28 +59,53 @@ namespace Dalea
          */
         ~Bucket() = default;
 
-        FunctionStatus Get(const String &key, const HashValue &hash_value, KVPairPtr &ptr, uint64_t segno) const noexcept;
-        FunctionStatus Put(PoolBase &pop, const String &key, const String &value, const HashValue &hash_value, uint64_t segno) noexcept;
-        FunctionStatus Put(Logger &logger, PoolBase &pop, const String &key, const String &value, const HashValue &hash_value, uint64_t segno) noexcept;
-        FunctionStatus Remove(const String &key, const HashValue &hash_value, std::shared_mutex &mux) const noexcept;
+        /*
+         * side is this bucket's entry in the side array of its ShadowSegment under HYBRID; lookups
+         * pass it so that only the pair is read from PM, nullptr reads it through cache instead
+         */
+        FunctionStatus Get(const String &key, const HashValue &hash_value, KVPairPtr &ptr, uint64_t segno, BucketCache *side = nullptr) const noexcept;
+        // pairs are made and freed by slab, an update replaces the pair of its key
+        FunctionStatus Put(PoolBase &pop, SlabAllocator &slab, const String &key, const String &value, const HashValue &hash_value, uint64_t segno, BucketCache *side = nullptr) noexcept;
+        FunctionStatus Put(Logger &logger, PoolBase &pop, SlabAllocator &slab, const String &key, const String &value, const HashValue &hash_value, uint64_t segno, BucketCache *side = nullptr) noexcept;
+        FunctionStatus Remove(PoolBase &pop, SlabAllocator &slab, const String &key, const HashValue &hash_value, uint64_t segno, BucketCache *side = nullptr) noexcept;
+        // counters, see HashTable
+        FunctionStatus FetchAdd(PoolBase &pop, SlabAllocator &slab, const String &key, int64_t delta, int64_t &previous, const HashValue &hash_value, uint64_t segno, BucketCache *side = nullptr) noexcept;
+        FunctionStatus CompareExchange(PoolBase &pop, const String &key, int64_t &expected, int64_t desired, const HashValue &hash_value, uint64_t segno, BucketCache *side = nullptr) noexcept;
+        // link a pair made before, e.g. in the overflow area; Ok if it is linked already
+        FunctionStatus Link(PoolBase &pop, const KVPairPtr &pair, const HashValue &hash_value, uint64_t segno, BucketCache *side = nullptr) noexcept;
+        // the key of hash_value belongs here under encoding segno, unless a split moved it on
+        bool Owns(const HashValue &hash_value, uint64_t segno, BucketCache *side = nullptr) const noexcept;
+        // replace every pair owned under encoding segno that moving selects by a copy, returns their number
+        int Relocate(PoolBase &pop, SlabAllocator &slab, uint64_t segno, const std::function<bool(const KVPairPtr &)> &moving) noexcept;
+        // number of pairs this bucket owns under encoding segno
+        int Count(uint64_t segno, BucketCache *side = nullptr) const noexcept;
+        // visit pairs owned by this bucket under a shared lock; nothing if it redirects to an ancestor
+        void ForEach(uint64_t segno, const std::function<void(const KVPairPtr &)> &func) const noexcept;
+
+        // rebuild volatile parts (lock, DRAM metadata) after the pool is opened again, HYBRID ones by Attach
+        void Recover() noexcept;
+#ifdef HYBRID
+        // take side as this bucket's DRAM copy and lock, from Segment; nullptr detaches
+        void Attach(BucketCache *side) noexcept;
+#endif
 
         void Lock() noexcept;
-        bool TryLock() noexcept;
-        void Unlock() noexcept;
+        bool TryLock(BucketCache *side = nullptr) noexcept;
+        void Unlock(BucketCache *side = nullptr) noexcept;
         void LockShared() noexcept;
         bool TryLockShared() noexcept;
         void UnlockShared() noexcept;
 
-        bool HasAncestor() const noexcept;
+        bool HasAncestor(BucketCache *side = nullptr) const noexcept;
         void SetAncestor(int64_t an) noexcept;
         void SetAncestorPersist(PoolBase &pop, int64_t an) noexcept;
-        uint64_t GetAncestor() const noexcept;
+        uint64_t GetAncestor(BucketCache *side = nullptr) const noexcept;
         void ClearAncestor() noexcept;
         void ClearAncestorPersist(PoolBase &pop) noexcept;
 
         void SetDepth(uint8_t depth) noexcept;
         void SetDepthPersist(PoolBase &pop, uint8_t depth) noexcept;
-        uint8_t GetDepth() const noexcept;
+        uint8_t GetDepth(BucketCache *side = nullptr) const noexcept;
         void IncDepth() noexcept;
         void IncDepthPersist(PoolBase &pop) noexcept;
 
@@ -61,6 +122,12 @@ namespace Dalea
         void UpdateSplitMetaPersist(PoolBase &pop) noexcept;
         // second: migrate pairs
         void Migrate(PoolBase &pop, Bucket &buddy, uint64_t encoding) noexcept;
+        // inverse of Migrate: move pairs buddy owns under buddy_encoding into free slots of this bucket
+        void Merge(PoolBase &pop, Bucket &buddy, uint64_t encoding, uint64_t buddy_encoding) noexcept;
+        // empty every slot, stale ones left by splits included, before the segment is reused
+        void Clear(PoolBase &pop) noexcept;
+        // bulk construction only: place a pair into an empty slot, the caller persists the whole segment
+        void Fill(int slot, const KVPairPtr &pair, const HashValue &hash_value) noexcept;
 
         void PersistMeta(PoolBase &pop) const noexcept;
         void PersistFingerprints(PoolBase &pop, int index) const noexcept;
@@ -72,20 +139,25 @@ namespace Dalea
         void DebugTo(std::stringstream &strm, uint64_t tag) const noexcept;
 
     private:
-        /*
-         * metainfo:
-         *     local depth: 1 byte
-         *     split flag:  1 byte
-         *     ancestor:    6 byte
-         */
-        struct BucketMeta
-        {
-            uint64_t local_depth : 8;
-            uint64_t split_flag : 1;
-            uint64_t has_ancestor : 1;
-            uint64_t : 6;
-            uint64_t ancestor : 48;
-        };
+        // the DRAM copy under HYBRID, side if the caller passed it; PM otherwise
+        BucketMeta &meta(BucketCache *side = nullptr) noexcept;
+        const BucketMeta &meta(BucketCache *side = nullptr) const noexcept;
+        HashValue *fps(BucketCache *side = nullptr) noexcept;
+        const HashValue *fps(BucketCache *side = nullptr) const noexcept;
+#ifndef PLOCK
+        // the lock, from side if the caller passed it
+        std::shared_mutex &mutex(BucketCache *side) const noexcept;
+#endif
+        // mirror metainfo to DRAM after it is modified
+        void sync_meta() noexcept;
+        // PM_EMULATION read cost of a slot scan
+        void emulate_scan() const noexcept;
+        // slot holding key, -1 if none does
+        int find(const String &key, const HashValue &hash_value, BucketCache *side) const noexcept;
+        // a slot free or lazily deleted under encoding, -1 if none is
+        int vacant(uint64_t encoding, BucketCache *side) const noexcept;
+        // link a new pair of key and value at slot, then free the one it held
+        void replace(PoolBase &pop, SlabAllocator &slab, int slot, std::string_view key, std::string_view value) noexcept;
 
     public:
         /* 
@@ -97,9 +169,14 @@ namespace Dalea
 // the index of ancestor segment in directory
 // int64_t padding;
 #ifdef PLOCK
-        mutable pobj::shared_mutex mux;
+        mutable Backend::SharedMutex mux;
 #else
+        // the lock in cache under HYBRID
         std::shared_mutex *mux;
+#endif
+#ifdef HYBRID
+        // entry in the side array of the segment's ShadowSegment, for callers without one at hand
+        BucketCache *cache;
 #endif
     };
 } // namespace Dalea
@@ -0,0 +1,128 @@
+#include "Cache.hpp"
+namespace Dalea
+{
+    ReadCache::ReadCache(uint64_t capacity) : set_bits(0)
+    {
+        while ((uint64_t(WAYS) << set_bits) < capacity)
+        {
+            set_bits++;
+        }
+        sets = std::make_unique<Set[]>(1UL << set_bits);
+    }
+
+    bool ReadCache::Get(uint64_t hash, const std::string &key, KVPairPtr &ret, uint64_t &version) noexcept
+    {
+        auto &s = set_of(hash);
+        uint64_t sequence;
+        Entry *e;
+        KVPairPtr pair;
+        do
+        {
+            sequence = s.sequence.load(std::memory_order_acquire);
+            while (sequence & 1)
+            {
+                sequence = s.sequence.load(std::memory_order_acquire);
+            }
+            version = s.version.load(std::memory_order_relaxed);
+            e = find(s, hash);
+            pair = e ? e->pair : nullptr;
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while (s.sequence.load(std::memory_order_relaxed) != sequence);
+        if (e == nullptr)
+        {
+            return false;
+        }
+        // Invalidate precedes freeing the pair, so an unchanged sequence vouches for its key
+        auto match = pair->Key() == key;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (!match || s.sequence.load(std::memory_order_relaxed) != sequence)
+        {
+            return false;
+        }
+        // hot entries are referenced already, skip the store to their line
+        if (!e->referenced.load(std::memory_order_relaxed))
+        {
+            e->referenced.store(true, std::memory_order_relaxed);
+        }
+        ret = pair;
+        return true;
+    }
+
+    void ReadCache::Insert(uint64_t hash, const KVPairPtr &pair, uint64_t version) noexcept
+    {
+        auto &s = set_of(hash);
+        std::lock_guard<std::mutex> _(s.lock);
+        if (s.version.load(std::memory_order_relaxed) != version)
+        {
+            return;
+        }
+        begin_write(s);
+        // a colliding key takes the entry over
+        auto e = find(s, hash);
+        if (e == nullptr)
+        {
+            // second chance: referenced entries are skipped once, free ones are taken at once
+            while (s.entries[s.hand].valid.load(std::memory_order_relaxed) && s.entries[s.hand].referenced.load(std::memory_order_relaxed))
+            {
+                s.entries[s.hand].referenced.store(false, std::memory_order_relaxed);
+                s.hand = (s.hand + 1) % WAYS;
+            }
+            e = &s.entries[s.hand];
+            s.hand = (s.hand + 1) % WAYS;
+        }
+        e->hash.store(hash, std::memory_order_relaxed);
+        e->pair = pair;
+        e->valid.store(true, std::memory_order_relaxed);
+        e->referenced.store(false, std::memory_order_relaxed);
+        end_write(s);
+    }
+
+    void ReadCache::Invalidate(uint64_t hash) noexcept
+    {
+        auto &s = set_of(hash);
+        std::lock_guard<std::mutex> _(s.lock);
+        s.version.fetch_add(1, std::memory_order_relaxed);
+        auto e = find(s, hash);
+        if (e != nullptr)
+        {
+            begin_write(s);
+            e->valid.store(false, std::memory_order_relaxed);
+            e->pair = nullptr;
+            end_write(s);
+        }
+    }
+
+    uint64_t ReadCache::Capacity() const noexcept
+    {
+        return uint64_t(WAYS) << set_bits;
+    }
+
+    ReadCache::Set &ReadCache::set_of(uint64_t hash) noexcept
+    {
+        // segment and bucket bits are the lowest ones, mix them all in
+        return sets[set_bits == 0 ? 0 : (hash * 0x9E3779B97F4A7C15UL) >> (64 - set_bits)];
+    }
+
+    void ReadCache::begin_write(Set &s) noexcept
+    {
+        s.sequence.store(s.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void ReadCache::end_write(Set &s) noexcept
+    {
+        s.sequence.store(s.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    ReadCache::Entry *ReadCache::find(Set &s, uint64_t hash) noexcept
+    {
+        for (auto &e : s.entries)
+        {
+            if (e.valid.load(std::memory_order_relaxed) && e.hash.load(std::memory_order_relaxed) == hash)
+            {
+                return &e;
+            }
+        }
+        return nullptr;
+    }
+} // namespace Dalea
@@ -0,0 +1,70 @@
+#ifndef __DALEA__CACHE__CACHE__
+#define __DALEA__CACHE__CACHE__
+#include "KVPair/KVPair.hpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+namespace Dalea
+{
+    /*
+     * bounded DRAM cache of hot pairs in front of HashTable::Get, so that skewed reads skip
+     * the walk over directory, segment and bucket in PM. Keyed by hash, the key of the pair
+     * tells colliding keys apart. The hash picks a set of WAYS entries, eviction is CLOCK
+     * within the set, so nothing is allocated at all
+     *
+     * a pair enters only through Insert with the version its missing Get returned, before
+     * the table lookup; Invalidate bumps the version, so a pair removed meanwhile is never
+     * cached again. Get takes no lock: the lock of a set only orders writers, which make its
+     * sequence odd while they change entries, and Get tries again if the sequence moved
+     */
+    class ReadCache
+    {
+    public:
+        static constexpr int WAYS = 8;
+
+        // capacity in pairs, rounded up to a power of two sets
+        ReadCache(uint64_t capacity);
+        ReadCache() = delete;
+        ReadCache(const ReadCache &) = delete;
+        ReadCache(ReadCache &&) = delete;
+
+        // on a miss, version is what a following Insert of this hash has to pass
+        bool Get(uint64_t hash, const std::string &key, KVPairPtr &ret, uint64_t &version) noexcept;
+        void Insert(uint64_t hash, const KVPairPtr &pair, uint64_t version) noexcept;
+        // called before the pair of hash is unlinked or replaced in the table, under its bucket lock
+        void Invalidate(uint64_t hash) noexcept;
+        uint64_t Capacity() const noexcept;
+
+    private:
+        struct Entry
+        {
+            std::atomic<uint64_t> hash{0};
+            // read by Get between two loads of the sequence of its set only
+            KVPairPtr pair = nullptr;
+            std::atomic_bool valid{false};
+            std::atomic_bool referenced{false};
+        };
+
+        struct alignas(64) Set
+        {
+            std::mutex lock;
+            // odd while a writer changes entries
+            std::atomic<uint64_t> sequence{0};
+            std::atomic<uint64_t> version{0};
+            int hand = 0;
+            Entry entries[WAYS];
+        };
+
+        int set_bits;
+        std::unique_ptr<Set[]> sets;
+
+        Set &set_of(uint64_t hash) noexcept;
+        static Entry *find(Set &s, uint64_t hash) noexcept;
+        // bracket changes of entries, under the lock of s
+        static void begin_write(Set &s) noexcept;
+        static void end_write(Set &s) noexcept;
+    };
+} // namespace Dalea
+#endif
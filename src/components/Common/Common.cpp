@@ -1,6 +1,52 @@
 #include "Common.hpp"
+
+#include <chrono>
 namespace Dalea
 {
+    uint64_t PMEmulation::flush_ns = 0;
+    uint64_t PMEmulation::fence_ns = 0;
+    uint64_t PMEmulation::read_ns = 0;
+
+    static uint64_t cache_lines(const void *addr, size_t len) noexcept
+    {
+        if (len == 0)
+        {
+            return 0;
+        }
+        auto begin = reinterpret_cast<uintptr_t>(addr) / PMEmulation::CACHE_LINE;
+        auto end = (reinterpret_cast<uintptr_t>(addr) + len - 1) / PMEmulation::CACHE_LINE;
+        return end - begin + 1;
+    }
+
+    // sleeping is far too coarse for device latencies
+    static void spin(uint64_t ns) noexcept
+    {
+        if (ns == 0)
+        {
+            return;
+        }
+        auto until = std::chrono::steady_clock::now() + std::chrono::nanoseconds(ns);
+        while (std::chrono::steady_clock::now() < until)
+            ;
+    }
+
+    void PMEmulation::Configure(uint64_t flush, uint64_t fence, uint64_t read) noexcept
+    {
+        flush_ns = flush;
+        fence_ns = fence;
+        read_ns = read;
+    }
+
+    void PMEmulation::Flush(const void *addr, size_t len) noexcept
+    {
+        spin(cache_lines(addr, len) * flush_ns + fence_ns);
+    }
+
+    void PMEmulation::Read(const void *addr, size_t len) noexcept
+    {
+        spin(cache_lines(addr, len) * read_ns);
+    }
+
     uint64_t HashValue::SegmentBits(uint64_t depth) const noexcept
     {
         uint64_t mask = (1ULL << depth) - 1;
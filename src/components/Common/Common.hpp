@@ -1,10 +1,6 @@
 #ifndef __DALEA__COMMON__COMMON__
 #define __DALEA__COMMON__COMMON__
-#include <libpmemobj++/container/string.hpp>
-#include <libpmemobj++/persistent_ptr.hpp>
-#include <libpmemobj++/pool.hpp>
-#include <libpmemobj++/transaction.hpp>
-#include <libpmemobj++/shared_mutex.hpp>
+#include "Backend/Backend.hpp"
 
 #include <mutex>
 #include <shared_mutex>
@@ -16,15 +12,22 @@
 // #define DEBUG
 #define USE_FP
 // #define PLOCK
+// keep bucket metadata and fingerprints in DRAM, only pairs and recovery metadata in PM
+// #define HYBRID
+// delay every Persist and PM read as configured by PMEmulation, for pools on DRAM or tmpfs
+// #define PM_EMULATION
+// volatile index: plain pointers and heap memory, no flushes and no transactions, see Backend
+// #define DRAM_BACKEND
+
+#if defined(PM_EMULATION) && defined(DRAM_BACKEND)
+#error "PM_EMULATION delays persistence, which DRAM_BACKEND does not have"
+#endif
 
 namespace Dalea
 {
     using String = std::string;
-    using PString = pmem::obj::string;
-    using PoolBase = pmem::obj::pool_base;
-    using TX = pmem::obj::transaction;
+    using PString = Backend::Str;
     using RelativePtr = uint64_t;
-    namespace pobj = pmem::obj;
 
     enum class FunctionStatus
     {
@@ -42,7 +45,10 @@ namespace Dalea
     constexpr int SEG_SIZE = (1 << Dalea::BUCKET_BITS);
     constexpr int SUBDIR_SIZE = (1 << 16);
     constexpr int METADIR_SIZE = (1 << 4);
+    // slots of the overflow area, see OverflowArea
     constexpr int STASH_LIMIT = 128;
+    // buddies each holding at most this many pairs are merged back into one bucket
+    constexpr int MERGE_THRESHOLD = BUCKET_SIZE / 4;
 #else
     constexpr int BUCKET_SIZE = 2;
     constexpr int META_BITS = 16;
@@ -50,6 +56,8 @@ namespace Dalea
     constexpr int SEG_SIZE = (1 << Dalea::BUCKET_BITS);
     constexpr int SUBDIR_SIZE = (1 << 4);
     constexpr int METADIR_SIZE = (1 << 16);
+    constexpr int STASH_LIMIT = 4;
+    constexpr int MERGE_THRESHOLD = BUCKET_SIZE / 2;
 #endif
 
     struct HashValue
@@ -71,5 +79,52 @@ namespace Dalea
 
         bool operator==(const HashValue &h) const noexcept;
     };
+
+    /*
+     * latencies charged under PM_EMULATION, by spinning: flush_ns per cache line written
+     * back and fence_ns per Persist, read_ns per cache line read through EmulateRead.
+     * Flushes libpmemobj issues inside transactions are not delayed
+     */
+    struct PMEmulation
+    {
+        static constexpr uint64_t CACHE_LINE = 64;
+        static uint64_t flush_ns;
+        static uint64_t fence_ns;
+        static uint64_t read_ns;
+
+        // set before any thread works on a pool
+        static void Configure(uint64_t flush, uint64_t fence, uint64_t read) noexcept;
+        static void Flush(const void *addr, size_t len) noexcept;
+        static void Read(const void *addr, size_t len) noexcept;
+    };
+
+    // all persistence of the index goes through here
+    inline void Persist(PoolBase &pop, const void *addr, size_t len) noexcept
+    {
+        Backend::Persist(pop, addr, len);
+        if constexpr (Backend::PERSISTENT)
+        {
+            Metrics::Add(Metric::Flushes);
+        }
+#ifdef PM_EMULATION
+        PMEmulation::Flush(addr, len);
+#endif
+    }
+
+    // marks a read from PM, free unless PM_EMULATION
+    inline void EmulateRead([[maybe_unused]] const void *addr, [[maybe_unused]] size_t len) noexcept
+    {
+#ifdef PM_EMULATION
+        PMEmulation::Read(addr, len);
+#endif
+    }
+
+    template <typename T>
+    inline void EmulateRead([[maybe_unused]] const Backend::Ptr<T> &ptr) noexcept
+    {
+#ifdef PM_EMULATION
+        PMEmulation::Read(ptr.get(), sizeof(T));
+#endif
+    }
 } // namespace Dalea
 #endif
@@ -3,10 +3,13 @@ namespace Dalea
 {
     Directory::MetaDirectory::MetaDirectory(PoolBase &pop)
     {
-        TX::run(pop, [&]() {
-            subdirectories[0] = pobj::make_persistent<Directory::SubDirectory>(pop);
-            pop.persist(subdirectories[0]);
+        Backend::Run(pop, [&]() {
+            subdirectories[0] = Backend::Make<Directory::SubDirectory>(pop);
+            Dalea::Persist(pop, &subdirectories[0], sizeof(subdirectories[0]));
         });
+        // the first two segments are linked from the start
+        subdirectories[0]->segments[0]->MakeShadow();
+        subdirectories[0]->segments[1]->MakeShadow();
         for (int i = 1; i < METADIR_SIZE; i++)
         {
             subdirectories[i] = nullptr;
@@ -15,11 +18,11 @@ namespace Dalea
 
     Directory::SubDirectory::SubDirectory(PoolBase &pop)
     {
-        TX::run(pop, [&]() {
-            segments[0] = pobj::make_persistent<Segment>(pop, 1, 0, false);
-            segments[1] = pobj::make_persistent<Segment>(pop, 1, 1, false);
-            pop.persist(segments[0]);
-            pop.persist(segments[1]);
+        Backend::Run(pop, [&]() {
+            segments[0] = Backend::Make<Segment>(pop, 1, 0, false);
+            segments[1] = Backend::Make<Segment>(pop, 1, 1, false);
+            Dalea::Persist(pop, &segments[0], sizeof(segments[0]));
+            Dalea::Persist(pop, &segments[1], sizeof(segments[1]));
         });
 
         for (int i = 2; i < SUBDIR_SIZE; i++)
@@ -31,10 +34,33 @@ namespace Dalea
 #endif
     }
 
+    Directory::ShadowDirectory::ShadowDirectory(uint64_t cap) : capacity(cap), retired(nullptr)
+    {
+        segments = new std::atomic<ShadowSegment *>[cap];
+        for (uint64_t i = 0; i < cap; i++)
+        {
+            segments[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    Directory::ShadowDirectory::~ShadowDirectory()
+    {
+        delete[] segments;
+        delete retired;
+    }
+
+    Directory::Directory(PoolBase &pop) : meta(pop)
+    {
+        shadow = nullptr;
+        RebuildShadow(1);
+    }
+
     const SegmentPtr &Directory::GetSegment(uint64_t pos) const noexcept
     {
         auto sub = pos / SUBDIR_SIZE;
         auto seg = pos % SUBDIR_SIZE;
+        EmulateRead(&meta.subdirectories[sub], sizeof(SubDirectoryPtr));
+        EmulateRead(&meta.subdirectories[sub]->segments[seg], sizeof(SegmentPtr));
         return meta.subdirectories[sub]->segments[seg];
     }
 
@@ -43,6 +69,26 @@ namespace Dalea
         return GetSegment(hv.SegmentBits(depth));
     }
 
+    Segment *Directory::GetShadowSegment(uint64_t pos) const noexcept
+    {
+        return GetShadow(pos)->segment;
+    }
+
+    Segment *Directory::GetShadowSegment(const HashValue &hv, uint64_t depth) const noexcept
+    {
+        return GetShadowSegment(hv.SegmentBits(depth));
+    }
+
+    ShadowSegment *Directory::GetShadow(uint64_t pos) const noexcept
+    {
+        return shadow.load(std::memory_order_acquire)->segments[pos].load(std::memory_order_acquire);
+    }
+
+    ShadowSegment *Directory::GetShadow(const HashValue &hv, uint64_t depth) const noexcept
+    {
+        return GetShadow(hv.SegmentBits(depth));
+    }
+
     const SegmentPtr Directory::LockSegment(uint64_t pos) noexcept
     {
         auto sub = pos / SUBDIR_SIZE;
@@ -103,11 +149,12 @@ namespace Dalea
         auto seg = pos % SUBDIR_SIZE;
         if (meta.subdirectories[sub] == nullptr)
         {
-            TX::run(pop, [&]() {
-                meta.subdirectories[sub] = pobj::make_persistent<SubDirectory>(pop);
+            Backend::Run(pop, [&]() {
+                meta.subdirectories[sub] = Backend::Make<SubDirectory>(pop);
             });
         }
         meta.subdirectories[sub]->segments[seg] = ptr;
+        update_shadow(pos, ptr);
         return true;
     }
 
@@ -116,9 +163,22 @@ namespace Dalea
         auto sub = pos / SUBDIR_SIZE;
         auto seg = pos % SUBDIR_SIZE;
         meta.subdirectories[sub]->segments[seg] = ptr;
+        update_shadow(pos, ptr);
         return true;
     }
 
+    void Directory::Persist(PoolBase &pop, uint64_t begin, uint64_t end) const noexcept
+    {
+        while (begin < end)
+        {
+            auto sub = begin / SUBDIR_SIZE;
+            auto seg = begin % SUBDIR_SIZE;
+            auto len = std::min<uint64_t>(end - begin, SUBDIR_SIZE - seg);
+            Dalea::Persist(pop, meta.subdirectories[sub]->segments.cdata() + seg, len * sizeof(SegmentPtr));
+            begin += len;
+        }
+    }
+
     bool Directory::Probe(uint64_t pos) const noexcept
     {
         auto sub = pos / SUBDIR_SIZE;
@@ -140,8 +200,8 @@ namespace Dalea
             auto sub = i / SUBDIR_SIZE;
             if (meta.subdirectories[sub] == nullptr)
             {
-                TX::run(pop, [&]() {
-                    meta.subdirectories[sub] = pobj::make_persistent<SubDirectory>(pop);
+                Backend::Run(pop, [&]() {
+                    meta.subdirectories[sub] = Backend::Make<SubDirectory>(pop);
                 });
             }
         }
@@ -156,5 +216,72 @@ namespace Dalea
             auto seg = i % SUBDIR_SIZE;
             meta.subdirectories[sub]->segments[seg] = meta.subdirectories[buddy_sub]->segments[buddy_seg];
         }
+
+        /*
+         * publish a larger mirror only after PM is linked; the caller bumps global depth after
+         * this returns, so no reader can index past the capacity it observes
+         */
+        auto old = shadow.load(std::memory_order_acquire);
+        if (old->capacity >= end)
+        {
+            for (auto i = start; i < end; i++)
+            {
+                old->segments[i].store(old->segments[i - start].load(std::memory_order_relaxed), std::memory_order_release);
+            }
+            return;
+        }
+
+        auto fresh = new ShadowDirectory(end);
+        for (uint64_t i = 0; i < start; i++)
+        {
+            fresh->segments[i].store(old->segments[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        for (auto i = start; i < end; i++)
+        {
+            fresh->segments[i].store(fresh->segments[i - start].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        fresh->retired = old;
+        shadow.store(fresh, std::memory_order_release);
+    }
+
+    void Directory::RebuildShadow(uint64_t depth) noexcept
+    {
+        auto cap = (1UL << depth);
+        auto fresh = new ShadowDirectory(cap);
+        for (uint64_t i = 0; i < cap; i++)
+        {
+            if (Probe(i))
+            {
+                fresh->segments[i].store(GetSegment(i)->shadow, std::memory_order_relaxed);
+            }
+        }
+        // lock-free readers may still hold the old mirror, as after a doubling
+        fresh->retired = shadow.load(std::memory_order_acquire);
+        shadow.store(fresh, std::memory_order_release);
+    }
+
+    void Directory::Recover(uint64_t depth) noexcept
+    {
+#ifndef PLOCK
+        for (int i = 0; i < METADIR_SIZE; i++)
+        {
+            if (meta.subdirectories[i] != nullptr)
+            {
+                meta.subdirectories[i]->mutexes = new std::shared_mutex[SUBDIR_SIZE];
+            }
+        }
+#endif
+        // the mirror of the previous run went away with its process, there is nothing to free or chain
+        shadow = nullptr;
+        RebuildShadow(depth);
+    }
+
+    void Directory::update_shadow(uint64_t pos, const SegmentPtr &ptr) noexcept
+    {
+        auto current = shadow.load(std::memory_order_acquire);
+        if (pos < current->capacity)
+        {
+            current->segments[pos].store(ptr->shadow, std::memory_order_release);
+        }
     }
 } // namespace Dalea
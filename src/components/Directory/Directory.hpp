@@ -1,9 +1,9 @@
 #ifndef __DALEA__DIRECTORY__DIRECTORY__
 #define __DALEA__DIRECTORY__DIRECTORY__
-#include <libpmemobj++/container/array.hpp>
-
 #include "Segment/Segment.hpp"
 
+#include <atomic>
+
 namespace Dalea
 {
     struct Directory
@@ -17,15 +17,15 @@ namespace Dalea
             SubDirectory(const SubDirectory &) = delete;
             SubDirectory(SubDirectory &&) = delete;
 
-            pobj::array<SegmentPtr, SUBDIR_SIZE> segments;
+            Backend::Array<SegmentPtr, SUBDIR_SIZE> segments;
 #ifdef PLOCK
-            pobj::array<pobj::shared_mutex, SUBDIR_SIZE> mutexes;
+            Backend::Array<Backend::SharedMutex, SUBDIR_SIZE> mutexes;
 #else
             std::shared_mutex *mutexes;
 #endif
         };
 
-        using SubDirectoryPtr = pobj::persistent_ptr<SubDirectory>;
+        using SubDirectoryPtr = Backend::Ptr<SubDirectory>;
         struct MetaDirectory
         {
             MetaDirectory(PoolBase &pop);
@@ -34,11 +34,29 @@ namespace Dalea
             MetaDirectory(const SubDirectory &) = delete;
             MetaDirectory(SubDirectory &&) = delete;
 
-            pobj::array<SubDirectoryPtr, METADIR_SIZE> subdirectories;
+            Backend::Array<SubDirectoryPtr, METADIR_SIZE> subdirectories;
+        };
+
+        /*
+         * volatile mirror of the persistent directory: one ShadowSegment pointer per slot, so
+         * a lookup costs DRAM loads instead of two persistent_ptr dereferences in PM.
+         * A doubling or a rebuild publishes a new array; old arrays are chained in retired
+         * since lock-free readers may still hold them
+         */
+        struct ShadowDirectory
+        {
+            ShadowDirectory(uint64_t cap);
+            ~ShadowDirectory();
+            ShadowDirectory(const ShadowDirectory &) = delete;
+            ShadowDirectory(ShadowDirectory &&) = delete;
+
+            uint64_t capacity;
+            std::atomic<ShadowSegment *> *segments;
+            ShadowDirectory *retired;
         };
 
     public:
-        Directory(PoolBase &pop) : meta(pop){};
+        Directory(PoolBase &pop);
 
         Directory() = delete;
         Directory(const SubDirectory &) = delete;
@@ -46,6 +64,11 @@ namespace Dalea
 
         const SegmentPtr &GetSegment(uint64_t pos) const noexcept;
         const SegmentPtr &GetSegment(const HashValue &hv, uint64_t depth) const noexcept;
+        Segment *GetShadowSegment(uint64_t pos) const noexcept;
+        Segment *GetShadowSegment(const HashValue &hv, uint64_t depth) const noexcept;
+        // segment number and side array of the slot along with its segment, for lookups
+        ShadowSegment *GetShadow(uint64_t pos) const noexcept;
+        ShadowSegment *GetShadow(const HashValue &hv, uint64_t depth) const noexcept;
 
         const SegmentPtr LockSegment(uint64_t pos) noexcept;
         const SegmentPtr LockSegment(const HashValue &hv, uint64_t depth) noexcept;
@@ -58,11 +81,22 @@ namespace Dalea
 
         bool AddSegment(PoolBase &pop, const SegmentPtr &ptr, uint64_t pos) noexcept;
         bool SetSegment(PoolBase &pop, const SegmentPtr &ptr, uint64_t pos) noexcept;
+        // flush slots [begin, end), one range per subdirectory
+        void Persist(PoolBase &pop, uint64_t begin, uint64_t end) const noexcept;
         bool Probe(uint64_t pos) const noexcept;
         bool Probe(const HashValue &hv) const noexcept;
         void DoublingLink(PoolBase &pop, uint64_t prev_depth, uint64_t new_depth) noexcept;
+        // re-mirror slots [0, 2^depth) from PM, e.g., after the pool is opened again and its segments recovered
+        void RebuildShadow(uint64_t depth) noexcept;
+        // new subdirectory locks and shadow after the pool is opened again, segments are recovered before
+        void Recover(uint64_t depth) noexcept;
 
         MetaDirectory meta;
+
+    private:
+        void update_shadow(uint64_t pos, const SegmentPtr &ptr) noexcept;
+
+        std::atomic<ShadowDirectory *> shadow;
     };
 } // namespace Dalea
 #endif
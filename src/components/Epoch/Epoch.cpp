@@ -0,0 +1,39 @@
+#include "Epoch.hpp"
+namespace Dalea
+{
+    std::atomic<uint64_t> Epoch::global(1);
+    std::mutex Epoch::lock;
+    std::vector<Epoch::Slot *> Epoch::slots;
+
+    uint64_t Epoch::Advance() noexcept
+    {
+        return global.fetch_add(1);
+    }
+
+    bool Epoch::Safe(uint64_t epoch) noexcept
+    {
+        // pairs with the fence of Enter: a thread missed here sees what was unlinked
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::lock_guard<std::mutex> _(lock);
+        for (const auto s : slots)
+        {
+            auto e = s->epoch.load(std::memory_order_acquire);
+            if (e != 0 && e <= epoch)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // slots outlive their threads, one that finished is outside for good
+    Epoch::Slot *Epoch::attach() noexcept
+    {
+        local = new Slot();
+        local->epoch.store(0, std::memory_order_relaxed);
+        local->nesting = 0;
+        std::lock_guard<std::mutex> _(lock);
+        slots.push_back(local);
+        return local;
+    }
+} // namespace Dalea
@@ -0,0 +1,76 @@
+#ifndef __DALEA__EPOCH__EPOCH__
+#define __DALEA__EPOCH__EPOCH__
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+namespace Dalea
+{
+    /*
+     * process-wide epochs telling when memory unlinked from the table can be reused: every
+     * thread announces the global epoch in a cache line padded slot of its own while it may
+     * hold pointers into the table, so entering and leaving cost no shared write
+     *
+     * whoever unlinks something calls Advance afterwards and keeps the epoch it returns with
+     * it; once Safe holds for that epoch, no thread can reach it any more
+     */
+    class Epoch
+    {
+    public:
+        // enters for the lifetime of the guard, nesting is allowed
+        struct Guard
+        {
+            Guard() noexcept
+            {
+                Enter();
+            }
+            ~Guard()
+            {
+                Leave();
+            }
+            Guard(const Guard &) = delete;
+            Guard &operator=(const Guard &) = delete;
+        };
+
+        static void Enter() noexcept
+        {
+            auto s = local ? local : attach();
+            if (s->nesting++ == 0)
+            {
+                s->epoch.store(global.load(std::memory_order_acquire), std::memory_order_relaxed);
+                // the announcement is visible before any pointer of the table is loaded
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+            }
+        }
+
+        static void Leave() noexcept
+        {
+            if (--local->nesting == 0)
+            {
+                local->epoch.store(0, std::memory_order_release);
+            }
+        }
+
+        // the epoch of everything unlinked before the call
+        static uint64_t Advance() noexcept;
+        // no thread entered at or before epoch is still inside
+        static bool Safe(uint64_t epoch) noexcept;
+
+    private:
+        struct alignas(64) Slot
+        {
+            // 0 while outside
+            std::atomic<uint64_t> epoch;
+            // written by the owner only
+            uint64_t nesting;
+        };
+
+        static std::atomic<uint64_t> global;
+        static inline thread_local Slot *local = nullptr;
+        static std::mutex lock;
+        static std::vector<Slot *> slots;
+
+        static Slot *attach() noexcept;
+    };
+} // namespace Dalea
+#endif
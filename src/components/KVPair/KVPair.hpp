@@ -2,18 +2,96 @@
 #define __DALEA__KVPAIR__KVPAIR__
 
 #include "Common/Common.hpp"
+
+#include <string_view>
 namespace Dalea
 {
+    /*
+     * header of a record in a slab, key and value bytes follow inline. Records are made and
+     * freed by SlabAllocator only, state tells an allocated one from a free slot after a crash
+     *
+     * a large value may live in a ValueLog instead, then a ValueRef precedes the key and
+     * value_size carries LOGGED. A counter is an int64 preceding the key, 8-byte aligned so
+     * that it can be updated in place, and value_size carries COUNTER
+     */
     struct KVPair
     {
-        PString key;
-        PString value;
+        static constexpr uint32_t ALLOCATED = 0x4b565052;
+        static constexpr uint32_t LOGGED = 1U << 31;
+        static constexpr uint32_t COUNTER = 1U << 30;
+
+        // where a logged value starts and the chunk of the log holding it
+        struct ValueRef
+        {
+            Backend::Ptr<char> value;
+            uint32_t chunk;
+        };
+
+        uint32_t slab;
+        uint32_t state;
+        uint32_t key_size;
+        uint32_t value_size;
+
+        KVPair() = delete;
+        KVPair(const KVPair &) = delete;
+        KVPair &operator=(const KVPair &) = delete;
+
+        const char *data() const noexcept
+        {
+            return reinterpret_cast<const char *>(this + 1);
+        }
+
+        bool Logged() const noexcept
+        {
+            return (value_size & LOGGED) != 0;
+        }
+
+        const ValueRef &Ref() const noexcept
+        {
+            return *reinterpret_cast<const ValueRef *>(data());
+        }
+
+        bool IsCounter() const noexcept
+        {
+            return (value_size & COUNTER) != 0;
+        }
+
+        int64_t Counter() const noexcept
+        {
+            return __atomic_load_n(reinterpret_cast<const int64_t *>(data()), __ATOMIC_ACQUIRE);
+        }
+
+        // readers without the bucket lock see either value, the caller persists
+        void SetCounter(int64_t v) noexcept
+        {
+            __atomic_store_n(reinterpret_cast<int64_t *>(this + 1), v, __ATOMIC_RELEASE);
+        }
+
+        uint32_t ValueSize() const noexcept
+        {
+            return value_size & ~(LOGGED | COUNTER);
+        }
+
+        std::string_view Key() const noexcept
+        {
+            return std::string_view(data() + (Logged() ? sizeof(ValueRef) : IsCounter() ? sizeof(int64_t) : 0), key_size);
+        }
 
-        KVPair(const String &k, const String &v) : key(k), value(v){};
-        KVPair(const PString &k, const PString &v) : key(k), value(v){};
-        KVPair(PString &&k, PString &&v) : key(std::move(k)), value(std::move(v)){};
+        // the raw bytes of a counter
+        std::string_view Value() const noexcept
+        {
+            if (Logged())
+            {
+                return std::string_view(Ref().value.get(), ValueSize());
+            }
+            if (IsCounter())
+            {
+                return std::string_view(data(), sizeof(int64_t));
+            }
+            return std::string_view(data() + key_size, value_size);
+        }
     };
 
-    using KVPairPtr = pmem::obj::persistent_ptr<KVPair>;
+    using KVPairPtr = Backend::Ptr<KVPair>;
 } // namespace Dalea
 #endif
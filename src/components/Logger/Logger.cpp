@@ -1,26 +1,341 @@
 #include "Logger.hpp"
+
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
 #include <thread>
+#include <vector>
 
 namespace Dalea
 {
+    using namespace std::chrono_literals;
+
+    /*
+     * names and argument names of the events, indexed by LogEvent; Text and TextPart carry
+     * up to sizeof(LogRecord::args) bytes of a message, every part but the last is TextPart
+     */
+    static const struct
+    {
+        const char *name;
+        const char *args[LOG_ARGS];
+    } EVENTS[] = {
+        {"text", {}},
+        {"text", {}},
+        {"dropped", {"records"}},
+        {"put", {"hash", "segment", "bucket", "global_depth", "bucket_depth"}},
+        {"put redirected", {"hash", "segment", "bucket", "global_depth"}},
+        {"put retry", {"hash", "segment", "bucket"}},
+        {"put split", {"hash", "segment", "bucket"}},
+        {"put done", {"hash", "segment", "bucket", "status"}},
+        {"get", {"hash", "segment", "bucket"}},
+        {"get redirected", {"hash", "segment", "bucket"}},
+        {"bucket ancestor", {"hash", "ancestor", "segment", "bucket"}},
+        {"bucket put done", {"hash", "slot"}},
+    };
+    constexpr size_t TEXT_BYTES = sizeof(LogRecord::args);
+
+    // single producer, the owning thread, and single consumer, the writer
+    struct Logger::Ring
+    {
+        static constexpr uint64_t CAPACITY = 1 << 14;
+
+        Ring(uint32_t t) : thread(t), head(0), tail(0), dropped(0){};
+
+        uint32_t thread;
+        alignas(64) std::atomic<uint64_t> head;
+        alignas(64) std::atomic<uint64_t> tail;
+        // records lost while full, only touched by the owner
+        uint64_t dropped;
+        LogRecord records[CAPACITY];
+    };
+
+    static std::atomic<uint64_t> next_sink_id(1);
+
+    struct Logger::Sink
+    {
+        Sink(const std::string &log_file) : out_file(log_file, std::ios::binary | std::ios::trunc), stop(false), id(next_sink_id++)
+        {
+            out_file.write(LOG_MAGIC, sizeof(LOG_MAGIC));
+        }
+
+        std::ofstream out_file;
+        // guards rings and starting the writer
+        std::mutex lock;
+        // serializes draining between the writer and Flush
+        std::mutex drain_lock;
+        std::vector<std::unique_ptr<Ring>> rings;
+        std::thread writer;
+        std::atomic_bool stop;
+        uint64_t id;
+
+        Ring *add_ring()
+        {
+            std::unique_lock l(lock);
+            rings.push_back(std::make_unique<Ring>(rings.size()));
+            if (!writer.joinable())
+            {
+                writer = std::thread([this]() {
+                    while (!stop)
+                    {
+                        if (!drain())
+                        {
+                            std::this_thread::sleep_for(1ms);
+                        }
+                    }
+                });
+            }
+            return rings.back().get();
+        }
+
+        // false if no ring had anything to write
+        bool drain()
+        {
+            std::unique_lock d(drain_lock);
+            std::vector<Ring *> snapshot;
+            {
+                std::unique_lock l(lock);
+                for (auto &r : rings)
+                {
+                    snapshot.push_back(r.get());
+                }
+            }
+
+            bool written = false;
+            for (auto r : snapshot)
+            {
+                auto tail = r->tail.load(std::memory_order_relaxed);
+                auto head = r->head.load(std::memory_order_acquire);
+                while (tail != head)
+                {
+                    auto begin = tail % Ring::CAPACITY;
+                    auto num = std::min(head - tail, Ring::CAPACITY - begin);
+                    out_file.write(reinterpret_cast<const char *>(r->records + begin), num * sizeof(LogRecord));
+                    tail += num;
+                    written = true;
+                }
+                r->tail.store(tail, std::memory_order_release);
+            }
+            if (written)
+            {
+                out_file.flush();
+            }
+            return written;
+        }
+
+        void shutdown()
+        {
+            stop = true;
+            if (writer.joinable())
+            {
+                writer.join();
+            }
+            drain();
+        }
+    };
+
+    /*
+     * sinks still open at exit are drained then, e.g. those of tables in a pool, which are
+     * never destroyed
+     */
+    struct LoggerRegistry
+    {
+        std::mutex lock;
+        std::vector<Logger::Sink *> sinks;
+
+        ~LoggerRegistry()
+        {
+            std::unique_lock l(lock);
+            for (auto s : sinks)
+            {
+                s->shutdown();
+            }
+        }
+
+        static LoggerRegistry &Instance()
+        {
+            static LoggerRegistry registry;
+            return registry;
+        }
+    };
+
+    // rings of the calling thread by sink id, ids are never reused
+    static thread_local std::vector<std::pair<uint64_t, void *>> thread_rings;
+
+    Logger::Logger(const std::string &log_file) : sink(new Sink(log_file))
+    {
+        auto &registry = LoggerRegistry::Instance();
+        std::unique_lock l(registry.lock);
+        registry.sinks.push_back(sink);
+    }
+
+    Logger::Logger(std::string &&log_file) : Logger(log_file)
+    {
+    }
+
+    Logger::~Logger()
+    {
+        {
+            auto &registry = LoggerRegistry::Instance();
+            std::unique_lock l(registry.lock);
+            registry.sinks.erase(std::remove(registry.sinks.begin(), registry.sinks.end(), sink), registry.sinks.end());
+        }
+        sink->shutdown();
+        delete sink;
+    }
+
     void Logger::Write(const std::string &msg)
     {
-        std::unique_lock l(lock);
-        auto now = std::chrono::high_resolution_clock::now();
-        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch());
-        out_file << ns.count() << " by " << std::this_thread::get_id() << ": ";
-        out_file << msg;
-        out_file.flush();
+        uint64_t chunk[LOG_ARGS];
+        size_t offset = 0;
+        do
+        {
+            auto len = std::min(TEXT_BYTES, msg.size() - offset);
+            memcpy(chunk, msg.data() + offset, len);
+            offset += len;
+            push(offset < msg.size() ? LogEvent::TextPart : LogEvent::Text, len, chunk);
+        } while (offset < msg.size());
     }
 
     void Logger::Write(std::string &&msg)
     {
-        std::unique_lock l(lock);
-        auto now = std::chrono::high_resolution_clock::now();
-        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch());
-        out_file << ns.count() << " by " << std::this_thread::get_id() << ": ";
-        out_file << msg;
-        out_file.flush();
+        Write(static_cast<const std::string &>(msg));
+    }
+
+    void Logger::Flush()
+    {
+        sink->drain();
+    }
+
+    Logger::Ring *Logger::ring() noexcept
+    {
+        auto key = sink->id;
+        for (const auto &r : thread_rings)
+        {
+            if (r.first == key)
+            {
+                return static_cast<Ring *>(r.second);
+            }
+        }
+        auto r = sink->add_ring();
+        thread_rings.emplace_back(key, r);
+        return r;
+    }
+
+    void Logger::push(LogEvent event, uint16_t length, const uint64_t *values) noexcept
+    {
+        auto r = ring();
+        auto head = r->head.load(std::memory_order_relaxed);
+        auto free = Ring::CAPACITY - (head - r->tail.load(std::memory_order_acquire));
+        if (free < (r->dropped ? 2 : 1))
+        {
+            ++r->dropped;
+            return;
+        }
+
+        auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        if (r->dropped)
+        {
+            auto &rec = r->records[head++ % Ring::CAPACITY];
+            rec.time = now;
+            rec.thread = r->thread;
+            rec.event = uint16_t(LogEvent::Dropped);
+            rec.length = 1;
+            rec.args[0] = r->dropped;
+            r->dropped = 0;
+        }
+        auto &rec = r->records[head++ % Ring::CAPACITY];
+        rec.time = now;
+        rec.thread = r->thread;
+        rec.event = uint16_t(event);
+        rec.length = length;
+        memcpy(rec.args, values, sizeof(rec.args));
+        r->head.store(head, std::memory_order_release);
+    }
+
+    /*
+     * one line per event, ordered by time: "<ns> by <thread>: <event> name=value ...".
+     * Parts of a text are joined per thread first, hash values are printed in hex
+     */
+    bool Logger::Decode(const std::string &log_file, std::ostream &out)
+    {
+        std::ifstream in(log_file, std::ios::binary);
+        char magic[sizeof(LOG_MAGIC)];
+        if (!in.read(magic, sizeof(magic)) || memcmp(magic, LOG_MAGIC, sizeof(magic)) != 0)
+        {
+            std::cout << log_file << " is not a binary log\n";
+            return false;
+        }
+
+        struct Line
+        {
+            uint64_t time;
+            uint32_t thread;
+            std::string text;
+        };
+        std::vector<Line> lines;
+        // text parts waiting for their last part, by thread
+        std::map<uint32_t, Line> pending;
+        LogRecord rec;
+        while (in.read(reinterpret_cast<char *>(&rec), sizeof(rec)))
+        {
+            if (rec.event >= sizeof(EVENTS) / sizeof(EVENTS[0]))
+            {
+                std::cout << "unknown event " << rec.event << " in " << log_file << "\n";
+                return false;
+            }
+            auto event = static_cast<LogEvent>(rec.event);
+            if (event == LogEvent::Text || event == LogEvent::TextPart)
+            {
+                auto &line = pending.try_emplace(rec.thread, Line{rec.time, rec.thread, ""}).first->second;
+                line.text.append(reinterpret_cast<const char *>(rec.args), std::min<size_t>(rec.length, TEXT_BYTES));
+                if (event == LogEvent::Text)
+                {
+                    // free-form messages bring their own line breaks
+                    if (!line.text.empty() && line.text.back() == '\n')
+                    {
+                        line.text.pop_back();
+                    }
+                    lines.push_back(std::move(line));
+                    pending.erase(rec.thread);
+                }
+                continue;
+            }
+
+            std::stringstream buf;
+            buf << EVENTS[rec.event].name;
+            for (int i = 0; i < std::min<int>(rec.length, LOG_ARGS); i++)
+            {
+                auto name = EVENTS[rec.event].args[i];
+                buf << " " << (name ? name : "arg") << "=";
+                if (name && strcmp(name, "hash") == 0)
+                {
+                    buf << std::hex << rec.args[i] << std::dec;
+                }
+                else
+                {
+                    buf << rec.args[i];
+                }
+            }
+            lines.push_back(Line{rec.time, rec.thread, buf.str()});
+        }
+        for (auto &p : pending)
+        {
+            lines.push_back(std::move(p.second));
+        }
+
+        std::stable_sort(lines.begin(), lines.end(), [](const Line &a, const Line &b) {
+            return a.time < b.time;
+        });
+        for (const auto &line : lines)
+        {
+            out << line.time << " by " << line.thread << ": " << line.text << "\n";
+        }
+        return true;
     }
-}
+} // namespace Dalea
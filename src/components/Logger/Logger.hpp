@@ -1,26 +1,84 @@
 #ifndef __DALEA__LOGGER__LOGGER__
 #define __DALEA__LOGGER__LOGGER__
-#include <fstream>
+#include <cstdint>
 #include <iostream>
-#include <mutex>
+#include <string>
 namespace Dalea
 {
+    // argument layout of each event is listed in Logger.cpp, next to its decoder
+    enum class LogEvent : uint16_t
+    {
+        Text,
+        TextPart,
+        Dropped,
+        PutFirst,
+        PutRedirect,
+        PutRetry,
+        PutSplit,
+        PutDone,
+        GetSearch,
+        GetRedirect,
+        BucketAncestor,
+        BucketPutDone,
+    };
+
+    constexpr int LOG_ARGS = 6;
+    constexpr char LOG_MAGIC[8] = {'D', 'A', 'L', 'E', 'A', 'L', 'G', '1'};
+
+    // one cache line, written to the log file as is after LOG_MAGIC
+    struct LogRecord
+    {
+        uint64_t time;
+        uint32_t thread;
+        uint16_t event;
+        // number of args, or of text bytes for Text and TextPart
+        uint16_t length;
+        uint64_t args[LOG_ARGS];
+    };
+
+    struct LoggerRegistry;
+
     /*
      * a logger for serialized output for my programs to simplify debugging, not for recovery
+     *
+     * every thread appends binary records to a ring of its own without locks, a background
+     * writer drains all rings into the file. A full ring drops records instead of blocking,
+     * the number lost is logged once there is space again. Decode turns a file into text
      */
     class Logger
     {
     public:
-        Logger(const std::string &log_file) : out_file(log_file) {}
-        Logger(std::string &&log_file) : out_file(log_file) {}
-        ~Logger() = default;
+        Logger(const std::string &log_file);
+        Logger(std::string &&log_file);
+        ~Logger();
 
+        // free-form text, split into records of LOG_ARGS words; not meant for hot paths
         void Write(const std::string &msg);
         void Write(std::string &&msg);
 
+        template <typename... Args>
+        void Record(LogEvent event, Args... args) noexcept
+        {
+            static_assert(sizeof...(Args) <= LOG_ARGS, "too many log arguments");
+            uint64_t values[LOG_ARGS] = {uint64_t(args)...};
+            push(event, sizeof...(Args), values);
+        }
+
+        // blocks until everything recorded so far is in the file
+        void Flush();
+
+        static bool Decode(const std::string &log_file, std::ostream &out);
+
     private:
-        std::ofstream out_file;
-        std::mutex lock;
+        friend struct LoggerRegistry;
+        struct Ring;
+        // rings, file and writer live on the heap, a Logger may sit inside a pool
+        struct Sink;
+
+        Sink *sink;
+
+        Ring *ring() noexcept;
+        void push(LogEvent event, uint16_t length, const uint64_t *values) noexcept;
     };
 } // namespace Dalea
 #endif
@@ -0,0 +1,80 @@
+#include "Metrics.hpp"
+namespace Dalea
+{
+    static const char *METRIC_NAMES[] = {
+        "get hits", "get misses", "put inserts", "put updates", "put failures", "remove hits",
+        "remove misses", "retries on doubling", "retries on locked buckets", "retries on stale buckets",
+        "retries after splits", "retries on scans", "lock failures", "ancestor redirects",
+        "segment pool hits", "segment pool misses", "cache hits", "cache misses", "counter updates",
+        "counter conflicts", "logged values", "queued splits", "served splits", "overflow full",
+        "allocations",
+        "flushes"};
+    static_assert(sizeof(METRIC_NAMES) / sizeof(METRIC_NAMES[0]) == METRIC_KINDS);
+
+    std::mutex Metrics::lock;
+    std::vector<Metrics::Slot *> Metrics::slots;
+
+    MetricsSnapshot &MetricsSnapshot::operator+=(const MetricsSnapshot &rhs) noexcept
+    {
+        for (int i = 0; i < METRIC_KINDS; i++)
+        {
+            values[i] += rhs.values[i];
+        }
+        return *this;
+    }
+
+    MetricsSnapshot MetricsSnapshot::operator-(const MetricsSnapshot &rhs) const noexcept
+    {
+        MetricsSnapshot diff;
+        for (int i = 0; i < METRIC_KINDS; i++)
+        {
+            diff.values[i] = values[i] - rhs.values[i];
+        }
+        return diff;
+    }
+
+    void MetricsSnapshot::Show(std::ostream &out) const
+    {
+        for (int i = 0; i < METRIC_KINDS; i++)
+        {
+            out << (i ? ", " : "") << METRIC_NAMES[i] << ": " << values[i];
+        }
+        out << "\n";
+    }
+
+    MetricsSnapshot Metrics::Aggregate() noexcept
+    {
+        MetricsSnapshot total;
+        for (const auto &s : PerThread())
+        {
+            total += s;
+        }
+        return total;
+    }
+
+    std::vector<MetricsSnapshot> Metrics::PerThread() noexcept
+    {
+        std::lock_guard<std::mutex> _(lock);
+        std::vector<MetricsSnapshot> snapshots(slots.size());
+        for (size_t i = 0; i < slots.size(); i++)
+        {
+            for (int j = 0; j < METRIC_KINDS; j++)
+            {
+                snapshots[i].values[j] = slots[i]->counters[j].load(std::memory_order_relaxed);
+            }
+        }
+        return snapshots;
+    }
+
+    Metrics::Slot *Metrics::attach() noexcept
+    {
+        local = new Slot();
+        for (auto &c : local->counters)
+        {
+            c.store(0, std::memory_order_relaxed);
+        }
+        std::lock_guard<std::mutex> _(lock);
+        slots.push_back(local);
+        return local;
+    }
+} // namespace Dalea
@@ -0,0 +1,101 @@
+#ifndef __DALEA__METRICS__METRICS__
+#define __DALEA__METRICS__METRICS__
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <vector>
+namespace Dalea
+{
+    enum class Metric
+    {
+        // operations by type and outcome
+        GetHits,
+        GetMisses,
+        PutInserts,
+        PutUpdates,
+        PutFailures,
+        RemoveHits,
+        RemoveMisses,
+        // Put and Remove retries by cause
+        RetryDoubling,
+        RetryLocked,
+        RetryStale,
+        RetrySplit,
+        RetryScan,
+        // bucket and doubling try-locks that failed
+        LockFailures,
+        // operations whose bucket redirected them to an ancestor, counted once each
+        AncestorRedirects,
+        SegmentPoolHits,
+        SegmentPoolMisses,
+        // lookups answered by the read cache and those passed on to the table
+        CacheHits,
+        CacheMisses,
+        // counters changed in place, and compare-exchanges that found another value
+        CounterUpdates,
+        CounterConflicts,
+        // values written to a value log, by inserts, updates and relocation
+        LoggedValues,
+        // inserts into full buckets parked in the overflow area, the requests background split
+        // workers took up, and inserts that split in place since the area was full; queued
+        // minus served is the depth of the split queue
+        SplitsQueued,
+        SplitsServed,
+        OverflowFull,
+        // Backend::Make calls
+        Allocations,
+        // Persist calls
+        Flushes,
+    };
+
+    constexpr int METRIC_KINDS = static_cast<int>(Metric::Flushes) + 1;
+
+    // counters summed over threads at one point in time, differences cover an interval
+    struct MetricsSnapshot
+    {
+        uint64_t values[METRIC_KINDS] = {};
+
+        uint64_t operator[](Metric m) const noexcept
+        {
+            return values[static_cast<int>(m)];
+        }
+
+        MetricsSnapshot &operator+=(const MetricsSnapshot &rhs) noexcept;
+        MetricsSnapshot operator-(const MetricsSnapshot &rhs) const noexcept;
+        void Show(std::ostream &out) const;
+    };
+
+    /*
+     * process-wide event counters, every thread counts into a cache line padded slot of its
+     * own on first use, so counting is a plain load and store without sharing. Slots outlive
+     * their threads, so counts of finished threads stay in the sums
+     */
+    class Metrics
+    {
+    public:
+        static void Add(Metric m, uint64_t n = 1) noexcept
+        {
+            auto s = local ? local : attach();
+            auto &c = s->counters[static_cast<int>(m)];
+            c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+
+        static MetricsSnapshot Aggregate() noexcept;
+        // one snapshot per thread that has counted anything, in order of first use
+        static std::vector<MetricsSnapshot> PerThread() noexcept;
+
+    private:
+        struct alignas(64) Slot
+        {
+            std::atomic<uint64_t> counters[METRIC_KINDS];
+        };
+
+        static inline thread_local Slot *local = nullptr;
+        static std::mutex lock;
+        static std::vector<Slot *> slots;
+
+        static Slot *attach() noexcept;
+    };
+} // namespace Dalea
+#endif
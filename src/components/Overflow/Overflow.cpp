@@ -0,0 +1,228 @@
+#include "Overflow.hpp"
+namespace Dalea
+{
+    OverflowArea::OverflowArea(PoolBase &pop, OverflowSlots &s) : slots(s), used(0), peak(0)
+    {
+        for (auto &f : filter)
+        {
+            f.store(0, std::memory_order_relaxed);
+        }
+        if (slots == nullptr)
+        {
+            Backend::Run(pop, [&]() {
+                slots = Backend::Make<KVPairPtr[]>(STASH_LIMIT);
+            });
+        }
+        for (int i = 0; i < STASH_LIMIT; i++)
+        {
+            hashes[i] = 0;
+            if (slots[i] != nullptr)
+            {
+                // same value as std::hash<std::string> on equal characters
+                auto hash = HashValue(std::hash<std::string_view>{}(slots[i]->Key())).GetRaw();
+                hashes[i] = hash;
+                count(hash, 1);
+                ++used;
+                enqueue(i, hash);
+            }
+        }
+    }
+
+    uint64_t OverflowArea::Used() const noexcept
+    {
+        return used.load(std::memory_order_acquire);
+    }
+
+    bool OverflowArea::Get(const String &key, const HashValue &hash_value, KVPairPtr &ret) const noexcept
+    {
+        // most keys were never parked, those skip the lock
+        if (!may_hold(hash_value.GetRaw()))
+        {
+            return false;
+        }
+        std::shared_lock _(lock);
+        auto slot = find(key, hash_value);
+        if (slot == -1)
+        {
+            return false;
+        }
+        ret = slots[slot];
+        return true;
+    }
+
+    int OverflowArea::Find(const String &key, const HashValue &hash_value) const noexcept
+    {
+        // the slot of key changes under the lock of its bucket only, which the caller holds
+        return find(key, hash_value);
+    }
+
+    int OverflowArea::find(const String &key, const HashValue &hash_value) const noexcept
+    {
+        if (!may_hold(hash_value.GetRaw()))
+        {
+            return -1;
+        }
+        for (int i = 0; i < STASH_LIMIT; i++)
+        {
+            if (hashes[i].load(std::memory_order_acquire) == hash_value.GetRaw() && slots[i] != nullptr && slots[i]->Key() == key)
+            {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    bool OverflowArea::Insert(PoolBase &pop, SlabAllocator &slab, const String &key, const String &value, const HashValue &hash_value) noexcept
+    {
+        std::unique_lock _(lock);
+        for (int i = 0; i < STASH_LIMIT; i++)
+        {
+            if (slots[i] == nullptr)
+            {
+                // set before the slot, a reader seeing the hash waits for the lock
+                count(hash_value.GetRaw(), 1);
+                hashes[i].store(hash_value.GetRaw(), std::memory_order_release);
+                slots[i] = slab.Make(pop, key, value);
+                Persist(pop, &slots[i], sizeof(KVPairPtr));
+                ++used;
+                enqueue(i, hash_value.GetRaw());
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void OverflowArea::Replace(PoolBase &pop, SlabAllocator &slab, int slot, const String &key, const String &value) noexcept
+    {
+        std::unique_lock _(lock);
+        KVPairPtr old = slots[slot];
+        slots[slot] = slab.Make(pop, key, value);
+        Persist(pop, &slots[slot], sizeof(KVPairPtr));
+        slab.Free(pop, old);
+    }
+
+    void OverflowArea::Remove(PoolBase &pop, SlabAllocator &slab, int slot) noexcept
+    {
+        std::unique_lock _(lock);
+        KVPairPtr victim = slots[slot];
+        slots[slot] = nullptr;
+        Persist(pop, &slots[slot], sizeof(KVPairPtr));
+        count(hashes[slot].load(std::memory_order_relaxed), -1);
+        hashes[slot].store(0, std::memory_order_release);
+        --used;
+        slab.Free(pop, victim);
+    }
+
+    bool OverflowArea::Next(int &slot, HashValue &hash_value, std::chrono::microseconds wait) noexcept
+    {
+        std::unique_lock l(queue_lock);
+        if (!queued.wait_for(l, wait, [&]() { return !requests.empty(); }))
+        {
+            return false;
+        }
+        slot = requests.front().first;
+        hash_value = HashValue(requests.front().second);
+        requests.pop_front();
+        return true;
+    }
+
+    FunctionStatus OverflowArea::Drain(PoolBase &pop, int slot, const HashValue &hash_value, const std::function<FunctionStatus(const KVPairPtr &)> &link) noexcept
+    {
+        std::unique_lock _(lock);
+        // removed meanwhile, or taken by another key queued on its own
+        if (slots[slot] == nullptr || hashes[slot].load(std::memory_order_relaxed) != hash_value.GetRaw())
+        {
+            return FunctionStatus::Ok;
+        }
+        auto ret = link(slots[slot]);
+        if (ret == FunctionStatus::Ok)
+        {
+            slots[slot] = nullptr;
+            Persist(pop, &slots[slot], sizeof(KVPairPtr));
+            hashes[slot].store(0, std::memory_order_release);
+            count(hash_value.GetRaw(), -1);
+            --used;
+        }
+        return ret;
+    }
+
+    uint64_t OverflowArea::Pending() const noexcept
+    {
+        std::lock_guard<std::mutex> _(queue_lock);
+        return requests.size();
+    }
+
+    uint64_t OverflowArea::PeakPending() const noexcept
+    {
+        return peak;
+    }
+
+    void OverflowArea::ForEach(uint64_t begin, uint64_t end, uint8_t depth, const std::function<void(const KVPairPtr &)> &func) const noexcept
+    {
+        std::shared_lock _(lock);
+        for (int i = 0; i < STASH_LIMIT; i++)
+        {
+            auto entry = HashValue(hashes[i].load(std::memory_order_relaxed)).SegmentBits(depth);
+            if (slots[i] != nullptr && entry >= begin && entry < end)
+            {
+                func(slots[i]);
+            }
+        }
+    }
+
+    void OverflowArea::Mark(SlabAllocator &slab) const noexcept
+    {
+        for (int i = 0; i < STASH_LIMIT; i++)
+        {
+            if (slots[i] != nullptr)
+            {
+                slab.Mark(slots[i]);
+            }
+        }
+    }
+
+    int OverflowArea::Relocate(PoolBase &pop, SlabAllocator &slab, const std::function<bool(const KVPairPtr &)> &moving) noexcept
+    {
+        std::unique_lock _(lock);
+        int moved = 0;
+        for (int i = 0; i < STASH_LIMIT; i++)
+        {
+            if (slots[i] == nullptr || !moving(slots[i]))
+            {
+                continue;
+            }
+            KVPairPtr old = slots[i];
+            slots[i] = slab.Make(pop, old->Key(), old->Value());
+            Persist(pop, &slots[i], sizeof(KVPairPtr));
+            slab.Free(pop, old);
+            moved++;
+        }
+        return moved;
+    }
+
+    bool OverflowArea::may_hold(uint64_t hash) const noexcept
+    {
+        // low bits pick segment and bucket, parked keys share them, mix them all in
+        return filter[(hash * 0x9E3779B97F4A7C15UL) >> (64 - FILTER_BITS)].load(std::memory_order_acquire) != 0;
+    }
+
+    void OverflowArea::count(uint64_t hash, int delta) noexcept
+    {
+        auto &f = filter[(hash * 0x9E3779B97F4A7C15UL) >> (64 - FILTER_BITS)];
+        f.store(f.load(std::memory_order_relaxed) + delta, std::memory_order_release);
+    }
+
+    void OverflowArea::enqueue(int slot, uint64_t hash) noexcept
+    {
+        {
+            std::lock_guard<std::mutex> _(queue_lock);
+            requests.emplace_back(slot, hash);
+            if (requests.size() > peak)
+            {
+                peak = requests.size();
+            }
+        }
+        Metrics::Add(Metric::SplitsQueued);
+        queued.notify_one();
+    }
+} // namespace Dalea
@@ -0,0 +1,90 @@
+#ifndef __DALEA__OVERFLOW__OVERFLOW__
+#define __DALEA__OVERFLOW__OVERFLOW__
+#include "Slab/Slab.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+namespace Dalea
+{
+    using OverflowSlots = Backend::Ptr<KVPairPtr[]>;
+
+    /*
+     * STASH_LIMIT persistent slots taking inserts into full buckets while their splits wait
+     * for a background worker, so that the inserting thread returns without splitting. Every
+     * pair put here queues a split request naming its slot; the worker serving it splits the
+     * bucket and links the pair back, see HashTable::RunSplits
+     *
+     * a key lives either in its bucket or here, never in both: a slot is only written by the
+     * holder of the lock of the bucket owning the key, and Drain links a pair before its slot
+     * is cleared, so Get looks here first. A slot is a pointer in PM and nothing else, hashes
+     * are volatile and rebuilt at open, when every pair found here is queued again. Keys never
+     * parked are told apart without any lock by a counting filter, one load each for most
+     */
+    class OverflowArea
+    {
+    public:
+        // entries of the filter, 16 per slot keep false positives around 3%
+        static constexpr int FILTER_BITS = 11;
+
+        // slots is made if null, otherwise it holds the pairs of a previous run
+        OverflowArea(PoolBase &pop, OverflowSlots &slots);
+        OverflowArea() = delete;
+        OverflowArea(const OverflowArea &) = delete;
+        OverflowArea(OverflowArea &&) = delete;
+
+        // pairs held, Get and Find are needless while it is 0
+        uint64_t Used() const noexcept;
+        bool Get(const String &key, const HashValue &hash_value, KVPairPtr &ret) const noexcept;
+        // slot holding key, -1 if none does; the caller holds the lock of the bucket owning key
+        int Find(const String &key, const HashValue &hash_value) const noexcept;
+        // the pair is persisted and its split request queued, false if every slot is taken
+        bool Insert(PoolBase &pop, SlabAllocator &slab, const String &key, const String &value, const HashValue &hash_value) noexcept;
+        void Replace(PoolBase &pop, SlabAllocator &slab, int slot, const String &key, const String &value) noexcept;
+        void Remove(PoolBase &pop, SlabAllocator &slab, int slot) noexcept;
+
+        // the next split request, false if none came within wait
+        bool Next(int &slot, HashValue &hash_value, std::chrono::microseconds wait) noexcept;
+        /*
+         * link gets the pair of slot if it still holds the key of hash_value, the slot is
+         * cleared when link returns Ok. Ok as well if the pair is gone meanwhile
+         */
+        FunctionStatus Drain(PoolBase &pop, int slot, const HashValue &hash_value, const std::function<FunctionStatus(const KVPairPtr &)> &link) noexcept;
+        uint64_t Pending() const noexcept;
+        uint64_t PeakPending() const noexcept;
+
+        // pairs whose hashes pick a directory entry in [begin, end) at depth
+        void ForEach(uint64_t begin, uint64_t end, uint8_t depth, const std::function<void(const KVPairPtr &)> &func) const noexcept;
+        void Mark(SlabAllocator &slab) const noexcept;
+        // replace every pair moving selects by a copy, returns their number
+        int Relocate(PoolBase &pop, SlabAllocator &slab, const std::function<bool(const KVPairPtr &)> &moving) noexcept;
+
+    private:
+        OverflowSlots &slots;
+        // guards slots, readers share it
+        mutable std::shared_mutex lock;
+        // of the key in each slot, 0 while free
+        std::atomic<uint64_t> hashes[STASH_LIMIT];
+        // parked keys by mixed hash bits, raised before a slot is taken and lowered after it is cleared
+        std::atomic<uint8_t> filter[1 << FILTER_BITS];
+        std::atomic<uint64_t> used;
+
+        // guards requests
+        mutable std::mutex queue_lock;
+        std::condition_variable queued;
+        std::deque<std::pair<int, uint64_t>> requests;
+        std::atomic<uint64_t> peak;
+
+        // under lock, or the lock of the bucket owning key
+        int find(const String &key, const HashValue &hash_value) const noexcept;
+        void enqueue(int slot, uint64_t hash) noexcept;
+        // false if no key of hash is parked, read without the lock
+        bool may_hold(uint64_t hash) const noexcept;
+        // under lock
+        void count(uint64_t hash, int delta) noexcept;
+    };
+} // namespace Dalea
+#endif
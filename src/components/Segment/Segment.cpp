@@ -4,7 +4,8 @@ namespace Dalea
     SegmentPtr Segment::New(PoolBase &pop, uint8_t depth, uint64_t seg_no)
     {
         SegmentPtr seg;
-        seg = pobj::make_persistent<Segment>(pop, depth, seg_no, false);
+        seg = Backend::Make<Segment>(pop, depth, seg_no, false);
+        seg->MakeShadow();
         return seg;
     }
 
@@ -19,11 +20,17 @@ namespace Dalea
             status = SegStatus::Quiescent;
         }
 
+        shadow = nullptr;
         std::for_each(std::begin(buckets), std::end(buckets), [&](Bucket &bkt) {
             bkt.SetDepth(depth);
         });
     }
 
+    Segment::~Segment()
+    {
+        delete shadow;
+    }
+
     /*
     KVPairPtr Segment::Get(const String &key, const HashValue &hash_value, std::shared_mutex &mux) const noexcept
     {
@@ -44,9 +51,64 @@ namespace Dalea
     */
     bool Segment::Recover() noexcept
     {
+        shadow = nullptr;
+        std::for_each(std::begin(buckets), std::end(buckets), [&](Bucket &bkt) {
+            bkt.Recover();
+        });
         return true;
     }
 
+    void Segment::Renumber(uint64_t seg_no) noexcept
+    {
+        segment_no = seg_no;
+        if (shadow != nullptr)
+        {
+            shadow->segment_no = seg_no;
+        }
+    }
+
+    // the buckets copy their metadata and fingerprints from PM into the side array
+    void Segment::MakeShadow() noexcept
+    {
+        shadow = new ShadowSegment;
+        shadow->segment = this;
+        shadow->segment_no = segment_no;
+#ifdef HYBRID
+        for (int i = 0; i < SEG_SIZE; i++)
+        {
+            buckets[i].Attach(&shadow->side[i]);
+        }
+#endif
+    }
+
+    void Segment::DropShadow() noexcept
+    {
+#ifdef HYBRID
+        for (int i = 0; i < SEG_SIZE; i++)
+        {
+            buckets[i].Attach(nullptr);
+        }
+#endif
+        delete shadow;
+        shadow = nullptr;
+    }
+
+    Bucket::BucketCache *ShadowSegment::Side(uint64_t bkt_bits) noexcept
+    {
+#ifdef HYBRID
+        return &side[bkt_bits];
+#else
+        return nullptr;
+#endif
+    }
+
+    bool Segment::OwnsBuckets() const noexcept
+    {
+        return std::any_of(std::begin(buckets), std::end(buckets), [](const Bucket &bkt) {
+            return !bkt.HasAncestor();
+        });
+    }
+
     SegmentPtr Segment::Split(PoolBase &pop, Directory &dir, uint64_t bucket_bits) noexcept
     {
         return nullptr;
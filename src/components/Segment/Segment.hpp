@@ -5,36 +5,66 @@ namespace Dalea
 {
     class Directory;
     class Segment;
-    using SegmentPtr = pmem::obj::persistent_ptr<Segment>;
+    using SegmentPtr = Backend::Ptr<Segment>;
     enum class SegStatus
     {
         Quiescent,
         Initializing,
     };
 
+    /*
+     * volatile side of a segment, what the shadow directory points to: lookups read the segment
+     * number here instead of in PM, and under HYBRID the metadata, fingerprints and lock of its
+     * buckets from side, so that PM is only read for the pair itself. Only segments linked into
+     * the table have one, those waiting in the segment pool do not
+     */
+    struct ShadowSegment
+    {
+        Segment *segment;
+        uint64_t segment_no;
+#ifdef HYBRID
+        Bucket::BucketCache side[SEG_SIZE];
+#endif
+
+        // entry of bucket bkt_bits to pass to Bucket, nullptr unless HYBRID
+        Bucket::BucketCache *Side(uint64_t bkt_bits) noexcept;
+    };
+
     struct Segment
     {
-        // supposed to be called within a transaction
+        // supposed to be called within a transaction, the segment comes with its shadow
         static SegmentPtr New(PoolBase &pop, uint8_t depth, uint64_t seg_no);
 
         Segment(PoolBase &pop, uint8_t depth, uint64_t segment_no, bool init);
         Segment(const Segment &) = delete;
         Segment(Segment &&) = delete;
+        ~Segment();
 
         /* reserved methods
         KVPairPtr Get(const String &key, const HashValue &hash_value, std::shared_mutex &mux) const noexcept;
         FunctionStatus Put(PoolBase &pop, const String &key, const String &value, const HashValue &hash_value, std::shared_mutex &mux) noexcept;
         FunctionStatus Remove(const String &key, const HashValue &hash_value, std::shared_mutex &mux) const noexcept;
         */
+        // forgets the shadow of the previous run, MakeShadow makes a new one for a linked segment
         bool Recover() noexcept;
+        // a preallocated segment is reused under another number
+        void Renumber(uint64_t seg_no) noexcept;
+        // before the segment is linked or its buckets are used
+        void MakeShadow() noexcept;
+        // on the way back to the pool, once nothing reaches the segment any more
+        void DropShadow() noexcept;
+        // false if every bucket redirects to an ancestor, i.e., the segment stores nothing itself
+        bool OwnsBuckets() const noexcept;
         SegmentPtr Split(PoolBase &pop, Directory &dir, uint64_t bkt_bits) noexcept;
         void Debug() const noexcept;
         void DebugTo(std::stringstream &strm) const noexcept;
 
         // unable to use smart pointers
-        pobj::p<uint64_t> segment_no;
-        pobj::p<SegStatus> status;
-        pobj::array<Bucket, SEG_SIZE> buckets;
+        Backend::Field<uint64_t> segment_no;
+        Backend::Field<SegStatus> status;
+        Backend::Array<Bucket, SEG_SIZE> buckets;
+        // volatile, nullptr until MakeShadow
+        ShadowSegment *shadow;
     };
 } // namespace Dalea
 #endif
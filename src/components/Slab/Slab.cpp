@@ -0,0 +1,370 @@
+#include "Slab.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+namespace Dalea
+{
+    static std::atomic<uint64_t> next_allocator_id(1);
+
+    // cursors of the calling thread by allocator id, its slabs are disowned when it exits
+    struct SlabCursors
+    {
+        std::vector<std::pair<uint64_t, SlabAllocator::Cursor *>> entries;
+
+        ~SlabCursors()
+        {
+            for (const auto &e : entries)
+            {
+                for (auto s : e.second->current)
+                {
+                    if (s != nullptr)
+                    {
+                        e.second->owner->disown(s);
+                    }
+                }
+                // nobody looks at this cursor again, acquire releases them
+                auto owner = e.second->owner;
+                std::lock_guard<std::mutex> _(owner->lock);
+                owner->orphans.insert(owner->orphans.end(), e.second->retired.begin(), e.second->retired.end());
+                e.second->retired.clear();
+            }
+        }
+    };
+
+    static thread_local SlabCursors thread_cursors;
+
+    KVPair *SlabAllocator::Slab::record(uint64_t slot) const noexcept
+    {
+        return reinterpret_cast<KVPair *>(base + HEADER_BYTES + slot * record_size);
+    }
+
+    int64_t SlabAllocator::Slab::claim() noexcept
+    {
+        auto words = (records + 63) / 64;
+        for (uint64_t i = 0; i < words; i++)
+        {
+            auto w = (hint + i) % words;
+            auto bits = bitmap[w].load(std::memory_order_relaxed);
+            while (~bits != 0)
+            {
+                auto bit = 1UL << __builtin_ctzll(~bits);
+                bits = bitmap[w].fetch_or(bit, std::memory_order_acquire);
+                if ((bits & bit) == 0)
+                {
+                    hint = w;
+                    ++used;
+                    return w * 64 + __builtin_ctzll(bit);
+                }
+            }
+        }
+        return -1;
+    }
+
+    void SlabAllocator::Slab::release(uint64_t slot) noexcept
+    {
+        bitmap[slot / 64].fetch_and(~(1UL << (slot % 64)), std::memory_order_release);
+        --used;
+    }
+
+    SlabAllocator::SlabAllocator(SlabList &s) : id(next_allocator_id++), slabs(s), slab_count(0), values(nullptr), threshold(0)
+    {
+        for (auto &c : chunks)
+        {
+            c.store(nullptr, std::memory_order_relaxed);
+        }
+        for (int i = 0; i < CLASSES; i++)
+        {
+            frees[i] = 0;
+            // nothing searched yet
+            searched[i] = ~0UL;
+        }
+        std::lock_guard<std::mutex> _(lock);
+        const auto &list = slabs;
+        for (size_t i = 0; i < list.size(); i++)
+        {
+            attach(list[i]);
+        }
+    }
+
+    void SlabAllocator::LogValues(ValueLog *log, uint64_t t) noexcept
+    {
+        values = log;
+        threshold = t;
+    }
+
+    KVPairPtr SlabAllocator::Make(PoolBase &pop, std::string_view key, std::string_view value) noexcept
+    {
+        auto logged = threshold != 0 && value.size() >= threshold;
+        auto size = sizeof(KVPair) + key.size() + (logged ? sizeof(KVPair::ValueRef) : value.size());
+        KVPairPtr ptr;
+        auto r = place(pop, size, ptr);
+        r->key_size = key.size();
+        auto data = const_cast<char *>(r->data());
+        if (logged)
+        {
+            // the value is persisted in its log before the record can point to it
+            r->value_size = value.size() | KVPair::LOGGED;
+            new (data) KVPair::ValueRef(values->Append(pop, value));
+            memcpy(data + sizeof(KVPair::ValueRef), key.data(), key.size());
+        }
+        else
+        {
+            r->value_size = value.size();
+            memcpy(data, key.data(), key.size());
+            memcpy(data + key.size(), value.data(), value.size());
+        }
+        // a torn record is never linked, so Sweep frees it whatever state reached PM
+        Persist(pop, r, size);
+        return ptr;
+    }
+
+    KVPairPtr SlabAllocator::MakeCounter(PoolBase &pop, std::string_view key, int64_t value) noexcept
+    {
+        auto size = sizeof(KVPair) + sizeof(int64_t) + key.size();
+        KVPairPtr ptr;
+        auto r = place(pop, size, ptr);
+        r->key_size = key.size();
+        r->value_size = sizeof(int64_t) | KVPair::COUNTER;
+        r->SetCounter(value);
+        memcpy(const_cast<char *>(r->data()) + sizeof(int64_t), key.data(), key.size());
+        Persist(pop, r, size);
+        return ptr;
+    }
+
+    KVPair *SlabAllocator::place(PoolBase &pop, uint64_t size, KVPairPtr &ptr) noexcept
+    {
+        auto cls = class_of(size);
+        auto c = cursor();
+        auto slab = c->current[cls];
+        auto slot = slab ? slab->claim() : -1;
+        if (slot < 0)
+        {
+            if (slab != nullptr)
+            {
+                disown(slab);
+            }
+            slab = acquire(pop, cls, 1UL << (cls + MIN_CLASS));
+            c->current[cls] = slab;
+            slot = slab->claim();
+        }
+
+        auto r = slab->record(slot);
+        r->slab = slab->id;
+        r->state = KVPair::ALLOCATED;
+        ptr = Backend::At<KVPair>(slab->ptr, HEADER_BYTES + slot * slab->record_size);
+        return r;
+    }
+
+    void SlabAllocator::Free(PoolBase &pop, const KVPairPtr &pair) noexcept
+    {
+        auto r = pair.get();
+        r->state = 0;
+        Persist(pop, &r->state, sizeof(r->state));
+        // readers may still hold the record and its logged value, both stay as they are
+        auto c = cursor();
+        c->retired.push_back(Retired{r, Epoch::Advance()});
+        if (c->retired.size() >= c->reclaim_at)
+        {
+            reclaim(c->retired);
+            // records a reader still holds wait for the next batch instead of a look per Free
+            c->reclaim_at = c->retired.size() + RETIRE_BATCH;
+        }
+    }
+
+    void SlabAllocator::reclaim(std::vector<Retired> &retired) noexcept
+    {
+        // epochs grow in the order records were retired, and Safe for one holds for those before
+        size_t safe = 0;
+        if (!retired.empty() && Epoch::Safe(retired.back().epoch))
+        {
+            safe = retired.size();
+        }
+        while (safe < retired.size() && Epoch::Safe(retired[safe].epoch))
+        {
+            ++safe;
+        }
+        for (size_t i = 0; i < safe; i++)
+        {
+            release(retired[i].record);
+        }
+        retired.erase(retired.begin(), retired.begin() + safe);
+    }
+
+    void SlabAllocator::release(KVPair *r) noexcept
+    {
+        auto slab = slab_of(r->slab);
+        if (r->Logged())
+        {
+            values->Release(r->Ref(), r->ValueSize());
+        }
+        slab->release((reinterpret_cast<char *>(r) - slab->base - HEADER_BYTES) / slab->record_size);
+        if (!slab->owned.load(std::memory_order_acquire))
+        {
+            ++frees[slab->cls];
+        }
+    }
+
+    void SlabAllocator::Mark(const KVPairPtr &pair) noexcept
+    {
+        auto r = pair.get();
+        // a slot left behind by a split may point to a record freed since
+        if (r->state != KVPair::ALLOCATED || r->slab >= slab_count)
+        {
+            return;
+        }
+        auto slab = slab_of(r->slab);
+        auto slot = (reinterpret_cast<char *>(r) - slab->base - HEADER_BYTES) / slab->record_size;
+        auto bit = 1UL << (slot % 64);
+        if ((slab->bitmap[slot / 64].fetch_or(bit, std::memory_order_relaxed) & bit) == 0)
+        {
+            ++slab->used;
+            if (r->Logged())
+            {
+                values->Mark(r->Ref(), r->ValueSize());
+            }
+        }
+    }
+
+    uint64_t SlabAllocator::Sweep(PoolBase &pop) noexcept
+    {
+        uint64_t swept = 0;
+        std::lock_guard<std::mutex> _(lock);
+        for (uint32_t i = 0; i < slab_count; i++)
+        {
+            auto slab = slab_of(i);
+            for (uint64_t slot = 0; slot < slab->records; slot++)
+            {
+                auto r = slab->record(slot);
+                if ((slab->bitmap[slot / 64].load(std::memory_order_relaxed) & (1UL << (slot % 64))) == 0 &&
+                    r->state == KVPair::ALLOCATED)
+                {
+                    r->state = 0;
+                    Persist(pop, &r->state, sizeof(r->state));
+                    ++swept;
+                }
+            }
+        }
+        return swept;
+    }
+
+    SlabAllocator::Slab *SlabAllocator::slab_of(uint32_t slab_id) const noexcept
+    {
+        auto chunk = chunks[slab_id >> CHUNK_BITS].load(std::memory_order_acquire);
+        return chunk[slab_id & ((1U << CHUNK_BITS) - 1)].load(std::memory_order_acquire);
+    }
+
+    SlabAllocator::Slab *SlabAllocator::attach(const Backend::Ptr<char[]> &ptr) noexcept
+    {
+        auto slab_id = slab_count.load();
+        if ((slab_id >> CHUNK_BITS) >= CHUNKS)
+        {
+            std::cout << "too many slabs\n";
+            std::abort();
+        }
+        auto &chunk = chunks[slab_id >> CHUNK_BITS];
+        if (chunk.load() == nullptr)
+        {
+            chunk.store(new std::atomic<Slab *>[1U << CHUNK_BITS]());
+        }
+
+        auto header = reinterpret_cast<const SlabHeader *>(ptr.get());
+        auto slab = new Slab;
+        slab->ptr = ptr;
+        slab->base = ptr.get();
+        slab->id = slab_id;
+        slab->cls = class_of(header->record_size);
+        slab->record_size = header->record_size;
+        slab->records = header->records;
+        slab->owned = false;
+        slab->used = 0;
+        slab->hint = 0;
+        auto words = (slab->records + 63) / 64;
+        slab->bitmap = std::make_unique<std::atomic<uint64_t>[]>(words);
+        for (uint64_t w = 0; w < words; w++)
+        {
+            slab->bitmap[w] = 0;
+        }
+        // slots past the last record are never free
+        if (slab->records % 64 != 0)
+        {
+            slab->bitmap[words - 1] = ~0UL << (slab->records % 64);
+        }
+
+        by_class[slab->cls].push_back(slab);
+        chunk.load()[slab_id & ((1U << CHUNK_BITS) - 1)].store(slab, std::memory_order_release);
+        ++slab_count;
+        return slab;
+    }
+
+    SlabAllocator::Slab *SlabAllocator::acquire(PoolBase &pop, int cls, uint64_t record_size) noexcept
+    {
+        std::lock_guard<std::mutex> _(lock);
+        reclaim(orphans);
+        auto f = frees[cls].load();
+        if (f != searched[cls])
+        {
+            for (auto s : by_class[cls])
+            {
+                auto expected = false;
+                if (s->used < s->records && s->owned.compare_exchange_strong(expected, true))
+                {
+                    return s;
+                }
+            }
+            // further searches are in vain until a slot is freed
+            searched[cls] = f;
+        }
+
+        auto bytes = std::max(SLAB_BYTES, HEADER_BYTES + record_size);
+        Backend::Ptr<char[]> ptr = nullptr;
+        Backend::Run(pop, [&]() {
+            ptr = Backend::Make<char[]>(bytes);
+            auto header = reinterpret_cast<SlabHeader *>(ptr.get());
+            header->record_size = record_size;
+            header->records = (bytes - HEADER_BYTES) / record_size;
+            Persist(pop, header, sizeof(SlabHeader));
+            slabs.push_back(ptr);
+        });
+        auto slab = attach(ptr);
+        slab->owned = true;
+        return slab;
+    }
+
+    void SlabAllocator::disown(Slab *slab) noexcept
+    {
+        slab->owned.store(false, std::memory_order_release);
+        if (slab->used < slab->records)
+        {
+            ++frees[slab->cls];
+        }
+    }
+
+    SlabAllocator::Cursor *SlabAllocator::cursor() noexcept
+    {
+        for (const auto &e : thread_cursors.entries)
+        {
+            if (e.first == id)
+            {
+                return e.second;
+            }
+        }
+        std::lock_guard<std::mutex> _(lock);
+        cursors.push_back(std::make_unique<Cursor>());
+        auto c = cursors.back().get();
+        c->owner = this;
+        c->reclaim_at = RETIRE_BATCH;
+        thread_cursors.entries.emplace_back(id, c);
+        return c;
+    }
+
+    int SlabAllocator::class_of(uint64_t size) noexcept
+    {
+        int cls = 0;
+        while ((1UL << (cls + MIN_CLASS)) < size)
+        {
+            cls++;
+        }
+        return cls;
+    }
+} // namespace Dalea
@@ -0,0 +1,147 @@
+#ifndef __DALEA__SLAB__SLAB__
+#define __DALEA__SLAB__SLAB__
+#include "Epoch/Epoch.hpp"
+#include "ValueLog/ValueLog.hpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+namespace Dalea
+{
+    using SlabList = Backend::Vector<Backend::Ptr<char[]>>;
+
+    /*
+     * Dalea-owned allocator of KVPair records, so that an insert takes a slot of a slab its
+     * thread owns with one atomic operation and persists the record with one flush, instead
+     * of three allocations inside a transaction of the pool allocator
+     *
+     * record sizes are rounded up to a power of two class, a slab holds records of one class
+     * and hands out slots to one thread at a time, any thread may free. The persistent
+     * allocation bit is the state word in the record header; the bitmaps of the slabs are
+     * volatile and rebuilt at open by Mark and Sweep. Slabs are never returned to the pool
+     *
+     * a freed slot is retired with the epoch of its Free and only goes back to its bitmap once
+     * Epoch::Safe holds for it, so that a reader who found the record before it was unlinked
+     * never sees it overwritten
+     */
+    class SlabAllocator
+    {
+    public:
+        // bytes of a slab of small records, a bigger record gets a slab of its own
+        static constexpr uint64_t SLAB_BYTES = 1UL << 16;
+        static constexpr int MIN_CLASS = 5;
+        static constexpr int CLASSES = 32 - MIN_CLASS;
+
+        /*
+         * slabs is the persistent list slabs are registered in. Slabs already in there, left
+         * by a previous run, count as empty until marked: Mark every pair the table links,
+         * then Sweep, before anything is allocated
+         */
+        SlabAllocator(SlabList &slabs);
+        SlabAllocator() = delete;
+        SlabAllocator(const SlabAllocator &) = delete;
+        SlabAllocator(SlabAllocator &&) = delete;
+
+        // values of at least threshold bytes go to log from now on, never with 0
+        void LogValues(ValueLog *log, uint64_t threshold) noexcept;
+        // a record persisted and marked allocated, not linked anywhere yet
+        KVPairPtr Make(PoolBase &pop, std::string_view key, std::string_view value) noexcept;
+        KVPairPtr MakeCounter(PoolBase &pop, std::string_view key, int64_t value) noexcept;
+        // the pair must be unlinked, and that persisted, before; its slot is reused later
+        void Free(PoolBase &pop, const KVPairPtr &pair) noexcept;
+
+        void Mark(const KVPairPtr &pair) noexcept;
+        // frees records allocated but never linked before a crash, returns their number
+        uint64_t Sweep(PoolBase &pop) noexcept;
+
+    private:
+        // first bytes of every slab, records follow at HEADER_BYTES
+        struct SlabHeader
+        {
+            uint64_t record_size;
+            uint64_t records;
+        };
+        static constexpr uint64_t HEADER_BYTES = 64;
+
+        struct Slab
+        {
+            Backend::Ptr<char[]> ptr;
+            char *base;
+            uint32_t id;
+            int cls;
+            uint64_t record_size;
+            uint64_t records;
+            // held by the thread handing out its slots
+            std::atomic_bool owned;
+            std::atomic<uint64_t> used;
+            // word the owner looks at first
+            uint64_t hint;
+            std::unique_ptr<std::atomic<uint64_t>[]> bitmap;
+
+            KVPair *record(uint64_t slot) const noexcept;
+            // a free slot set in the bitmap, -1 if there is none
+            int64_t claim() noexcept;
+            void release(uint64_t slot) noexcept;
+        };
+
+        // a freed record and the epoch it was unlinked in
+        struct Retired
+        {
+            KVPair *record;
+            uint64_t epoch;
+        };
+        // records a thread retires between two looks for safe ones
+        static constexpr size_t RETIRE_BATCH = 64;
+
+        // slab handing out slots of every class for one thread, and the records it freed
+        struct Cursor
+        {
+            SlabAllocator *owner;
+            Slab *current[CLASSES];
+            std::vector<Retired> retired;
+            // size of retired that makes the next look
+            size_t reclaim_at;
+        };
+
+        static constexpr int CHUNK_BITS = 12;
+        static constexpr int CHUNKS = 1 << 10;
+
+        uint64_t id;
+        SlabList &slabs;
+        // guards slabs, by_class, cursors and making chunks
+        std::mutex lock;
+        // slab by id in two levels, so that Free and Mark never take the lock
+        std::atomic<std::atomic<Slab *> *> chunks[CHUNKS];
+        std::atomic<uint32_t> slab_count;
+        std::vector<Slab *> by_class[CLASSES];
+        // bumped when a slab nobody owns gets a free slot, acquire skips its search otherwise
+        std::atomic<uint64_t> frees[CLASSES];
+        uint64_t searched[CLASSES];
+        std::vector<std::unique_ptr<Cursor>> cursors;
+        // retired records of threads that exited, released by acquire
+        std::vector<Retired> orphans;
+        // holds the values of records marked LOGGED, set before any is made or marked
+        ValueLog *values;
+        uint64_t threshold;
+
+        // a slot of size bytes with slab id and state set, ptr is set to it
+        KVPair *place(PoolBase &pop, uint64_t size, KVPairPtr &ptr) noexcept;
+        Slab *slab_of(uint32_t slab_id) const noexcept;
+        // volatile side of a slab, under lock
+        Slab *attach(const Backend::Ptr<char[]> &ptr) noexcept;
+        // a slab of class cls with free slots nobody owns, made if there is none
+        Slab *acquire(PoolBase &pop, int cls, uint64_t record_size) noexcept;
+        // hand a slab over to whoever needs one next
+        void disown(Slab *slab) noexcept;
+        // give the slots of retired records no reader can hold back to their slabs, in order
+        void reclaim(std::vector<Retired> &retired) noexcept;
+        void release(KVPair *r) noexcept;
+        Cursor *cursor() noexcept;
+        static int class_of(uint64_t size) noexcept;
+
+        friend struct SlabCursors;
+    };
+} // namespace Dalea
+#endif
@@ -4,8 +4,15 @@ namespace Dalea
     void Stats::Show() const noexcept
     {
         std::cout << "simple splits: " << simple_splits;
-        std::cout << "traditional splits: " << traditional_splits;
-        std::cout << "complex splits: " << complex_splits;
+        std::cout << ", traditional splits: " << traditional_splits;
+        std::cout << ", complex splits: " << complex_splits;
+        std::cout << ", buddy segments made: " << make_buddy;
+        std::cout << ", merges: " << merges;
+        std::cout << ", freed segments: " << freed_segments;
+        std::cout << ", halvings: " << halvings;
+        std::cout << ", collected value chunks: " << collected_chunks;
+        std::cout << ", relocated values: " << relocated_values;
+        std::cout << ", flattens: " << flattens << "\n";
     }
 
     void Stats::Clear() noexcept
@@ -16,5 +23,32 @@ namespace Dalea
         simple_split_time = 0;
         traditional_split_time = 0;
         complex_split_time = 0;
+        make_buddy = 0;
+        make_buddy_time = 0;
+        merges = 0;
+        freed_segments = 0;
+        halvings = 0;
+        collected_chunks = 0;
+        relocated_values = 0;
+        flattens = 0;
+    }
+
+    Stats &Stats::operator+=(const Stats &rhs) noexcept
+    {
+        simple_splits += rhs.simple_splits;
+        simple_split_time += rhs.simple_split_time;
+        traditional_splits += rhs.traditional_splits;
+        traditional_split_time += rhs.traditional_split_time;
+        complex_splits += rhs.complex_splits;
+        complex_split_time += rhs.complex_split_time;
+        make_buddy += rhs.make_buddy;
+        make_buddy_time += rhs.make_buddy_time;
+        merges += rhs.merges;
+        freed_segments += rhs.freed_segments;
+        halvings += rhs.halvings;
+        collected_chunks += rhs.collected_chunks;
+        relocated_values += rhs.relocated_values;
+        flattens += rhs.flattens;
+        return *this;
     }
 }
@@ -2,7 +2,8 @@
 #define __DALEA__STATS__STATS__
 #include "Common/Common.hpp"
 namespace Dalea{
-    struct Stats
+    // kept per thread, padded so that neighbouring threads' counters never share a line
+    struct alignas(64) Stats
     {
         uint64_t simple_splits;
         double simple_split_time;
@@ -12,16 +13,34 @@ namespace Dalea{
         double complex_split_time;
         uint64_t make_buddy;
         double make_buddy_time;
+        uint64_t merges;
+        uint64_t freed_segments;
+        uint64_t halvings;
+        uint64_t collected_chunks;
+        uint64_t relocated_values;
+        // splits of ancestors done early for a redirected Put, counted among the splits too
+        uint64_t flattens;
 
-        Stats() : simple_splits(0), traditional_splits(0), complex_splits(0), make_buddy(0),
+        Stats() : simple_splits(0),
                   simple_split_time(0),
+                  traditional_splits(0),
                   traditional_split_time(0),
+                  complex_splits(0),
                   complex_split_time(0),
-                  make_buddy_time(0) {};
+                  make_buddy(0),
+                  make_buddy_time(0),
+                  merges(0),
+                  freed_segments(0),
+                  halvings(0),
+                  collected_chunks(0),
+                  relocated_values(0),
+                  flattens(0) {};
         Stats(const Stats &) = default;
         Stats(Stats &&) = default;
+        Stats &operator=(const Stats &) = default;
         void Show() const noexcept;
         void Clear() noexcept;
+        Stats &operator+=(const Stats &rhs) noexcept;
     };
 }
 #endif
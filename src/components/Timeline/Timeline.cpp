@@ -0,0 +1,282 @@
+#include "Timeline.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+namespace Dalea
+{
+    static const char *EVENT_NAMES[] = {"simple_split", "traditional_split", "complex_split", "doubling", "halving", "phase"};
+
+    std::atomic<Timeline *> Timeline::active = nullptr;
+    std::atomic_int Timeline::recording = 0;
+
+    Timeline::Timeline(const std::string &f, uint64_t interval_ms, int thread_num)
+        : file(f), interval(interval_ms * 1000000), begin(0), recorders(thread_num),
+          running(false), last_counts(HISTOGRAM_SIZE, 0), last_total(0), last_time(0)
+    {
+        for (int i = 0; i < EVENT_KINDS; i++)
+        {
+            event_counts[i] = 0;
+            event_durations[i] = 0;
+            last_events[i] = 0;
+            last_durations[i] = 0;
+        }
+    }
+
+    Timeline::~Timeline()
+    {
+        Stop();
+    }
+
+    bool Timeline::Start() noexcept
+    {
+        Timeline *expected = nullptr;
+        if (!active.compare_exchange_strong(expected, this))
+        {
+            std::cout << "another timeline is running\n";
+            return false;
+        }
+        begin = last_time = Now();
+        running = true;
+        sampler = std::thread([this]() {
+            auto next = std::chrono::steady_clock::now();
+            std::unique_lock<std::mutex> guard(wakeup_lock);
+            while (running)
+            {
+                // ticks stay on a fixed grid however long sampling takes; Stop wakes up early
+                next += std::chrono::nanoseconds(interval);
+                wakeup.wait_until(guard, next, [this]() { return !running; });
+                sample();
+            }
+        });
+        return true;
+    }
+
+    void Timeline::Stop() noexcept
+    {
+        if (!running)
+        {
+            return;
+        }
+        // background threads keep recording splits, new ones see no timeline from here on
+        active = nullptr;
+        {
+            std::lock_guard<std::mutex> _(wakeup_lock);
+            running = false;
+        }
+        wakeup.notify_all();
+        sampler.join();
+        while (recording != 0)
+        {
+            std::this_thread::yield();
+        }
+        std::lock_guard<std::mutex> _(lock);
+        // events are recorded when they end, list them by start
+        std::sort(singles.begin(), singles.end(), [](const Single &l, const Single &r) {
+            return l.time < r.time;
+        });
+        if (file.size() >= 5 && file.compare(file.size() - 5, 5, ".json") == 0)
+        {
+            write_json();
+        }
+        else
+        {
+            write_csv();
+        }
+        std::cout << "timeline written to " << file << "\n";
+    }
+
+    bool Timeline::Active() noexcept
+    {
+        return active.load(std::memory_order_relaxed) != nullptr;
+    }
+
+    uint64_t Timeline::Now() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void Timeline::Operation(int thread_id, uint64_t latency) noexcept
+    {
+        auto t = active.load(std::memory_order_relaxed);
+        if (t == nullptr || thread_id >= (int)t->recorders.size())
+        {
+            return;
+        }
+        // single writer, a plain add is enough for the sampler to read a consistent value
+        auto &r = t->recorders[thread_id];
+        auto &slot = r.counts[bucket_of(latency)];
+        slot.store(slot.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        r.total.store(r.total.load(std::memory_order_relaxed) + latency, std::memory_order_relaxed);
+    }
+
+    void Timeline::Record(Event event, uint64_t start, uint64_t duration) noexcept
+    {
+        ++recording;
+        auto t = active.load();
+        if (t != nullptr)
+        {
+            auto kind = static_cast<int>(event);
+            t->event_counts[kind].fetch_add(1, std::memory_order_relaxed);
+            t->event_durations[kind].fetch_add(duration, std::memory_order_relaxed);
+            // simple and traditional splits are too many to be listed one by one
+            if (event != Event::SimpleSplit && event != Event::TraditionalSplit)
+            {
+                std::lock_guard<std::mutex> _(t->lock);
+                t->singles.push_back({event, (start - std::min(start, t->begin)) / 1000000.0, duration / 1000000.0, ""});
+            }
+        }
+        --recording;
+    }
+
+    void Timeline::Mark(const std::string &phase) noexcept
+    {
+        ++recording;
+        auto t = active.load();
+        if (t != nullptr)
+        {
+            std::lock_guard<std::mutex> _(t->lock);
+            t->singles.push_back({Event::Phase, (Now() - t->begin) / 1000000.0, 0, phase});
+        }
+        --recording;
+    }
+
+    int Timeline::bucket_of(uint64_t latency) noexcept
+    {
+        if (latency < 16)
+        {
+            return latency;
+        }
+        int exp = 63 - __builtin_clzl(latency);
+        return 16 + (exp - 4) * 8 + ((latency >> (exp - 3)) & 7);
+    }
+
+    // middle of the bucket
+    uint64_t Timeline::value_of(int bucket) noexcept
+    {
+        if (bucket < 16)
+        {
+            return bucket;
+        }
+        auto exp = (bucket - 16) / 8 + 4;
+        auto width = 1UL << (exp - 3);
+        return (8 + (bucket - 16) % 8) * width + width / 2;
+    }
+
+    void Timeline::sample() noexcept
+    {
+        auto now = Now();
+        std::vector<uint64_t> counts(HISTOGRAM_SIZE, 0);
+        uint64_t total = 0;
+        for (const auto &r : recorders)
+        {
+            for (int i = 0; i < HISTOGRAM_SIZE; i++)
+            {
+                counts[i] += r.counts[i].load(std::memory_order_relaxed);
+            }
+            total += r.total.load(std::memory_order_relaxed);
+        }
+
+        Sample s;
+        s.time = (now - begin) / 1000000.0;
+        s.ops = 0;
+        for (int i = 0; i < HISTOGRAM_SIZE; i++)
+        {
+            std::swap(counts[i], last_counts[i]);
+            counts[i] = last_counts[i] - counts[i];
+            s.ops += counts[i];
+        }
+        s.throughput = s.ops / ((now - last_time) / 1000000000.0);
+        s.mean = s.ops ? double(total - last_total) / s.ops : 0;
+        last_total = total;
+        last_time = now;
+
+        double *percentiles[] = {&s.p50, &s.p99, &s.p999};
+        const double ranks[] = {0.5, 0.99, 0.999};
+        uint64_t seen = 0;
+        int p = 0;
+        for (int i = 0; i < HISTOGRAM_SIZE && p < 3; i++)
+        {
+            seen += counts[i];
+            while (p < 3 && s.ops && seen >= ranks[p] * s.ops)
+            {
+                *percentiles[p++] = value_of(i);
+            }
+        }
+        while (p < 3)
+        {
+            *percentiles[p++] = 0;
+        }
+
+        for (int i = 0; i < EVENT_KINDS; i++)
+        {
+            auto count = event_counts[i].load(std::memory_order_relaxed);
+            auto duration = event_durations[i].load(std::memory_order_relaxed);
+            s.events[i] = count - last_events[i];
+            s.durations[i] = (duration - last_durations[i]) / 1000000.0;
+            last_events[i] = count;
+            last_durations[i] = duration;
+        }
+        samples.push_back(s);
+    }
+
+    void Timeline::write_csv() noexcept
+    {
+        std::ofstream out(file, std::ios::trunc);
+        out << "time_ms,ops,throughput,mean_ns,p50_ns,p99_ns,p999_ns";
+        for (int i = 0; i < EVENT_KINDS - 1; i++)
+        {
+            out << "," << EVENT_NAMES[i] << "s," << EVENT_NAMES[i] << "_ms";
+        }
+        out << "\n";
+        for (const auto &s : samples)
+        {
+            out << s.time << "," << s.ops << "," << s.throughput << "," << s.mean << ","
+                << s.p50 << "," << s.p99 << "," << s.p999;
+            for (int i = 0; i < EVENT_KINDS - 1; i++)
+            {
+                out << "," << s.events[i] << "," << s.durations[i];
+            }
+            out << "\n";
+        }
+
+        std::ofstream events(file + ".events.csv", std::ios::trunc);
+        events << "time_ms,event,duration_ms,phase\n";
+        for (const auto &e : singles)
+        {
+            events << e.time << "," << EVENT_NAMES[static_cast<int>(e.event)] << "," << e.duration << "," << e.phase << "\n";
+        }
+    }
+
+    void Timeline::write_json() noexcept
+    {
+        std::ofstream out(file, std::ios::trunc);
+        out << "{\n  \"interval_ms\": " << interval / 1000000 << ",\n  \"samples\": [";
+        for (size_t j = 0; j < samples.size(); j++)
+        {
+            const auto &s = samples[j];
+            out << (j ? ",\n    " : "\n    ") << "{\"time_ms\": " << s.time << ", \"ops\": " << s.ops
+                << ", \"throughput\": " << s.throughput << ", \"mean_ns\": " << s.mean
+                << ", \"p50_ns\": " << s.p50 << ", \"p99_ns\": " << s.p99 << ", \"p999_ns\": " << s.p999;
+            for (int i = 0; i < EVENT_KINDS - 1; i++)
+            {
+                out << ", \"" << EVENT_NAMES[i] << "s\": " << s.events[i]
+                    << ", \"" << EVENT_NAMES[i] << "_ms\": " << s.durations[i];
+            }
+            out << "}";
+        }
+        out << "\n  ],\n  \"events\": [";
+        for (size_t j = 0; j < singles.size(); j++)
+        {
+            const auto &e = singles[j];
+            out << (j ? ",\n    " : "\n    ") << "{\"time_ms\": " << e.time << ", \"event\": \""
+                << EVENT_NAMES[static_cast<int>(e.event)] << "\", \"duration_ms\": " << e.duration;
+            if (e.event == Event::Phase)
+            {
+                out << ", \"phase\": \"" << e.phase << "\"";
+            }
+            out << "}";
+        }
+        out << "\n  ]\n}\n";
+    }
+} // namespace Dalea
@@ -0,0 +1,124 @@
+#ifndef __DALEA__TIMELINE__TIMELINE__
+#define __DALEA__TIMELINE__TIMELINE__
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+namespace Dalea
+{
+    enum class Event
+    {
+        SimpleSplit,
+        TraditionalSplit,
+        ComplexSplit,
+        Doubling,
+        Halving,
+        Phase,
+    };
+
+    /*
+     * samples operation latencies and structural events at a fixed wall-clock interval, so
+     * latency spikes can be lined up with the splits and doublings causing them
+     *
+     * one row per interval: throughput, latency mean and percentiles, count and total
+     * duration of every event kind; complex splits, doublings, halvings and phase marks are
+     * listed one by one as well. A file ending in ".json" gets one JSON object, anything
+     * else CSV with the single events in "<file>.events.csv"
+     *
+     * hooks are static and do nothing while no timeline runs, at most one runs at a time
+     */
+    class Timeline
+    {
+    public:
+        Timeline(const std::string &file, uint64_t interval_ms, int thread_num);
+        Timeline() = delete;
+        Timeline(const Timeline &) = delete;
+        Timeline(Timeline &&) = delete;
+        ~Timeline();
+
+        bool Start() noexcept;
+        // samples the last partial interval and writes the file
+        void Stop() noexcept;
+
+        static bool Active() noexcept;
+        // nanoseconds on the steady clock
+        static uint64_t Now() noexcept;
+        // latency of one operation done by worker thread_id
+        static void Operation(int thread_id, uint64_t latency) noexcept;
+        static void Record(Event event, uint64_t start, uint64_t duration) noexcept;
+        // begin of a bench phase, e.g. "load" or "run"
+        static void Mark(const std::string &phase) noexcept;
+
+    private:
+        // log-linear buckets: exact below 16ns, 8 sub-buckets per power of two above
+        static constexpr int HISTOGRAM_SIZE = 16 + 60 * 8;
+        static constexpr int EVENT_KINDS = 6;
+
+        // written by its worker only, padded against false sharing
+        struct alignas(64) Recorder
+        {
+            std::atomic<uint64_t> counts[HISTOGRAM_SIZE];
+            std::atomic<uint64_t> total;
+        };
+
+        struct Sample
+        {
+            double time;
+            uint64_t ops;
+            double throughput;
+            double mean;
+            double p50;
+            double p99;
+            double p999;
+            uint64_t events[EVENT_KINDS];
+            double durations[EVENT_KINDS];
+        };
+
+        struct Single
+        {
+            Event event;
+            double time;
+            double duration;
+            std::string phase;
+        };
+
+        static std::atomic<Timeline *> active;
+        /*
+         * Record and Mark calls between loading active and appending, Stop waits for them.
+         * Operation goes without, its callers are workers joined before the timeline stops
+         */
+        static std::atomic_int recording;
+
+        std::string file;
+        uint64_t interval;
+        uint64_t begin;
+        std::vector<Recorder> recorders;
+        std::atomic<uint64_t> event_counts[EVENT_KINDS];
+        std::atomic<uint64_t> event_durations[EVENT_KINDS];
+
+        std::mutex lock;
+        std::vector<Single> singles;
+        std::vector<Sample> samples;
+        std::atomic_bool running;
+        std::mutex wakeup_lock;
+        std::condition_variable wakeup;
+        std::thread sampler;
+
+        std::vector<uint64_t> last_counts;
+        uint64_t last_total;
+        uint64_t last_events[EVENT_KINDS];
+        uint64_t last_durations[EVENT_KINDS];
+        uint64_t last_time;
+
+        static int bucket_of(uint64_t latency) noexcept;
+        static uint64_t value_of(int bucket) noexcept;
+        void sample() noexcept;
+        void write_csv() noexcept;
+        void write_json() noexcept;
+    };
+} // namespace Dalea
+#endif
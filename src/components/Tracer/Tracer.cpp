@@ -0,0 +1,124 @@
+#include "Tracer.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+namespace Dalea
+{
+    std::atomic<Tracer *> Tracer::active = nullptr;
+    std::atomic_int Tracer::recording = 0;
+    std::atomic<uint64_t> Tracer::runs = 0;
+
+    // buffer of the calling thread and the run it was made for
+    static thread_local std::pair<uint64_t, void *> thread_buffer = {0, nullptr};
+
+    Tracer::Tracer(const std::string &f) : file(f), begin(0), run(0), running(false)
+    {
+    }
+
+    Tracer::~Tracer()
+    {
+        Stop();
+    }
+
+    bool Tracer::Start() noexcept
+    {
+        if (running || active.load(std::memory_order_relaxed) != nullptr)
+        {
+            std::cout << "another tracer is running\n";
+            return false;
+        }
+        // set before publishing, a span may see this tracer as soon as the exchange succeeds
+        run = ++runs;
+        begin = now();
+        Tracer *expected = nullptr;
+        if (!active.compare_exchange_strong(expected, this, std::memory_order_release, std::memory_order_relaxed))
+        {
+            std::cout << "another tracer is running\n";
+            return false;
+        }
+        running = true;
+        return true;
+    }
+
+    void Tracer::Stop() noexcept
+    {
+        if (!running)
+        {
+            return;
+        }
+        running = false;
+        active = nullptr;
+        while (recording != 0)
+        {
+            std::this_thread::yield();
+        }
+        write_json();
+        std::cout << "trace written to " << file << "\n";
+    }
+
+    bool Tracer::Active() noexcept
+    {
+        return active.load(std::memory_order_relaxed) != nullptr;
+    }
+
+    uint64_t Tracer::now() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void Tracer::finish(const Span &span) noexcept
+    {
+        auto end = now();
+        ++recording;
+        auto t = active.load();
+        // a span started before Start or ending after Stop is left out
+        if (t != nullptr && span.start >= t->begin)
+        {
+            t->buffer()->records.push_back({span.name, span.arg_name, span.arg, span.start, end - span.start});
+        }
+        --recording;
+    }
+
+    Tracer::Buffer *Tracer::buffer() noexcept
+    {
+        if (thread_buffer.first == run)
+        {
+            return static_cast<Buffer *>(thread_buffer.second);
+        }
+        std::lock_guard<std::mutex> _(lock);
+        buffers.push_back(std::make_unique<Buffer>());
+        auto b = buffers.back().get();
+        b->thread = buffers.size() - 1;
+        thread_buffer = {run, b};
+        return b;
+    }
+
+    // complete events ("ph": "X") in microseconds since Start, one track per thread
+    void Tracer::write_json() noexcept
+    {
+        std::ofstream out(file, std::ios::trunc);
+        out << std::fixed << std::setprecision(3);
+        out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+        bool first = true;
+        for (const auto &b : buffers)
+        {
+            out << (first ? "\n  " : ",\n  ") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": "
+                << b->thread << ", \"args\": {\"name\": \"thread " << b->thread << "\"}}";
+            first = false;
+            for (const auto &r : b->records)
+            {
+                out << ",\n  {\"name\": \"" << r.name << "\", \"cat\": \"dalea\", \"ph\": \"X\", \"pid\": 0, \"tid\": "
+                    << b->thread << ", \"ts\": " << (r.start - begin) / 1000.0 << ", \"dur\": " << r.duration / 1000.0;
+                if (r.arg_name != nullptr)
+                {
+                    out << ", \"args\": {\"" << r.arg_name << "\": " << r.arg << "}";
+                }
+                out << "}";
+            }
+        }
+        out << "\n]}\n";
+    }
+} // namespace Dalea
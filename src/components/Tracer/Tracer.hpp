@@ -0,0 +1,95 @@
+#ifndef __DALEA__TRACER__TRACER__
+#define __DALEA__TRACER__TRACER__
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+namespace Dalea
+{
+    /*
+     * scoped spans around the phases of splits, doublings and allocations, written as a
+     * Chrome trace (chrome://tracing, Perfetto) so a slow operation can be broken down
+     *
+     * every thread appends finished spans to a buffer of its own, nested spans show up
+     * stacked. Spans cost one relaxed load while no tracer runs, at most one runs at a time
+     */
+    class Tracer
+    {
+    public:
+        Tracer(const std::string &file);
+        Tracer() = delete;
+        Tracer(const Tracer &) = delete;
+        Tracer(Tracer &&) = delete;
+        ~Tracer();
+
+        bool Start() noexcept;
+        // waits for spans being recorded, then writes the file
+        void Stop() noexcept;
+
+        static bool Active() noexcept;
+
+        // times its scope; name and arg_name must be literals, they are kept as pointers
+        class Span
+        {
+        public:
+            explicit Span(const char *n, const char *an = nullptr, uint64_t a = 0) noexcept
+                : name(n), arg_name(an), arg(a), start(Active() ? now() : 0){};
+            Span(const Span &) = delete;
+            Span &operator=(const Span &) = delete;
+
+            ~Span()
+            {
+                if (start != 0)
+                {
+                    Tracer::finish(*this);
+                }
+            }
+
+        private:
+            friend class Tracer;
+
+            const char *name;
+            const char *arg_name;
+            uint64_t arg;
+            uint64_t start;
+        };
+
+    private:
+        struct Record
+        {
+            const char *name;
+            const char *arg_name;
+            uint64_t arg;
+            uint64_t start;
+            uint64_t duration;
+        };
+
+        // only its thread appends, Stop reads once no span is being recorded
+        struct Buffer
+        {
+            uint32_t thread;
+            std::vector<Record> records;
+        };
+
+        static std::atomic<Tracer *> active;
+        // spans between loading active and appending, Stop waits for them
+        static std::atomic_int recording;
+        // tells threads their cached buffer belongs to an earlier run
+        static std::atomic<uint64_t> runs;
+
+        std::string file;
+        uint64_t begin;
+        uint64_t run;
+        bool running;
+        std::mutex lock;
+        std::vector<std::unique_ptr<Buffer>> buffers;
+
+        static uint64_t now() noexcept;
+        static void finish(const Span &span) noexcept;
+        Buffer *buffer() noexcept;
+        void write_json() noexcept;
+    };
+} // namespace Dalea
+#endif
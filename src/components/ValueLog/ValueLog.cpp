@@ -0,0 +1,201 @@
+#include "ValueLog.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+namespace Dalea
+{
+    static std::atomic<uint64_t> next_log_id(1);
+
+    // cursors of the calling thread by log id, its open chunks are sealed when it exits
+    struct LogCursors
+    {
+        std::vector<std::pair<uint64_t, ValueLog::Cursor *>> entries;
+
+        ~LogCursors()
+        {
+            for (const auto &e : entries)
+            {
+                if (e.second->current != nullptr)
+                {
+                    e.second->current->state = ValueLog::ChunkState::Sealed;
+                }
+            }
+        }
+    };
+
+    static thread_local LogCursors thread_cursors;
+
+    ValueLog::ValueLog(ChunkList &c) : id(next_log_id++), chunks(c), chunk_count(0)
+    {
+        for (auto &t : tables)
+        {
+            t.store(nullptr, std::memory_order_relaxed);
+        }
+        std::lock_guard<std::mutex> _(lock);
+        const auto &list = chunks;
+        for (size_t i = 0; i < list.size(); i++)
+        {
+            auto chunk = attach(list[i]);
+            chunk->tail = chunk->size;
+            chunk->state = ChunkState::Sealed;
+        }
+    }
+
+    KVPair::ValueRef ValueLog::Append(PoolBase &pop, std::string_view value) noexcept
+    {
+        auto c = cursor();
+        auto chunk = c->current;
+        if (chunk == nullptr || chunk->tail + value.size() > chunk->size)
+        {
+            chunk = take(pop, chunk, value.size());
+            c->current = chunk;
+        }
+        auto offset = chunk->tail;
+        memcpy(chunk->base + offset, value.data(), value.size());
+        Persist(pop, chunk->base + offset, value.size());
+        chunk->tail = (offset + value.size() + 7) & ~7UL;
+        chunk->live += value.size();
+        Metrics::Add(Metric::LoggedValues);
+        return {Backend::At<char>(chunk->ptr, offset), chunk->id};
+    }
+
+    void ValueLog::Release(const KVPair::ValueRef &ref, uint64_t size) noexcept
+    {
+        chunk_of(ref.chunk)->live -= size;
+    }
+
+    void ValueLog::Mark(const KVPair::ValueRef &ref, uint64_t size) noexcept
+    {
+        if (ref.chunk < chunk_count)
+        {
+            chunk_of(ref.chunk)->live += size;
+        }
+    }
+
+    uint64_t ValueLog::Select() noexcept
+    {
+        std::lock_guard<std::mutex> _(lock);
+        for (auto chunk : retired)
+        {
+            chunk->state = ChunkState::Free;
+            free_chunks.push_back(chunk);
+        }
+        retired.clear();
+
+        for (uint32_t i = 0; i < chunk_count; i++)
+        {
+            auto chunk = chunk_of(i);
+            if (chunk->state == ChunkState::Sealed && chunk->live <= COLLECT_RATIO * (chunk->size - HEADER_BYTES))
+            {
+                chunk->state = ChunkState::Victim;
+                victims.push_back(chunk);
+            }
+        }
+        return victims.size();
+    }
+
+    uint64_t ValueLog::VictimBytes() const noexcept
+    {
+        uint64_t bytes = 0;
+        for (auto chunk : victims)
+        {
+            bytes += chunk->live;
+        }
+        return bytes;
+    }
+
+    bool ValueLog::Collecting(const KVPair::ValueRef &ref) const noexcept
+    {
+        return chunk_of(ref.chunk)->state.load(std::memory_order_relaxed) == ChunkState::Victim;
+    }
+
+    uint64_t ValueLog::Retire() noexcept
+    {
+        std::lock_guard<std::mutex> _(lock);
+        auto n = victims.size();
+        for (auto chunk : victims)
+        {
+            chunk->state = ChunkState::Retired;
+            retired.push_back(chunk);
+        }
+        victims.clear();
+        return n;
+    }
+
+    ValueLog::Chunk *ValueLog::chunk_of(uint32_t chunk_id) const noexcept
+    {
+        auto table = tables[chunk_id >> CHUNK_BITS].load(std::memory_order_acquire);
+        return table[chunk_id & ((1U << CHUNK_BITS) - 1)].load(std::memory_order_acquire);
+    }
+
+    ValueLog::Chunk *ValueLog::attach(const Backend::Ptr<char[]> &ptr) noexcept
+    {
+        auto chunk_id = chunk_count.load();
+        if ((chunk_id >> CHUNK_BITS) >= TABLES)
+        {
+            std::cout << "too many value log chunks\n";
+            std::abort();
+        }
+        auto &table = tables[chunk_id >> CHUNK_BITS];
+        if (table.load() == nullptr)
+        {
+            table.store(new std::atomic<Chunk *>[1U << CHUNK_BITS]());
+        }
+
+        auto chunk = new Chunk;
+        chunk->ptr = ptr;
+        chunk->base = ptr.get();
+        chunk->id = chunk_id;
+        chunk->size = *reinterpret_cast<const uint64_t *>(ptr.get());
+        chunk->tail = HEADER_BYTES;
+        chunk->live = 0;
+        chunk->state = ChunkState::Open;
+        table.load()[chunk_id & ((1U << CHUNK_BITS) - 1)].store(chunk, std::memory_order_release);
+        ++chunk_count;
+        return chunk;
+    }
+
+    ValueLog::Chunk *ValueLog::take(PoolBase &pop, Chunk *full, uint64_t size) noexcept
+    {
+        std::lock_guard<std::mutex> _(lock);
+        if (full != nullptr)
+        {
+            full->state = ChunkState::Sealed;
+        }
+        if (!free_chunks.empty() && HEADER_BYTES + size <= free_chunks.back()->size)
+        {
+            auto chunk = free_chunks.back();
+            free_chunks.pop_back();
+            chunk->tail = HEADER_BYTES;
+            chunk->state = ChunkState::Open;
+            return chunk;
+        }
+
+        auto bytes = std::max(CHUNK_BYTES, HEADER_BYTES + size);
+        Backend::Ptr<char[]> ptr = nullptr;
+        Backend::Run(pop, [&]() {
+            ptr = Backend::Make<char[]>(bytes);
+            *reinterpret_cast<uint64_t *>(ptr.get()) = bytes;
+            Persist(pop, ptr.get(), sizeof(uint64_t));
+            chunks.push_back(ptr);
+        });
+        return attach(ptr);
+    }
+
+    ValueLog::Cursor *ValueLog::cursor() noexcept
+    {
+        for (const auto &e : thread_cursors.entries)
+        {
+            if (e.first == id)
+            {
+                return e.second;
+            }
+        }
+        std::lock_guard<std::mutex> _(lock);
+        cursors.push_back(std::make_unique<Cursor>());
+        auto c = cursors.back().get();
+        thread_cursors.entries.emplace_back(id, c);
+        return c;
+    }
+} // namespace Dalea
@@ -0,0 +1,107 @@
+#ifndef __DALEA__VALUELOG__VALUELOG__
+#define __DALEA__VALUELOG__VALUELOG__
+#include "KVPair/KVPair.hpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+namespace Dalea
+{
+    using ChunkList = Backend::Vector<Backend::Ptr<char[]>>;
+
+    /*
+     * per-thread append-only chunks in PM for values too large to be copied along with their
+     * records, so that an update writes its value once and sequentially, and the old one dies
+     * by accounting only. A value bigger than CHUNK_BYTES gets a chunk of its own
+     *
+     * chunks persist nothing but their size: the bytes live in a chunk are counted from the
+     * records pointing into it, by Append and Release at runtime and by Mark at open, every
+     * chunk found at open is sealed. Collection takes three steps, driven by the table:
+     * Select picks sealed chunks that are mostly dead, the table relocates every value that
+     * Collecting reports, Retire sets the victims aside and the next Select recycles them
+     */
+    class ValueLog
+    {
+    public:
+        static constexpr uint64_t CHUNK_BYTES = 1UL << 22;
+        // a sealed chunk with at most this share of its bytes live is collected
+        static constexpr double COLLECT_RATIO = 0.5;
+
+        // chunks is the persistent list chunks are registered in, those in there are sealed
+        ValueLog(ChunkList &chunks);
+        ValueLog() = delete;
+        ValueLog(const ValueLog &) = delete;
+        ValueLog(ValueLog &&) = delete;
+
+        // value persisted in the chunk of the calling thread
+        KVPair::ValueRef Append(PoolBase &pop, std::string_view value) noexcept;
+        // the record holding ref is freed
+        void Release(const KVPair::ValueRef &ref, uint64_t size) noexcept;
+        // the record holding ref survived a restart
+        void Mark(const KVPair::ValueRef &ref, uint64_t size) noexcept;
+
+        // recycles the victims of the last pass and picks new ones, returns their number
+        uint64_t Select() noexcept;
+        // bytes still live in the victims, nothing to relocate if zero
+        uint64_t VictimBytes() const noexcept;
+        bool Collecting(const KVPair::ValueRef &ref) const noexcept;
+        // every live value of the victims is relocated, returns their number
+        uint64_t Retire() noexcept;
+
+    private:
+        static constexpr uint64_t HEADER_BYTES = 64;
+
+        enum class ChunkState
+        {
+            Free,
+            // a thread appends to it
+            Open,
+            Sealed,
+            Victim,
+            Retired,
+        };
+
+        struct Chunk
+        {
+            Backend::Ptr<char[]> ptr;
+            char *base;
+            uint32_t id;
+            uint64_t size;
+            // written by the thread the chunk is open for only
+            uint64_t tail;
+            std::atomic<uint64_t> live;
+            std::atomic<ChunkState> state;
+        };
+
+        struct Cursor
+        {
+            Chunk *current;
+        };
+
+        static constexpr int CHUNK_BITS = 12;
+        static constexpr int TABLES = 1 << 10;
+
+        uint64_t id;
+        ChunkList &chunks;
+        // guards chunks, free_chunks, victims, retired, cursors and making tables
+        std::mutex lock;
+        // chunk by id in two levels, so that Release and Collecting never take the lock
+        std::atomic<std::atomic<Chunk *> *> tables[TABLES];
+        std::atomic<uint32_t> chunk_count;
+        std::vector<Chunk *> free_chunks;
+        std::vector<Chunk *> victims;
+        std::vector<Chunk *> retired;
+        std::vector<std::unique_ptr<Cursor>> cursors;
+
+        Chunk *chunk_of(uint32_t chunk_id) const noexcept;
+        Chunk *attach(const Backend::Ptr<char[]> &ptr) noexcept;
+        // seals full, then an open chunk with room for size bytes
+        Chunk *take(PoolBase &pop, Chunk *full, uint64_t size) noexcept;
+        Cursor *cursor() noexcept;
+
+        friend struct LogCursors;
+    };
+} // namespace Dalea
+#endif
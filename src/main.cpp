@@ -1,45 +1,322 @@
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <memory>
 #include <numeric>
 #include <queue>
+#include <random>
 #include <sstream>
 #include <string>
 #include <thread>
 #include <vector>
 
+#include "Affinity.hpp"
 #include "CmdParser.hpp"
 #include "Dalea.hpp"
+#include "ShardedDalea.hpp"
+#include "Trace.hpp"
+#include "Workload.hpp"
 
 using namespace Dalea;
 
-const std::string PUT = "INSERT";
-const std::string GET = "READ";
-const std::string UPDATE = "UPDATE";
-const std::string DELETE = "DELETE";
-
 struct DaleaRoot
 {
-    pobj::persistent_ptr<HashTable> map;
+    Backend::Ptr<HashTable> map;
 };
 
-enum class Ops
+/*
+ * the bench replays CLevel-style text files unless a generator is given, then warmup
+ * inserts its initial records and the run phase draws operations from it
+ */
+static bool load_warmup(const std::string &warm_file, WorkloadGenerator *gen, int threads,
+                        const std::function<void(int, const std::string &, Stats &)> &put,
+                        std::vector<Stats> &stats, uint64_t &total, const Affinity *affinity)
 {
-    Insert,
-    Read,
-    Update,
-    Delete,
-};
+    // every line inserts, whatever its operation
+    Trace warmup;
+    if (gen)
+    {
+        total = gen->Spec().records;
+    }
+    else if (warmup.Load(warm_file, threads))
+    {
+        total = warmup.Items().size();
+    }
+    else
+    {
+        return false;
+    }
+
+    // one contiguous range of keys per thread, each inserting with its own thread id
+    stats.assign(threads, Stats());
+    auto worker = [&](int tid) {
+        if (affinity)
+        {
+            affinity->PinWorker(tid);
+        }
+        std::string key;
+        auto begin = total / threads * tid + std::min<uint64_t>(tid, total % threads);
+        auto end = begin + total / threads + (uint64_t(tid) < total % threads ? 1 : 0);
+        for (auto i = begin; i < end; i++)
+        {
+            if (gen)
+            {
+                key = gen->Key(i);
+            }
+            else
+            {
+                key.assign(warmup.Items()[i].key);
+            }
+            auto op_start = Timeline::Active() ? Timeline::Now() : 0;
+            put(tid, key, stats[tid]);
+            if (op_start)
+            {
+                Timeline::Operation(tid, Timeline::Now() - op_start);
+            }
+        }
+    };
+    // the main thread is not among them, so it is never pinned
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; i++)
+    {
+        workers.emplace_back(worker, i);
+    }
+    for (auto &t : workers)
+    {
+        t.join();
+    }
+    return true;
+}
 
-struct WorkloadItem
+/*
+ * the same keys and values as load_warmup, handed over at once to a bulk load instead of
+ * being inserted one by one
+ */
+static bool load_bulk(const std::string &warm_file, WorkloadGenerator *gen, int threads,
+                      const std::function<bool(const std::vector<BulkPair> &)> &bulk, uint64_t &total)
 {
-    Ops type;
-    std::string key;
+    Trace warmup;
+    std::vector<std::string> keys;
+    std::vector<std::string> values;
+    std::vector<BulkPair> pairs;
+    if (gen)
+    {
+        total = gen->Spec().records;
+        keys.reserve(total);
+        values.resize(total);
+        for (uint64_t i = 0; i < total; i++)
+        {
+            keys.push_back(gen->Key(i));
+            gen->Value(i, values[i]);
+            pairs.emplace_back(keys.back(), values[i]);
+        }
+    }
+    else if (warmup.Load(warm_file, threads))
+    {
+        total = warmup.Items().size();
+        pairs.reserve(total);
+        for (const auto &item : warmup.Items())
+        {
+            pairs.emplace_back(item.key, item.key);
+        }
+    }
+    else
+    {
+        return false;
+    }
 
-    WorkloadItem(const Ops &t, const std::string &k) : type(t), key(k){};
-};
+    if (!bulk(pairs))
+    {
+        std::cout << "bulk load failed\n";
+        return false;
+    }
+    return true;
+}
+
+static bool plan_affinity(Dalea::CmdParser &parser, Affinity &affinity)
+{
+    std::vector<int> worker_cpus;
+    std::vector<int> background_cpus;
+    auto placement = Placement::None;
+    int node = -1;
+    if (!parser.getOption("cpus").empty() && !Affinity::ParseCpuList(parser.getOption("cpus"), worker_cpus))
+    {
+        std::cout << "cpus should be a list like 0-3,8,10-11\n";
+        return false;
+    }
+    if (!parser.getOption("background").empty() && !Affinity::ParseCpuList(parser.getOption("background"), background_cpus))
+    {
+        std::cout << "background should be a list like 0-3,8,10-11\n";
+        return false;
+    }
+    if (!parser.getOption("placement").empty() && !Affinity::ParsePlacement(parser.getOption("placement"), placement))
+    {
+        std::cout << "placement should be one of none, compact and scatter\n";
+        return false;
+    }
+    if (!parser.getOption("node").empty())
+    {
+        auto str = parser.getOption("node");
+        if (str.find_first_not_of("0123456789") != std::string::npos || str.size() > 6)
+        {
+            std::cout << "node should be a number\n";
+            return false;
+        }
+        node = std::stoi(str);
+    }
+    return affinity.Plan(node, placement, worker_cpus, background_cpus);
+}
+
+// "flush_ns,fence_ns[,read_ns]", only builds with PM_EMULATION delay anything
+static bool configure_emulation(Dalea::CmdParser &parser)
+{
+    auto str = parser.getOption("emulate");
+    if (str.empty())
+    {
+        return true;
+    }
+    std::stringstream buf(str);
+    std::string part;
+    std::vector<uint64_t> ns;
+    while (getline(buf, part, ','))
+    {
+        if (part.empty() || part.size() > 9 || part.find_first_not_of("0123456789") != std::string::npos)
+        {
+            ns.clear();
+            break;
+        }
+        ns.push_back(std::stoull(part));
+    }
+    if (ns.size() != 2 && ns.size() != 3)
+    {
+        std::cout << "emulate should be flush_ns,fence_ns[,read_ns]\n";
+        return false;
+    }
+    PMEmulation::Configure(ns[0], ns[1], ns.size() == 3 ? ns[2] : 0);
+#ifdef PM_EMULATION
+    std::cout << "   emulating PM: " << ns[0] << "ns per flushed line, " << ns[1] << "ns per fence, "
+              << PMEmulation::read_ns << "ns per read line\n";
+#else
+    std::cout << "   emulate is ignored, PM_EMULATION is not defined\n";
+#endif
+    return true;
+}
+
+static bool load_run(Trace &trace, const std::string &run_file, WorkloadGenerator *gen, int threads)
+{
+    if (gen)
+    {
+        trace.Generate(*gen, gen->Spec().operations);
+        return true;
+    }
+    return trace.Load(run_file, threads);
+}
+
+// exact percentiles over the latencies of all workers, measured from due times
+static void report_open_loop(double rate, uint64_t ops, double duration, std::vector<double> *records, int threads)
+{
+    std::vector<double> all;
+    for (int i = 0; i < threads; i++)
+    {
+        all.insert(all.end(), records[i].begin(), records[i].end());
+    }
+    std::cout << "open loop: target " << rate << " ops/s, achieved " << double(ops) / duration * 1000000000.0 << " ops/s\n";
+    if (all.empty())
+    {
+        return;
+    }
+    std::sort(all.begin(), all.end());
+    auto at = [&](double rank) {
+        return all[std::min<size_t>(all.size() - 1, rank * all.size())];
+    };
+    std::cout << "open loop latency from due time (ns): mean " << std::accumulate(all.begin(), all.end(), 0.0) / all.size()
+              << ", p50 " << at(0.5) << ", p90 " << at(0.9) << ", p99 " << at(0.99) << ", p999 " << at(0.999)
+              << ", max " << all.back() << "\n";
+}
+
+// metrics is the difference of the snapshots around the phase, background threads included
+static void report_phase(const std::string &phase, uint64_t ops, double duration, const std::vector<Stats> &stats, const MetricsSnapshot &metrics)
+{
+    Stats total;
+    for (const auto &st : stats)
+    {
+        total += st;
+    }
+    std::cout << phase << " phase: " << ops << " operations in " << duration << " ns, throughput is "
+              << double(ops) / duration * 1000000000.0 << "\n";
+    std::cout << phase << " phase splits: " << total.simple_splits << " simple, "
+              << total.traditional_splits << " traditional, " << total.complex_splits << " complex, "
+              << total.flattens << " of them flattening ancestors\n";
+    std::cout << phase << " phase counters: ";
+    metrics.Show(std::cout);
+    auto lookups = metrics[Metric::CacheHits] + metrics[Metric::CacheMisses];
+    if (lookups != 0)
+    {
+        std::cout << phase << " phase cache hit ratio: " << double(metrics[Metric::CacheHits]) / lookups << "\n";
+    }
+    if (ops != 0)
+    {
+        std::cout << phase << " phase ancestor redirect ratio: " << double(metrics[Metric::AncestorRedirects]) / ops << "\n";
+    }
+}
+
+// values are the keys themselves when replaying files
+static const std::string &value_of(const WorkloadGenerator *gen, const std::string &key)
+{
+    if (gen == nullptr)
+    {
+        return key;
+    }
+    // every calling thread counts in a range of its own, so no two operations write the same value
+    static std::atomic<uint64_t> streams(0);
+    thread_local uint64_t n = (streams++ + 1) << 32;
+    thread_local std::string value;
+    gen->Value(n++, value);
+    return value;
+}
+
+static bool build_spec(Dalea::CmdParser &parser, WorkloadSpec &spec)
+{
+    try
+    {
+        spec.records = std::stoull(parser.getOption("records"));
+        if (!parser.getOption("operations").empty())
+        {
+            spec.operations = std::stoull(parser.getOption("operations"));
+        }
+        if (!parser.getOption("key_size").empty())
+        {
+            spec.key_size = std::stoi(parser.getOption("key_size"));
+        }
+        if (!parser.getOption("value_size").empty())
+        {
+            spec.value_size = std::stoi(parser.getOption("value_size"));
+        }
+        if (!parser.getOption("seed").empty())
+        {
+            spec.seed = std::stoull(parser.getOption("seed"));
+        }
+    }
+    catch (const std::exception &)
+    {
+        std::cout << "records, operations, key_size, value_size and seed should be numbers\n";
+        return false;
+    }
+    if (!parser.getOption("mix").empty() && !spec.ParseMix(parser.getOption("mix")))
+    {
+        std::cout << "mix should be read:insert:update:delete percentages summing up to 100\n";
+        return false;
+    }
+    if (!parser.getOption("distribution").empty() && !spec.ParseDistribution(parser.getOption("distribution")))
+    {
+        std::cout << "distribution should be one of uniform, zipfian, latest and hotspot\n";
+        return false;
+    }
+    return true;
+}
 
 static std::string new_string(uint64_t i)
 {
@@ -47,23 +324,46 @@ static std::string new_string(uint64_t i)
     return prefix + std::to_string(i);
 }
 
-auto prepare_pool(std::string &file, size_t size)
+auto prepare_pool(std::string &file, size_t size, bool reopen)
 {
+#ifdef DRAM_BACKEND
+    // nothing is persisted, the empty pool handle is only passed along
+    return pobj::pool<DaleaRoot>();
+#else
+    if (reopen)
+    {
+        return pobj::pool<DaleaRoot>::open(file, "Dalea");
+    }
     remove(file.c_str());
     auto pop = pobj::pool<DaleaRoot>::create(file, "Dalea", PMEMOBJ_MIN_POOL * 10240, S_IWUSR | S_IRUSR);
     return pop;
+#endif
 }
 
-auto prepare_root(pobj::pool<DaleaRoot> &pop, int thread_num)
+auto prepare_root(pobj::pool<DaleaRoot> &pop, int thread_num, uint64_t reserve, bool reopen)
 {
+#ifdef DRAM_BACKEND
+    auto r = Backend::Make<DaleaRoot>();
+#else
     auto r = pop.root();
-    TX::run(pop, [&]() {
-        r->map = pobj::make_persistent<HashTable>(pop, thread_num);
+#endif
+    if (reopen)
+    {
+        // volatile parts are rebuilt from the pairs, those parked before the restart are linked
+        auto start = std::chrono::steady_clock::now();
+        r->map->Recover(pop, thread_num);
+        auto end = std::chrono::steady_clock::now();
+        std::cout << "recovered in " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms\n";
+        return r;
+    }
+    Backend::Run(pop, [&]() {
+        r->map = Backend::Make<HashTable>(pop, thread_num, reserve);
     });
     return r;
 }
 
-void debug(PoolBase &pop, pobj::persistent_ptr<DaleaRoot> &r, int batch, int num_threads)
+// a reopened pool already holds the batch, it is only checked
+void debug(PoolBase &pop, Backend::Ptr<DaleaRoot> &r, int batch, int num_threads, bool reopen)
 {
     auto worker = [&](int id, int start, int end) {
         Stats __unused;
@@ -73,16 +373,19 @@ void debug(PoolBase &pop, pobj::persistent_ptr<DaleaRoot> &r, int batch, int num
             r->map->Put(pop, __unused, id, key, key);
         }
     };
-    auto part = batch / num_threads;
-    std::thread workers[num_threads];
-    for (auto i = 0; i < num_threads; i++)
+    if (!reopen)
     {
-        workers[i] = std::thread(worker, i, i * part, (i + 1) * part);
-    }
+        auto part = batch / num_threads;
+        std::thread workers[num_threads];
+        for (auto i = 0; i < num_threads; i++)
+        {
+            workers[i] = std::thread(worker, i, i * part, (i + 1) * part);
+        }
 
-    for (auto & t : workers)
-    {
-        t.join();
+        for (auto & t : workers)
+        {
+            t.join();
+        }
     }
     bool pass = true;
     long i = 0;
@@ -99,11 +402,11 @@ void debug(PoolBase &pop, pobj::persistent_ptr<DaleaRoot> &r, int batch, int num
             r->map->Log(buf);
             pass = false;
         }
-        else if (ptr->value != value)
+        else if (ptr->Value() != value)
         {
             buf << "wrong value for key " << key << "\n";
             buf << "expecting " << value << "\n";
-            buf << "got " << ptr->value.c_str() << "\n";
+            buf << "got " << ptr->Value() << "\n";
             std::cout << buf.str();
             r->map->Log(buf);
             pass = false;
@@ -120,6 +423,46 @@ void debug(PoolBase &pop, pobj::persistent_ptr<DaleaRoot> &r, int batch, int num
     }
 }
 
+/*
+ * open-loop arrivals of one worker: operations are due at constant or exponentially
+ * distributed (Poisson) intervals, whether earlier ones have returned or not
+ */
+struct Arrivals
+{
+    double interval; // mean nanoseconds between two operations
+    bool poisson;
+    std::mt19937_64 rng;
+    double due;
+
+    Arrivals(double rate, bool p, uint64_t seed) : interval(1000000000.0 / rate), poisson(p), rng(seed), due(0){};
+
+    // nanoseconds from the start of the phase
+    double Next() noexcept
+    {
+        due += poisson ? std::exponential_distribution<double>(1.0 / interval)(rng) : interval;
+        return due;
+    }
+};
+
+static void wait_until(const std::chrono::time_point<std::chrono::steady_clock> &due)
+{
+    using namespace std::chrono_literals;
+    auto now = std::chrono::steady_clock::now();
+    // sleeping is coarse, so only sleep through long gaps and spin the rest
+    if (due - now > 200us)
+    {
+        std::this_thread::sleep_for(due - now - 100us);
+    }
+    while (std::chrono::steady_clock::now() < due)
+        ;
+}
+
+/*
+ * closed loop without arrivals: the next operation is issued once the previous returns.
+ * With arrivals latency counts from when an operation was due, so a stall is charged to
+ * every operation queued behind it instead of being omitted; every such latency is kept
+ * in record then
+ */
 void bench_thread(std::function<void(const WorkloadItem &, Stats &, int)> func,
                   int tid,
                   std::vector<Stats> &stats,
@@ -128,7 +471,9 @@ void bench_thread(std::function<void(const WorkloadItem &, Stats &, int)> func,
                   std::vector<double> &latency,
                   std::vector<double> &p90,
                   std::vector<double> &p99,
-                  std::vector<double> &p999)
+                  std::vector<double> &p999,
+                  Arrivals *arrivals,
+                  std::vector<double> &record)
 {
     auto sampling_batch = 20000;
     auto counter = 0;
@@ -137,11 +482,25 @@ void bench_thread(std::function<void(const WorkloadItem &, Stats &, int)> func,
 
     std::chrono::time_point<std::chrono::steady_clock> lat_start;
     std::chrono::time_point<std::chrono::steady_clock> lat_end;
+    auto phase_start = std::chrono::steady_clock::now();
+    auto batch_start = phase_start;
     double time_elapsed = 0;
     Stats st;
+    if (arrivals)
+    {
+        record.reserve(workload.size());
+    }
     for (const auto &i : workload)
     {
-        lat_start = std::chrono::steady_clock::now();
+        if (arrivals)
+        {
+            lat_start = phase_start + std::chrono::nanoseconds(uint64_t(arrivals->Next()));
+            wait_until(lat_start);
+        }
+        else
+        {
+            lat_start = std::chrono::steady_clock::now();
+        }
 
         func(i, st, tid);
 
@@ -149,9 +508,17 @@ void bench_thread(std::function<void(const WorkloadItem &, Stats &, int)> func,
         time_elapsed += (lat_end - lat_start).count();
         tail.push((lat_end - lat_start).count());
         latencies.push_back((lat_end - lat_start).count()); // in nanoseconds
+        Timeline::Operation(tid, (lat_end - lat_start).count());
+        if (arrivals)
+        {
+            record.push_back((lat_end - lat_start).count());
+        }
         if (++counter == sampling_batch)
         {
-            throughput.push_back(sampling_batch / time_elapsed * 1000000000.0);
+            // latencies overlap with waiting in open loop, wall time is what counts there
+            auto elapsed = arrivals ? (lat_end - batch_start).count() : time_elapsed;
+            batch_start = lat_end;
+            throughput.push_back(sampling_batch / elapsed * 1000000000.0);
             latency.push_back(std::accumulate(latencies.cbegin(), latencies.cend(), 0.0) / sampling_batch);
 
             double tmp_p90 = 0, tmp_p99 = 0, tmp_p999 = 0;
@@ -187,46 +554,431 @@ void bench_thread(std::function<void(const WorkloadItem &, Stats &, int)> func,
             st.Clear();
         }
     }
+    // splits of the last partial batch still count for the phase
+    if (counter != 0)
+    {
+        stats.push_back(st);
+    }
+}
+
+/*
+ * pool_files is a comma-separated list with one path per NUMA node. Thread t runs on node
+ * t % nodes and is handed the run items whose shard lives on its node whenever that node
+ * has any thread
+ */
+int sharded_bench(const std::string &pool_files, const std::string &warm_file, const std::string &run_file, WorkloadGenerator *gen, int threads, int shard_num, bool bulk, uint64_t cache, uint64_t reserve, uint64_t flatten, Timeline *timeline, Tracer *tracer)
+{
+    std::vector<std::string> files;
+    std::stringstream list(pool_files);
+    std::string file;
+    while (getline(list, file, ','))
+    {
+        files.push_back(file);
+    }
+    if (files.empty() || shard_num < 1)
+    {
+        std::cout << "please offer at least one pool file and one shard\n";
+        return -1;
+    }
+
+    ShardedHashTable map(files, shard_num, threads, PMEMOBJ_MIN_POOL * 10240, reserve);
+    auto nodes = map.NodeNum();
+    std::cout << "   " << shard_num << " shards over " << nodes << " nodes\n";
+    for (int i = 0; i < shard_num && cache; i++)
+    {
+        map.Shard(i).EnableCache(std::max<uint64_t>(1, cache / shard_num));
+    }
+    for (int i = 0; i < shard_num; i++)
+    {
+        map.Shard(i).EnableFlattening(flatten);
+    }
+
+#ifndef DEBUG
+    bool to_stop = false;
+    auto guardian = [&](int shard) {
+        ShardedHashTable::BindToNode(map.NodeOf(shard));
+        auto &queue = map.Shard(shard).segment_pool;
+        auto &pop = map.Pool(shard);
+        while (!to_stop)
+        {
+            while (queue.HasSpace())
+            {
+                Backend::Run(pop, [&]() {
+                    auto ptr = Backend::Make<Segment>(pop, 0, 0, false);
+                    queue.Push(ptr);
+                });
+            }
+        }
+    };
+    for (int i = 0; i < shard_num; i++)
+    {
+        std::thread(guardian, i).detach();
+    }
+#endif
+
+    if (timeline)
+    {
+        timeline->Start();
+    }
+    if (tracer)
+    {
+        tracer->Start();
+    }
+    Timeline::Mark("load");
+    std::cout << "warming up\n";
+    std::vector<Stats> load_stats;
+    uint64_t load_count = 0;
+    auto load_metrics = Metrics::Aggregate();
+    auto load_start = std::chrono::steady_clock::now();
+    auto warmed = bulk ? load_bulk(warm_file, gen, threads, [&](const std::vector<BulkPair> &pairs) {
+        return map.BulkLoad(pairs, threads) == FunctionStatus::Ok;
+    }, load_count)
+                       : load_warmup(warm_file, gen, threads, [&](int tid, const std::string &key, Stats &st) {
+        map.Put(st, tid, key, value_of(gen, key));
+    }, load_stats, load_count, nullptr);
+    auto load_end = std::chrono::steady_clock::now();
+    Trace run;
+    if (!warmed || !load_run(run, run_file, gen, threads))
+    {
+        return -1;
+    }
+    report_phase("load", load_count, (load_end - load_start).count(), load_stats, Metrics::Aggregate() - load_metrics);
+
+    std::vector<std::vector<int>> local_threads(nodes);
+    for (int i = 0; i < threads; i++)
+    {
+        local_threads[i % nodes].push_back(i);
+    }
+    std::vector<WorkloadItem> workloads[threads];
+    std::vector<int> next(nodes, 0);
+    auto count = 0;
+    auto load = run.Items().size();
+    for (const auto &item : run.Items())
+    {
+        auto node = map.NodeOf(map.ShardOf(item.key));
+        auto &candidates = local_threads[node];
+        auto tid = candidates.empty() ? (count++) % threads : candidates[(next[node]++) % candidates.size()];
+        workloads[tid].push_back(item);
+    }
+
+    std::vector<uint64_t> shard_ops[threads];
+    std::vector<Stats> run_stats(threads);
+    auto worker = [&](int tid) {
+        ShardedHashTable::BindToNode(tid % nodes);
+        auto &st = run_stats[tid];
+        auto &ops = shard_ops[tid];
+        ops.assign(shard_num, 0);
+        std::string key;
+        for (const auto &item : workloads[tid])
+        {
+            key.assign(item.key);
+            auto op_start = Timeline::Active() ? Timeline::Now() : 0;
+            switch (item.type)
+            {
+            case Ops::Insert:
+            case Ops::Update:
+                map.Put(st, tid, key, value_of(gen, key));
+                break;
+            case Ops::Read:
+                map.Get(key);
+                break;
+            case Ops::Delete:
+                map.Remove(key);
+                break;
+            default:
+                break;
+            }
+            if (op_start)
+            {
+                Timeline::Operation(tid, Timeline::Now() - op_start);
+            }
+            ++ops[map.ShardOf(key)];
+        }
+    };
+
+    std::cout << "starts running\n";
+    Timeline::Mark("run");
+    std::thread workers[threads];
+    auto run_metrics = Metrics::Aggregate();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < threads; i++)
+    {
+        workers[i] = std::thread(worker, i);
+    }
+    for (auto &t : workers)
+    {
+        t.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+    auto duration = (end - start).count();
+    std::cout << "time elapsed is " << duration << "\n";
+    std::cout << "throughput is " << double(load) / duration * 1000000000.0 << "\n";
+    report_phase("run", load, duration, run_stats, Metrics::Aggregate() - run_metrics);
+    if (timeline)
+    {
+        timeline->Stop();
+    }
+    if (tracer)
+    {
+        tracer->Stop();
+    }
+
+    std::cout << "\nreporting throughput by shard:\n";
+    for (int i = 0; i < shard_num; i++)
+    {
+        uint64_t ops = 0;
+        for (int j = 0; j < threads; j++)
+        {
+            ops += shard_ops[j][i];
+        }
+        std::cout << "shard " << i << " (node " << map.NodeOf(i) << "): "
+                  << ops << " ops, " << double(ops) / duration * 1000000000.0 << "\n";
+    }
+#ifndef DEBUG
+    to_stop = true;
+#endif
+    return 0;
 }
 
 int main(int argc, char *argv[])
 {
     Dalea::CmdParser parser;
-    if (argc < 4 || !parser.buildCmdParser(argc, argv))
+    // decoding a log is the only mode with a single option
+    if (argc < 3 || !parser.buildCmdParser(argc, argv) || (argc < 4 && parser.getOption("decode_log").empty()))
     {
-        std::cout << "usage: ./target/Dalea -p pool_file -w warmup_file -r run_file -t threads -b batch\n";
+        std::cout << "usage: ./target/Dalea -p pool_file -w warmup_file -r run_file -t threads -b batch [-l 1] [-g timeline.csv|timeline.json [-i ms]] [-T trace.json] [-C cache_pairs]\n"
+                  << "                      [-a worker_cpus] [-x none|compact|scatter] [-u node] [-y background_cpus]\n"
+                  << "                      [-q ops_per_second [-j constant|poisson]] [-f flush_ns,fence_ns[,read_ns]] [-V value_log_bytes]\n"
+                  << "                      [-R reserved_pairs] [-S split_workers] [-F flatten_pairs] [-M shrink_ms] [-O 1]\n";
+        std::cout << "       ./target/Dalea -p pool_file[,pool_file...] -w warmup_file -r run_file -t threads -b batch -s shards [-l 1]\n";
+        std::cout << "       ./target/Dalea -p pool_file -n records -o operations [-m read:insert:update:delete]\n"
+                  << "                      [-d uniform|zipfian|latest|hotspot] [-k key_size] [-v value_size] [-e seed] -t threads -b batch\n";
+        std::cout << "       ./target/Dalea -r text_file -c binary_file [-t threads]\n";
+        std::cout << "       ./target/Dalea -z log_file\n";
         return -1;
     }
 
+    // converting a text trace into a binary one needs no pool
+    auto convert = parser.getOption("convert");
+    if (!convert.empty())
+    {
+        auto parsers = parser.getOption("threads").empty() ? std::thread::hardware_concurrency() : std::stoi(parser.getOption("threads"));
+        return Trace::Convert(parser.getOption("run_file"), convert, parsers) ? 0 : -1;
+    }
+
+    // so is turning a binary log of a LOGGING build into text
+    auto decode_log = parser.getOption("decode_log");
+    if (!decode_log.empty())
+    {
+        return Dalea::Logger::Decode(decode_log, std::cout) ? 0 : -1;
+    }
+
     auto pool_file = parser.getOption("pool_file");
     auto warm_file = parser.getOption("warm_file");
     auto run_file = parser.getOption("run_file");
     auto threads = std::stoi(parser.getOption("threads"));
     auto batch = std::stol(parser.getOption("batch"));
+    // any value but 0 bulk loads the warmup keys, e.g. -l 1
+    auto bulk = !parser.getOption("bulk").empty() && parser.getOption("bulk") != "0";
 
     std::cout << "[[ bench info: \n";
     std::cout << "   pool file is " << pool_file << "\n";
+#ifdef DRAM_BACKEND
+    std::cout << "   DRAM backend, the pool file is not used and nothing is persisted\n";
+#endif
     std::cout << "   warm file is " << warm_file << "\n";
     std::cout << "   run file is " << run_file << "\n";
     std::cout << "   threads is " << threads << "\n";
     std::cout << "   batch size is " << batch << "\n";
+    std::cout << "   warmup is " << (bulk ? "bulk loaded" : "inserted") << "\n";
+
+    // the generator replaces warm and run files
+    std::unique_ptr<WorkloadGenerator> gen;
+    if (!parser.getOption("records").empty())
+    {
+        WorkloadSpec spec;
+        if (!build_spec(parser, spec))
+        {
+            return -1;
+        }
+        gen = std::make_unique<WorkloadGenerator>(spec);
+        std::cout << "   generating " << spec.records << " records and " << spec.operations << " operations"
+                  << ", mix " << spec.mix[0] << ":" << spec.mix[1] << ":" << spec.mix[2] << ":" << spec.mix[3]
+                  << ", distribution " << (parser.getOption("distribution").empty() ? "zipfian" : parser.getOption("distribution"))
+                  << ", key size " << spec.key_size << ", value size " << spec.value_size
+                  << ", seed " << spec.seed << "\n";
+    }
+
+    Affinity affinity;
+    if (!plan_affinity(parser, affinity))
+    {
+        return -1;
+    }
+    if (!configure_emulation(parser))
+    {
+        return -1;
+    }
+
+    // aggregate operations per second over all workers, 0 keeps the closed loop
+    double rate = 0;
+    auto poisson = parser.getOption("arrival") == "poisson";
+    if (!parser.getOption("rate").empty())
+    {
+        try
+        {
+            rate = std::stod(parser.getOption("rate"));
+        }
+        catch (const std::exception &)
+        {
+            rate = -1;
+        }
+        if (rate <= 0 || (!parser.getOption("arrival").empty() && !poisson && parser.getOption("arrival") != "constant"))
+        {
+            std::cout << "rate should be a positive number of operations per second, arrival constant or poisson\n";
+            return -1;
+        }
+        std::cout << "   open loop at " << rate << " ops/s with " << (poisson ? "poisson" : "constant") << " arrivals\n";
+    }
+
+    // samples both phases every -i milliseconds, 100 by default
+    std::unique_ptr<Timeline> timeline;
+    if (!parser.getOption("timeline").empty())
+    {
+        auto interval = parser.getOption("interval").empty() ? 100 : std::stoul(parser.getOption("interval"));
+        timeline = std::make_unique<Timeline>(parser.getOption("timeline"), interval, threads);
+        std::cout << "   timeline is written to " << parser.getOption("timeline") << " every " << interval << " ms\n";
+    }
+
+    // hot pairs kept in DRAM in front of Get, -C pairs in total
+    uint64_t cache = 0;
+    if (!parser.getOption("cache").empty())
+    {
+        cache = std::stoull(parser.getOption("cache"));
+        std::cout << "   read cache of " << cache << " pairs\n";
+    }
+
+    // values of -V bytes and more go to per-thread value logs, collected by the shrinker
+    uint64_t value_log = 0;
+    if (!parser.getOption("value_log").empty())
+    {
+        value_log = std::stoull(parser.getOption("value_log"));
+        std::cout << "   values of " << value_log << " bytes and more are logged\n";
+    }
+
+    // Shrink runs every -M ms once pairs were removed, off by default
+    uint64_t shrink_ms = 0;
+    if (!parser.getOption("shrink").empty())
+    {
+        shrink_ms = std::stoull(parser.getOption("shrink"));
+        std::cout << "   shrinking every " << shrink_ms << " ms\n";
+    }
+
+    // the table is presized for -R pairs, a bulk load sizes it by itself
+    uint64_t reserve = 0;
+    if (!parser.getOption("reserve").empty())
+    {
+        reserve = std::stoull(parser.getOption("reserve"));
+        if (bulk)
+        {
+            std::cout << "   bulk loads ignore the reservation\n";
+            reserve = 0;
+        }
+        else
+        {
+            std::cout << "   table is presized for " << reserve << " pairs\n";
+        }
+    }
+
+    // any value but 0 opens the pool of an earlier run and recovers its table, e.g. -O 1
+    auto reopen = !parser.getOption("reopen").empty() && parser.getOption("reopen") != "0";
+    if (reopen)
+    {
+#ifdef DRAM_BACKEND
+        std::cout << "   the DRAM backend has no pool to reopen\n";
+        return -1;
+#else
+        if (!std::ifstream(pool_file).good())
+        {
+            std::cout << "   there is no pool to reopen at " << pool_file << "\n";
+            return -1;
+        }
+        std::cout << "   pool is reopened and recovered, its pairs stand for the warmup\n";
+        reserve = 0;
+#endif
+    }
+
+    // inserts into full buckets return at once, -S workers split them in the background
+    auto split_workers = parser.getOption("split_workers").empty() ? 0 : std::stoi(parser.getOption("split_workers"));
+    if (split_workers > 0)
+    {
+        std::cout << "   splits are deferred to " << split_workers << " background workers\n";
+    }
+
+    // a Put redirected to an ancestor of -F pairs or more splits it, so that redirects die out
+    uint64_t flatten = 0;
+    if (!parser.getOption("flatten").empty())
+    {
+        flatten = std::stoull(parser.getOption("flatten"));
+        std::cout << "   ancestors of " << flatten << " pairs and more are flattened\n";
+    }
+
+    // spans of splits, doublings and allocations in Chrome's trace event format
+    std::unique_ptr<Tracer> tracer;
+    if (!parser.getOption("trace").empty())
+    {
+        tracer = std::make_unique<Tracer>(parser.getOption("trace"));
+        std::cout << "   trace is written to " << parser.getOption("trace") << "\n";
+    }
+
+    auto shards = parser.getOption("shards");
+    if (!shards.empty())
+    {
+        // workers and guardians follow the nodes of their shards there
+        if (!(parser.getOption("cpus") + parser.getOption("placement") + parser.getOption("node") + parser.getOption("background")).empty())
+        {
+            std::cout << "   placement options are ignored by sharded runs\n";
+        }
+        if (rate > 0)
+        {
+            std::cout << "   sharded runs are closed loop only\n";
+        }
+        if (value_log)
+        {
+            std::cout << "   sharded runs keep values inline\n";
+        }
+        if (split_workers > 0)
+        {
+            std::cout << "   sharded runs split in place\n";
+        }
+        if (reopen)
+        {
+            std::cout << "   sharded runs make new pools\n";
+        }
+        return sharded_bench(pool_file, warm_file, run_file, gen.get(), threads, std::stoi(shards), bulk, cache, reserve, flatten, timeline.get(), tracer.get());
+    }
+
+    affinity.Report(std::cout, threads);
 
-    auto pop = prepare_pool(pool_file, 10240);
-    auto root = prepare_root(pop, threads);
+    auto pop = prepare_pool(pool_file, 10240, reopen);
+    auto root = prepare_root(pop, threads, reserve, reopen);
+    root->map->EnableCache(cache);
+    root->map->EnableValueLog(value_log);
+    root->map->EnableFlattening(flatten);
 
 #ifdef DEBUG
-    debug(pop, root, batch, threads);
+    debug(pop, root, batch, threads, reopen);
 #else
     using namespace std::chrono_literals;
     bool to_stop = false;
     auto guardian = [&](PoolBase &pop, SegmentPtrQueue &queue) {
+        affinity.PinBackground();
         while (!to_stop)
         {
             while (queue.HasSpace())
             {
                 // std::cout << "[[[[[[[[[[[[[[[[[[[[ refilling\n";
-                TX::run(pop, [&]() {
-                    auto ptr = pobj::make_persistent<Segment>(pop, 0, 0, false);
+                Backend::Run(pop, [&]() {
+                    auto ptr = Backend::Make<Segment>(pop, 0, 0, false);
                     queue.Push(ptr);
                 });
             }
@@ -236,6 +988,45 @@ int main(int argc, char *argv[])
     std::thread(guardian, std::ref(pop), std::ref(root->map->segment_pool)).detach();
     std::thread(guardian, std::ref(pop), std::ref(root->map->segment_pool)).detach();
 
+    // gives space back after deletions (-M) and updates of logged values (-V), a pass is cheap when nothing can be merged or collected
+    Stats shrink_stats;
+    auto shrinker = [&](PoolBase &pop, Stats &stats) {
+        affinity.PinBackground();
+        auto period = std::chrono::milliseconds(shrink_ms ? shrink_ms : 100);
+        while (!to_stop)
+        {
+            if (shrink_ms)
+            {
+                root->map->Shrink(pop, stats);
+            }
+            if (value_log)
+            {
+                root->map->CollectValues(pop, stats);
+            }
+            std::this_thread::sleep_for(period);
+        }
+    };
+    // unlike the guardians they are joined, their stats are reported and they use the stack of main
+    std::vector<std::thread> background;
+    if (shrink_ms || value_log)
+    {
+        background.emplace_back(shrinker, std::ref(pop), std::ref(shrink_stats));
+    }
+
+    std::vector<Stats> split_stats(split_workers);
+    auto splitter = [&](PoolBase &pop, Stats &stats) {
+        affinity.PinBackground();
+        while (!to_stop)
+        {
+            root->map->RunSplits(pop, stats, 1ms);
+        }
+    };
+    root->map->DeferSplits(split_workers > 0);
+    for (auto &stats : split_stats)
+    {
+        background.emplace_back(splitter, std::ref(pop), std::ref(stats));
+    }
+
     {
         std::thread workers[threads];
         std::vector<WorkloadItem> workloads[threads];
@@ -245,101 +1036,99 @@ int main(int argc, char *argv[])
         std::vector<double> p90s[threads];
         std::vector<double> p99s[threads];
         std::vector<double> p999s[threads];
+        std::vector<double> records[threads];
+        std::vector<std::unique_ptr<Arrivals>> arrivals(threads);
+        if (rate > 0)
+        {
+            for (int i = 0; i < threads; i++)
+            {
+                arrivals[i] = std::make_unique<Arrivals>(rate / threads, poisson, i + 1);
+            }
+        }
 
-        std::ifstream warmup;
-        std::ifstream run;
-        warmup.open(warm_file);
-        run.open(run_file);
-        std::string buffer;
-
+        if (timeline)
+        {
+            timeline->Start();
+        }
+        if (tracer)
+        {
+            tracer->Start();
+        }
+        Timeline::Mark("load");
         std::cout << "warming up\n";
-        Stats _unused;
-        auto load_count = 0;
-        while (getline(warmup, buffer))
+        std::vector<Stats> load_stats;
+        uint64_t load_count = 0;
+        auto load_metrics = Metrics::Aggregate();
+        auto load_start = std::chrono::steady_clock::now();
+        auto warmed = reopen || (bulk ? load_bulk(warm_file, gen.get(), threads, [&](const std::vector<BulkPair> &pairs) {
+            return root->map->BulkLoad(pop, pairs, threads) == FunctionStatus::Ok;
+        }, load_count)
+                                      : load_warmup(warm_file, gen.get(), threads, [&](int tid, const std::string &key, Stats &st) {
+            root->map->Put(pop, st, tid, key, value_of(gen.get(), key));
+        }, load_stats, load_count, &affinity));
+        auto load_end = std::chrono::steady_clock::now();
+        Trace run;
+        if (!warmed || !load_run(run, run_file, gen.get(), threads))
         {
-            std::string key = buffer.c_str() + PUT.length();
-            root->map->Put(pop, _unused, 0, key, key);
-            ++load_count;
-            // if (load_count % 160000 == 0)
-            // {
-            //     std::cout << "loadfactor: " << double(load_count) / root->map->Capacity() << '\n';
-            // }
+            return -1;
         }
+        report_phase("load", load_count, (load_end - load_start).count(), load_stats, Metrics::Aggregate() - load_metrics);
 
         auto count = 0;
-        auto load = 0;
+        auto load = run.Items().size();
         std::cout << "starts running\n";
-        while (getline(run, buffer))
+        for (const auto &item : run.Items())
         {
-            ++load;
-            std::string key;
-            Ops type;
-            if (buffer.rfind(PUT, 0) == 0)
-            {
-                key = buffer.c_str() + PUT.length();
-                type = Ops::Insert;
-            }
-            else if (buffer.rfind(GET, 0) == 0)
-            {
-                key = buffer.c_str() + GET.length();
-                type = Ops::Read;
-            }
-            else if (buffer.rfind(UPDATE, 0) == 0)
-            {
-                key = buffer.c_str() + UPDATE.length();
-                type = Ops::Update;
-            }
-            else if (buffer.rfind(DELETE, 0) == 0)
-            {
-                key = buffer.c_str() + DELETE.length();
-                type = Ops::Delete;
-            }
-            else
-            {
-                std::cout << "unknown operation: " << buffer << "\n";
-                return -1;
-            }
-            workloads[(count++) % threads].push_back(WorkloadItem(type, key));
+            workloads[(count++) % threads].push_back(item);
         }
+        Timeline::Mark("run");
 
         std::atomic_int keys = 0;
 
         auto consume = [&](const WorkloadItem &item, Stats &stats, int tid) {
+            // keys are views into the trace, copied into a buffer reused by each thread
+            thread_local std::string key;
+            key.assign(item.key);
             switch (item.type)
             {
             case Ops::Insert:
-                if (root->map->Put(pop, stats, tid, item.key, item.key) == FunctionStatus::Ok)
+                if (root->map->Put(pop, stats, tid, key, value_of(gen.get(), key)) == FunctionStatus::Ok)
                     keys++;
                 break;
             case Ops::Read:
                 {
-                    root->map->Get(item.key);
+                    root->map->Get(key);
                     break;
                 }
             case Ops::Update:
-                root->map->Put(pop, stats, tid, item.key, item.key);
+                root->map->Put(pop, stats, tid, key, value_of(gen.get(), key));
                 break;
             case Ops::Delete:
-                root->map->Remove(pop, item.key);
+                root->map->Remove(pop, key);
                 break;
             default:
                 break;
             }
         };
 
+        auto run_metrics = Metrics::Aggregate();
         auto start = std::chrono::steady_clock::now();
         for (auto i = 0; i < threads; i++)
         {
-            workers[i] = std::thread(bench_thread,
-                                     consume,
-                                     i,
-                                     std::ref(statses[i]),
-                                     std::ref(workloads[i]),
-                                     std::ref(throughputs[i]),
-                                     std::ref(latencies[i]),
-                                     std::ref(p90s[i]),
-                                     std::ref(p99s[i]),
-                                     std::ref(p999s[i]));
+            workers[i] = std::thread([&, i]() {
+                affinity.PinWorker(i);
+                bench_thread(consume,
+                             i,
+                             statses[i],
+                             workloads[i],
+                             throughputs[i],
+                             latencies[i],
+                             p90s[i],
+                             p99s[i],
+                             p999s[i],
+                             arrivals[i].get(),
+                             records[i]);
+            });
         }
         for (auto &t : workers)
         {
@@ -350,6 +1139,24 @@ int main(int argc, char *argv[])
         std::cout << "time elapsed is " << duration << "\n";
         std::cout << "throughput is " << double(load) / duration * 1000000000.0 << "\n";
         std::cout << keys << " keys are inserted\n";
+        std::vector<Stats> run_stats;
+        for (auto i = 0; i < threads; i++)
+        {
+            run_stats.insert(run_stats.end(), statses[i].begin(), statses[i].end());
+        }
+        report_phase("run", load, duration, run_stats, Metrics::Aggregate() - run_metrics);
+        if (rate > 0)
+        {
+            report_open_loop(rate, load, duration, records, threads);
+        }
+        if (timeline)
+        {
+            timeline->Stop();
+        }
+        if (tracer)
+        {
+            tracer->Stop();
+        }
 
         std::cout << "\nreporting throughput by thread:\n";
         for (auto i = 0; i < threads; i++)
@@ -406,6 +1213,34 @@ int main(int argc, char *argv[])
             }
             std::cout << "\n";
         }
+
+        to_stop = true;
+        for (auto &t : background)
+        {
+            t.join();
+        }
+
+        std::cout << "\nreporting shrinking:\n";
+        std::cout << "merges: " << shrink_stats.merges << "\n";
+        std::cout << "freed segments: " << shrink_stats.freed_segments << "\n";
+        std::cout << "halvings: " << shrink_stats.halvings << "\n";
+        std::cout << "collected value chunks: " << shrink_stats.collected_chunks << "\n";
+        std::cout << "relocated values: " << shrink_stats.relocated_values << "\n";
+
+        if (split_workers > 0)
+        {
+            Stats total;
+            for (const auto &st : split_stats)
+            {
+                total += st;
+            }
+            std::cout << "\nreporting background splits:\n";
+            std::cout << "splits: " << total.simple_splits << " simple, " << total.traditional_splits << " traditional, "
+                      << total.complex_splits << " complex\n";
+            std::cout << "split queue depth: " << root->map->PeakPendingSplits() << " at peak, "
+                      << root->map->PendingSplits() << " at the end\n";
+        }
+
 #ifdef SAMPLE_SPLIT
         std::cout << "\nreporting simple split by thread:\n";
         for (auto i = 0; i < threads; i++)
@@ -451,6 +1286,7 @@ int main(int argc, char *argv[])
             }
             std::cout << "\n";
         }
+
         to_stop = true;
 #endif
     }